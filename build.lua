@@ -1,6 +1,11 @@
 
 local S, G, R = precore.helpers()
 
+newoption {
+	trigger = "release-debug-log",
+	description = "Compile debug log messages into release builds"
+}
+
 precore.import(G"${DEP_PATH}/duct")
 precore.import(G"${DEP_PATH}/trait_wrangler")
 precore.import(G"${DEP_PATH}/ceformat")
@@ -74,6 +79,9 @@ precore.make_config("onsang.dep", nil, {
 		includedirs {
 			G"${ONSANG_ROOT}/src/",
 		}
+
+	configuration {"linux"}
+		links {"pthread"}
 end}})
 
 precore.make_config_scoped("onsang.projects", {
@@ -104,6 +112,11 @@ precore.make_config_scoped("onsang.projects", {
 	configuration {"debug"}
 		targetsuffix("_debug")
 
+	if not _OPTIONS["release-debug-log"] then
+		configuration {"release"}
+			defines {"ONSANG_CONFIG_LOG_DEBUG=0"}
+	end
+
 	configuration {}
 		files {
 			"src/**.cpp",
@@ -5,10 +5,12 @@
 #include <Onsang/aux.hpp>
 #include <Onsang/Log.hpp>
 #include <Onsang/init.hpp>
+#include <Onsang/IO/FlatDatastore.hpp>
 #include <Onsang/UI/Defs.hpp>
 #include <Onsang/UI/TabbedContainer.hpp>
 #include <Onsang/UI/SessionView.hpp>
 #include <Onsang/UI/ObjectView.hpp>
+#include <Onsang/UI/TableGrid.hpp>
 #include <Onsang/App.hpp>
 
 #include <Beard/keys.hpp>
@@ -25,7 +27,12 @@
 #include <Beard/ui/Container.hpp>
 
 #include <Hord/IO/Defs.hpp>
+#include <Hord/Object/Defs.hpp>
 #include <Hord/Object/Ops.hpp>
+#include <Hord/Data/Defs.hpp>
+#include <Hord/Data/ValueRef.hpp>
+#include <Hord/Data/Table.hpp>
+#include <Hord/Data/TableSchema.hpp>
 #include <Hord/Table/Defs.hpp>
 #include <Hord/Table/Unit.hpp>
 #include <Hord/Cmd/Datastore.hpp>
@@ -36,7 +43,12 @@
 #include <duct/ScriptParser.hpp>
 #include <duct/ScriptWriter.hpp>
 
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <type_traits>
 #include <exception>
+#include <iostream>
 #include <functional>
 
 #include <Onsang/detail/gr_ceformat.hpp>
@@ -148,17 +160,34 @@ App::App()
 		{"--no-stdout", {
 			{duct::VarType::null},
 			ConfigNode::Flags::optional
+		}},
+		{"--no-debug-log", {
+			{duct::VarType::null},
+			ConfigNode::Flags::optional
+		}},
+		{"--headless", {
+			{duct::VarType::null},
+			ConfigNode::Flags::optional
+		}},
+		{"--bench-render", {
+			{duct::VarType::integer},
+			ConfigNode::Flags::optional
+		}},
+		{"--bench-read", {
+			{duct::VarType::integer},
+			ConfigNode::Flags::optional
+		}},
+		{"--trace", {
+			{duct::VarMask::value},
+			ConfigNode::Flags::optional
+		}},
+		{"--trace-summary", {
+			{duct::VarMask::value},
+			ConfigNode::Flags::optional
 		}}
 	})
 {}
 
-namespace {
-ONSANG_DEF_FMT_CLASS(
-	s_err_command_failed,
-	"command %s failed: %s"
-);
-} // anonymous namespace
-
 void
 App::toggle_stdout(
 	bool const enable
@@ -171,6 +200,8 @@ App::toggle_stdout(
 	if (enable == log_controller.stdout_enabled()) {
 		return;
 	}
+	// Queued messages go where they would have gone when logged
+	Log::flush();
 	if (enable) {
 		log_controller.stdout(true);
 		Log::acquire()
@@ -180,6 +211,7 @@ App::toggle_stdout(
 		Log::acquire()
 			<< "Disabling stdout\n"
 		;
+		Log::flush();
 		log_controller.stdout(false);
 	}
 }
@@ -192,15 +224,15 @@ App::add_session(
 	bool const auto_open,
 	bool const auto_create
 ) {
-	Log::acquire(Log::debug)
-		<< "Adding session '"
+	ONSANG_LOG_DEBUG(
+		"Adding session '"
 		<< name
 		<< "': '"
 		<< type
 		<< "' @ '"
 		<< path
 		<< "'\n"
-	;
+	);
 	try {
 		// TODO
 		m_session_manager.add_session(
@@ -229,7 +261,7 @@ App::init(
 
 	// Import requires a node
 	opt.morph(duct::VarType::node, false);
-	{
+	if (Log::enabled(Log::debug)) {
 		auto log = Log::acquire(Log::debug);
 		duct::ScriptWriter writer{
 			duct::ScriptWriter::Flags::defaults |
@@ -243,6 +275,14 @@ App::init(
 	// Leak exceptions to caller
 	m_args.import(opt);
 
+	// Summarize a trace and exit; nothing else is needed
+	auto const& arg_trace_summary = m_args.entry("--trace-summary");
+	if (arg_trace_summary.assigned()) {
+		m_flags.enable(Flags::trace_summary);
+		m_trace_summary_path = arg_trace_summary.value.as_str();
+		return true;
+	}
+
 	// Disable stdout before validation
 	auto const& arg_no_stdout = m_args.entry("--no-stdout");
 	if (arg_no_stdout.assigned()) {
@@ -250,6 +290,10 @@ App::init(
 		log_controller.stdout(false);
 	}
 
+	if (m_args.entry("--no-debug-log").assigned()) {
+		Log::set_debug(false);
+	}
+
 	// Set the log file before validation
 	auto const& arg_log = m_args.entry("--log");
 	if (arg_log.assigned()) {
@@ -282,6 +326,44 @@ App::init(
 	if (m_args.entry("--no-auto").assigned()) {
 		m_flags.enable(Flags::no_auto_open);
 	}
+	if (m_args.entry("--headless").assigned()) {
+		m_flags.enable(Flags::headless);
+	}
+	auto const& arg_bench_render = m_args.entry("--bench-render");
+	if (arg_bench_render.assigned()) {
+		if (!m_flags.test(Flags::headless)) {
+			Log::acquire(Log::error)
+				<< "--bench-render requires --headless\n"
+			;
+			return false;
+		}
+		m_bench_frames = static_cast<unsigned>(
+			max_ce(0, arg_bench_render.value.integer())
+		);
+	}
+	auto const& arg_bench_read = m_args.entry("--bench-read");
+	if (arg_bench_read.assigned()) {
+		m_bench_read_passes = static_cast<unsigned>(
+			max_ce(1, arg_bench_read.value.integer())
+		);
+	}
+	auto const& arg_trace = m_args.entry("--trace");
+	if (arg_trace.assigned()) {
+		auto const trace_path = arg_trace.value.as_str();
+		if (!m_trace.open(trace_path)) {
+			Log::acquire(Log::error)
+				<< "Failed to open trace file '"
+				<< trace_path
+				<< "'\n"
+			;
+			return false;
+		}
+		Log::acquire()
+			<< "Tracing commands to '"
+			<< trace_path
+			<< "'\n"
+		;
+	}
 
 	// Load config
 	auto const& arg_config = m_args.entry("--config");
@@ -455,42 +537,57 @@ App::set_session(
 }
 
 void
-App::init_session(
-	System::Session& session
-) {
-	if (session.is_open()) {
+App::init_sessions() {
+	aux::vector<System::Session*> sessions;
+	for (auto& pair : m_session_manager) {
+		auto& session = *pair.second;
+		if (
+			session.auto_open() &&
+			!session.write_back_busy() &&
+			!session.is_open()
+		) {
+			Log::acquire()
+				<< "Initializing session: "
+				<< session.name()
+				<< '\n'
+			;
+			sessions.push_back(&session);
+		}
+	}
+	if (sessions.empty()) {
 		return;
 	}
 
-	Log::acquire()
-		<< "Initializing session: "
-		<< session.name()
-		<< '\n'
-	;
-	try {
-		session.open(m_ui.ctx.root());
-		auto cmd = Hord::Cmd::Datastore::Init{session};
-		if (!cmd(Hord::IO::PropTypeBit::base)) {
-			ONSANG_THROW_FMT(
-				ErrorCode::command_failed,
-				s_err_command_failed,
-				cmd.command_name(),
-				cmd.message()
+	// Each Init command holds the shared driver for its whole run,
+	// so sessions are opened one after another
+	aux::vector<std::exception_ptr> errors(sessions.size());
+	for (std::size_t index = 0u; index < sessions.size(); ++index) {
+		try {
+			sessions[index]->open();
+		} catch (...) {
+			errors[index] = std::current_exception();
+		}
+	}
+
+	// Every session is done; attach views
+	for (std::size_t index = 0u; index < sessions.size(); ++index) {
+		auto& session = *sessions[index];
+		if (errors[index]) {
+			m_ui.csline->set_error(
+				"Failed to initialize session: " + session.name()
 			);
+			Log::acquire(Log::error)
+				<< "Failed to initialize session '"
+				<< session.name()
+				<< "':\n"
+			;
+			Log::report_error_ptr(errors[index]);
+			continue;
 		}
+		session.attach_view(m_ui.ctx.root());
 		if (!m_session) {
 			set_session(&session);
 		}
-	} catch (...) {
-		m_ui.csline->set_error(
-			"Failed to initialize session: " + session.name()
-		);
-		Log::acquire(Log::error)
-			<< "Failed to initialize session '"
-			<< session.name()
-			<< "':\n"
-		;
-		Log::report_error_ptr(std::current_exception());
 	}
 }
 
@@ -498,7 +595,7 @@ void
 App::close_session(
 	System::Session& session
 ) {
-	if (!session.is_open()) {
+	if (session.write_back_busy() || !session.is_open()) {
 		return;
 	}
 
@@ -507,36 +604,12 @@ App::close_session(
 		<< session.name()
 		<< '\n'
 	;
-	try {
-		auto cmd = Hord::Cmd::Datastore::Store{session};
-		if (!cmd()) {
-			ONSANG_THROW_FMT(
-				ErrorCode::command_failed,
-				s_err_command_failed,
-				cmd.command_name(),
-				cmd.message()
-			);
-		}
-		Log::acquire()
-			<< "Stored "
-			<< cmd.num_objects_stored() << " objects and "
-			<< cmd.num_props_stored() << " props\n"
-		;
-		if (&session == m_session) {
-			set_session(nullptr);
-		}
-		session.close();
-	} catch (...) {
-		m_ui.csline->set_error(
-			"Failed to close session: " + session.name()
-		);
-		Log::acquire(Log::error)
-			<< "Failed to close session '"
-			<< session.name()
-			<< "':\n"
-		;
-		Log::report_error_ptr(std::current_exception());
+	if (&session == m_session) {
+		set_session(nullptr);
 	}
+	// Session::process() reports the result
+	session.close_async();
+	m_ui.csline->set_description("storing session: " + session.name());
 }
 
 static Beard::KeyInputMatch const
@@ -581,13 +654,26 @@ App::ui_event_filter(
 			m_session->view()->add_object_view(id);
 		} else if (cp == 'c') {
 			session_view.close_sub_view();
+		} else if (cp == 'S') {
+			session_view.add_stats_view();
 		}
 	}
 }
 
+#define ONSANG_SCOPE_FUNC start_ui
 void
 App::start_ui() {
-	m_ui.ctx.open(Beard::tty::this_path(), true);
+	if (m_flags.test(Flags::headless)) {
+		if (!m_headless.open(HEADLESS_WIDTH, HEADLESS_HEIGHT)) {
+			ONSANG_THROW_FUNC(
+				ErrorCode::ui_headless_open_failed,
+				"failed to open headless terminal"
+			);
+		}
+		m_ui.ctx.open(m_headless.path(), false);
+	} else {
+		m_ui.ctx.open(Beard::tty::this_path(), true);
+	}
 	m_ui.ctx.set_property_map({
 		{
 			{UI::group_default, s_ui_pgroup_default},
@@ -608,9 +694,236 @@ App::start_ui() {
 	);
 	root->push_back(m_ui.csline);
 }
+#undef ONSANG_SCOPE_FUNC
+
+void
+App::process(
+	bool const filter_events
+) {
+	bool unhandled;
+	if (m_events.is_open()) {
+		auto const sources = m_events.wait();
+		m_session_manager.process();
+		// Handles pending input and renders queued actions
+		unhandled = !m_ui.ctx.update(0u);
+		if (sources & enum_cast(System::EventLoop::Source::input)) {
+			// Beard may have buffered more than one event; take
+			// another pass for those
+			m_events.arm_timer(0u);
+		}
+	} else {
+		unhandled = !m_ui.ctx.update(20u);
+		m_session_manager.process();
+	}
+	if (unhandled && filter_events) {
+		ui_event_filter(m_ui.ctx.last_event());
+	}
+}
+
+namespace {
+static char const* const
+s_bench_tags[]{"alpha", "beta", "gamma", "delta", "epsilon"};
+} // anonymous namespace
+
+/** Build a table object with @a num_records generated records. */
+static Hord::Object::UPtr
+make_bench_table(
+	std::size_t const num_records
+) {
+	auto object = Hord::Table::Unit::info.construct(
+		Hord::Object::ID{0xBE4C0000u},
+		Hord::Object::ID_NULL
+	);
+	if (!object) {
+		return object;
+	}
+	auto const column = [](
+		String name,
+		Hord::Data::ValueType const type
+	) {
+		Hord::Data::TableSchema::Column column{};
+		column.name = std::move(name);
+		column.type = {type};
+		return column;
+	};
+	auto& table = static_cast<Hord::Table::Unit&>(*object).data();
+	table = Hord::Data::Table{Hord::Data::TableSchema{
+		column("id", Hord::Data::ValueType::integer),
+		column("name", Hord::Data::ValueType::string),
+		column("value", Hord::Data::ValueType::decimal),
+		column("tag", Hord::Data::ValueType::string),
+	}};
+
+	enum : std::size_t {
+		num_tags = std::extent<decltype(s_bench_tags)>::value,
+	};
+	String name;
+	Hord::Data::ValueRef value{};
+	for (std::size_t record = 0u; record < num_records; ++record) {
+		auto it = table.insert(table.end());
+		value.type = {Hord::Data::ValueType::integer};
+		value.data.integer = static_cast<std::int64_t>(record);
+		it.set_field(0u, value);
+
+		name = "record " + std::to_string(record);
+		value.type = {Hord::Data::ValueType::string};
+		value.data.string = name.c_str();
+		value.size = static_cast<unsigned>(name.size());
+		it.set_field(1u, value);
+
+		value.type = {Hord::Data::ValueType::decimal};
+		value.data.decimal = static_cast<double>(record % 1000u) * 0.25;
+		it.set_field(2u, value);
+
+		auto const* const tag = s_bench_tags[record % num_tags];
+		value.type = {Hord::Data::ValueType::string};
+		value.data.string = tag;
+		value.size = static_cast<unsigned>(std::strlen(tag));
+		it.set_field(3u, value);
+	}
+	return object;
+}
+
+void
+App::run_render_bench() {
+	m_running = false;
+	// The grid needs a session, but only renders the generated table
+	System::Session* session = m_session;
+	for (auto& pair : m_session_manager) {
+		if (session) {
+			break;
+		} else if (pair.second->is_open()) {
+			session = pair.second.get();
+		}
+	}
+	if (!session) {
+		Log::acquire(Log::error)
+			<< "--bench-render requires an open session\n"
+		;
+		return;
+	}
+	Log::acquire()
+		<< "Generating " << BENCH_RECORDS << "-record benchmark table\n"
+	;
+	auto const object = make_bench_table(BENCH_RECORDS);
+	if (!object) {
+		Log::acquire(Log::error)
+			<< "Failed to construct benchmark table\n"
+		;
+		return;
+	}
+	auto& table = static_cast<Hord::Table::Unit&>(*object);
+	set_session(nullptr);
+	auto grid = UI::TableGrid::make(m_ui.ctx.root(), *session, table, table.data());
+	m_ui.viewc->push_back(grid);
+	m_ui.ctx.root()->set_focus(grid);
+	m_ui.ctx.render(true);
+
+	Log::acquire()
+		<< "Running render benchmark for "
+		<< m_bench_frames
+		<< " frames\n"
+	;
+	auto const counters_begin = UI::TableGrid::s_render_counters;
+	auto const bytes_begin = m_headless.bytes_sunk();
+	auto const time_begin = std::chrono::steady_clock::now();
+	for (unsigned frame = 0u; frame < m_bench_frames; ++frame) {
+		// Scroll down a row
+		m_headless.send_input("j", 1u);
+		process(false);
+	}
+	auto const time_end = std::chrono::steady_clock::now();
+	auto const& counters_end = UI::TableGrid::s_render_counters;
+	double const seconds = max_ce(
+		1.0e-9,
+		std::chrono::duration<double>(time_end - time_begin).count()
+	);
+	Log::acquire()
+		<< "Render benchmark: "
+		<< m_bench_frames << " frames in "
+		<< seconds << "s; "
+		<< (m_bench_frames / seconds) << " frames/s, "
+		<< ((counters_end.cells - counters_begin.cells) / seconds) << " cells/s, "
+		<< ((counters_end.calls - counters_begin.calls) / seconds) << " TableGrid renders/s, "
+		<< ((m_headless.bytes_sunk() - bytes_begin) / seconds) << " bytes/s\n"
+	;
+	// The grid refers to the table
+	m_ui.viewc->clear();
+	grid.reset();
+}
+
+void
+App::run_read_bench() {
+	using ReadBench = IO::FlatDatastore::ReadBench;
+	auto const report = [](
+		char const* const mode,
+		ReadBench const& bench
+	) {
+		double const seconds = max_ce(1.0e-9, bench.seconds);
+		Log::acquire()
+			<< "  " << mode << ": "
+			<< bench.props << " props, "
+			<< (bench.bytes / (1024.0 * 1024.0)) << " MiB in "
+			<< seconds << "s; "
+			<< (bench.props / seconds) << " props/s, "
+			<< (bench.bytes / (1024.0 * 1024.0) / seconds) << " MiB/s\n"
+		;
+	};
+	for (auto& pair : m_session_manager) {
+		auto& session = *pair.second;
+		Log::acquire()
+			<< "Running read benchmark for "
+			<< m_bench_read_passes
+			<< " passes: "
+			<< session.name()
+			<< '\n'
+		;
+		try {
+			session.open();
+			auto* const flat = dynamic_cast<IO::FlatDatastore*>(&session.datastore());
+			if (flat) {
+				report("fstream", flat->bench_read(false, m_bench_read_passes));
+				report("mmap", flat->bench_read(true, m_bench_read_passes));
+			} else {
+				Log::acquire(Log::error)
+					<< "Read benchmark requires a flat datastore\n"
+				;
+			}
+			session.close();
+		} catch (...) {
+			Log::acquire(Log::error)
+				<< "Read benchmark failed for session '"
+				<< session.name()
+				<< "':\n"
+			;
+			Log::report_error_ptr(std::current_exception());
+			if (session.is_open()) {
+				try {
+					session.close();
+				} catch (...) {}
+			}
+		}
+	}
+}
 
 void
 App::start() try {
+	if (m_flags.test(Flags::trace_summary)) {
+		if (!System::CommandTrace::summarize(m_trace_summary_path, std::cout)) {
+			Log::acquire(Log::error)
+				<< "Failed to read trace file '"
+				<< m_trace_summary_path
+				<< "'\n"
+			;
+		}
+		return;
+	}
+	if (0u < m_bench_read_passes) {
+		// Runs without the UI so only datastore reads are timed
+		run_read_bench();
+		return;
+	}
+
 	// The terminal will get all screwy if we don't disable stdout
 	toggle_stdout(false);
 
@@ -622,22 +935,26 @@ App::start() try {
 	Log::acquire()
 		<< "Initializing sessions\n"
 	;
-	for (auto& pair : m_session_manager) {
-		auto& session = pair.second;
-		if (session->auto_open()) {
-			init_session(*session);
-		}
-	}
+	init_sessions();
 
 	// Event loop
+	if (!m_events.open(
+		m_flags.test(Flags::headless)
+		? m_headless.path()
+		: Beard::tty::this_path()
+	)) {
+		Log::acquire(Log::error)
+			<< "Failed to open event loop; polling instead\n"
+		;
+	}
 	m_ui.ctx.render(true);
 	m_running = true;
+	if (0u < m_bench_frames) {
+		run_render_bench();
+	}
 	while (m_running) {
-		if (!m_ui.ctx.update(20u)) {
-			ui_event_filter(m_ui.ctx.last_event());
-		}
-		// TODO: Process data from sessions, handle global hotkeys
-		m_session_manager.process();
+		// TODO: Handle global hotkeys
+		process(true);
 	}
 
 	set_session(nullptr);
@@ -645,13 +962,23 @@ App::start() try {
 		auto& session = pair.second;
 		close_session(*session);
 	}
+	// Keep rendering while sessions write back
+	while (m_session_manager.busy()) {
+		process(false);
+	}
+	m_trace.close();
+	m_events.close();
 
 	m_ui.viewc->clear();
 	m_ui.ctx.close();
+	m_headless.close();
 
 	toggle_stdout(true);
 } catch (...) {
 	// TODO: Terminate UI?
+	m_trace.close();
+	m_events.close();
+	m_headless.close();
 	toggle_stdout(true);
 	throw;
 }
@@ -13,6 +13,9 @@
 #include <Onsang/ConfigNode.hpp>
 #include <Onsang/System/Session.hpp>
 #include <Onsang/System/SessionManager.hpp>
+#include <Onsang/System/CommandTrace.hpp>
+#include <Onsang/System/EventLoop.hpp>
+#include <Onsang/System/HeadlessTerminal.hpp>
 #include <Onsang/UI/Defs.hpp>
 #include <Onsang/UI/CommandStatusLine.hpp>
 
@@ -35,12 +38,28 @@ public:
 	enum class Flags : unsigned {
 		no_auto_open = bit(0u),
 		no_stdout    = bit(1u),
+		headless     = bit(2u),
+		trace_summary = bit(3u),
+	};
+
+	enum : unsigned {
+		HEADLESS_WIDTH = 200u,
+		HEADLESS_HEIGHT = 50u,
+		/** Records in the render benchmark table. */
+		BENCH_RECORDS = 1000000u,
 	};
 
 	duct::StateStore<Flags> m_flags{};
 	Hord::System::Driver m_driver{true};
+	// Before the sessions: it must outlive the workers they join
+	System::EventLoop m_events{};
 
 	System::SessionManager m_session_manager;
+	System::HeadlessTerminal m_headless{};
+	unsigned m_bench_frames{0u};
+	unsigned m_bench_read_passes{0u};
+	System::CommandTrace m_trace{};
+	String m_trace_summary_path{};
 
 	bool m_running{false};
 	struct {
@@ -94,9 +113,7 @@ public:
 
 private:
 	void
-	init_session(
-		System::Session&
-	);
+	init_sessions();
 
 	void
 	close_session(
@@ -111,6 +128,17 @@ private:
 		UI::Event const&
 	);
 
+	void
+	process(
+		bool const filter_events
+	);
+
+	void
+	run_render_bench();
+
+	void
+	run_read_bench();
+
 public:
 	void
 	start();
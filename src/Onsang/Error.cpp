@@ -26,6 +26,12 @@ s_error_invalid[]{ONSANG_STR_LIT("INVALID")},
 
 // command
 	ONSANG_STR_LIT("command_failed"),
+
+// UI
+	ONSANG_STR_LIT("ui_headless_open_failed"),
+
+// IO
+	ONSANG_STR_LIT("io_read_failed"),
 };
 } // anonymous namespace
 
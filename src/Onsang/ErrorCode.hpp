@@ -38,6 +38,18 @@ enum class ErrorCode : unsigned {
 	*/
 	command_failed,
 
+// UI
+	/**
+		Headless terminal could not be opened.
+	*/
+	ui_headless_open_failed,
+
+// IO
+	/**
+		A file could not be read.
+	*/
+	io_read_failed,
+
 // -
 	LAST
 };
@@ -0,0 +1,59 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+*/
+
+#include <Onsang/utility.hpp>
+#include <Onsang/IO/BufferStreamBuf.hpp>
+
+namespace Onsang {
+namespace IO {
+
+// class BufferStreamBuf implementation
+
+void
+BufferStreamBuf::clear() noexcept {
+	setp(m_buffer.data(), m_buffer.data() + m_buffer.size());
+}
+
+// std::streambuf implementation
+
+BufferStreamBuf::int_type
+BufferStreamBuf::overflow(
+	int_type ch
+) {
+	if (traits_type::eq_int_type(traits_type::eof(), ch)) {
+		return traits_type::not_eof(ch);
+	}
+	auto const used = size();
+	try {
+		m_buffer.resize(max_ce(std::size_t{4096u}, m_buffer.size() * 2u));
+	} catch (...) {
+		return traits_type::eof();
+	}
+	// pbase() only marks where the last growth happened; size() is
+	// taken from the start of the buffer so pbump() (which takes an
+	// int) is never needed
+	setp(m_buffer.data() + used, m_buffer.data() + m_buffer.size());
+	*pptr() = traits_type::to_char_type(ch);
+	setp(pptr() + 1, epptr());
+	return ch;
+}
+
+BufferStreamBuf::pos_type
+BufferStreamBuf::seekoff(
+	off_type off,
+	std::ios_base::seekdir dir,
+	std::ios_base::openmode which
+) {
+	// Only tellp() is supported
+	if (
+		!(which & std::ios_base::out) ||
+		0 != off || std::ios_base::cur != dir
+	) {
+		return pos_type(off_type(-1));
+	}
+	return pos_type(static_cast<off_type>(size()));
+}
+
+} // namespace IO
+} // namespace Onsang
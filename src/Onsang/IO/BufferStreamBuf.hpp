@@ -0,0 +1,81 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+
+@file
+@brief Reusable output stream buffer.
+*/
+
+#pragma once
+
+#include <Onsang/config.hpp>
+#include <Onsang/aux.hpp>
+
+#include <streambuf>
+#include <ios>
+
+namespace Onsang {
+namespace IO {
+
+/**
+	Write-only stream buffer over a growable memory buffer.
+
+	Unlike @c std::stringstream, the written data can be read
+	without a copy and the memory is kept across clear() calls.
+*/
+class BufferStreamBuf final
+	: public std::streambuf
+{
+private:
+	using base = std::streambuf;
+
+	aux::vector<char> m_buffer{};
+
+	BufferStreamBuf(BufferStreamBuf const&) = delete;
+	BufferStreamBuf(BufferStreamBuf&&) = delete;
+	BufferStreamBuf& operator=(BufferStreamBuf const&) = delete;
+	BufferStreamBuf& operator=(BufferStreamBuf&&) = delete;
+
+protected:
+// std::streambuf implementation
+	int_type
+	overflow(
+		int_type ch
+	) override;
+
+	pos_type
+	seekoff(
+		off_type off,
+		std::ios_base::seekdir dir,
+		std::ios_base::openmode which
+	) override;
+
+public:
+// special member functions
+	~BufferStreamBuf() noexcept override = default;
+
+	BufferStreamBuf() noexcept = default;
+
+// properties
+	char const*
+	data() const noexcept {
+		return m_buffer.data();
+	}
+
+	/**
+		Get the number of bytes written since the last clear().
+	*/
+	std::size_t
+	size() const noexcept {
+		return static_cast<std::size_t>(pptr() - m_buffer.data());
+	}
+
+// operations
+	/**
+		Discard written data (but not the memory).
+	*/
+	void
+	clear() noexcept;
+};
+
+} // namespace IO
+} // namespace Onsang
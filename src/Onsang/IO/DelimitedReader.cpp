@@ -0,0 +1,198 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+*/
+
+#include <Onsang/aux.hpp>
+#include <Onsang/String.hpp>
+#include <Onsang/IO/DelimitedReader.hpp>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+namespace Onsang {
+namespace IO {
+
+// class DelimitedReader implementation
+
+DelimitedReader::~DelimitedReader() noexcept {
+	close();
+}
+
+bool
+DelimitedReader::fill() noexcept {
+	if (!is_open() || m_failed) {
+		return false;
+	}
+	for (;;) {
+		auto const count = ::read(m_fd, m_buffer.get(), BUFFER_SIZE);
+		if (0 < count) {
+			m_pos = 0u;
+			m_end = static_cast<std::size_t>(count);
+			m_bytes_read += static_cast<std::uint64_t>(count);
+			return true;
+		} else if (0 == count) {
+			return false;
+		} else if (EINTR != errno) {
+			m_failed = true;
+			return false;
+		}
+	}
+}
+
+bool
+DelimitedReader::open(
+	String const& path,
+	char const delimiter
+) {
+	close();
+	signed const fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (0 > fd) {
+		return false;
+	}
+	struct ::stat st;
+	if (0 != ::fstat(fd, &st) || !S_ISREG(st.st_mode)) {
+		::close(fd);
+		return false;
+	}
+	::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	if (!m_buffer) {
+		m_buffer.reset(new char[BUFFER_SIZE]);
+	}
+	m_fd = fd;
+	m_file_size = static_cast<std::uint64_t>(st.st_size);
+	if ('\0' != delimiter) {
+		m_delimiter = delimiter;
+	} else {
+		auto const dot = path.rfind('.');
+		m_delimiter
+			= String::npos != dot && 0 == path.compare(dot, String::npos, ".tsv")
+			? '\t'
+			: ','
+		;
+	}
+	return true;
+}
+
+void
+DelimitedReader::close() noexcept {
+	if (is_open()) {
+		::close(m_fd);
+		m_fd = -1;
+	}
+	m_failed = false;
+	m_pos = 0u;
+	m_end = 0u;
+	m_bytes_read = 0u;
+	m_file_size = 0u;
+	m_record.clear();
+	m_field_ends.clear();
+}
+
+bool
+DelimitedReader::next_record() {
+	enum class State : unsigned {
+		field_start,
+		unquoted,
+		quoted,
+		/** Quote seen in a quoted field; doubled or closing. */
+		quote,
+	};
+
+	m_record.clear();
+	m_field_ends.clear();
+	auto state = State::field_start;
+	bool line_empty = true;
+	char const delimiter = m_delimiter;
+	for (;;) {
+		if (m_pos == m_end && !fill()) {
+			if (m_failed || line_empty) {
+				return false;
+			}
+			m_field_ends.push_back(m_record.size());
+			return true;
+		}
+		char const* const data = m_buffer.get();
+		switch (state) {
+		case State::field_start:
+			if ('"' == data[m_pos]) {
+				++m_pos;
+				line_empty = false;
+				state = State::quoted;
+				break;
+			}
+			// fall-through
+
+		case State::unquoted: {
+			// Copy plain text up to the next delimiter or line break
+			auto const begin = m_pos;
+			while (
+				m_pos < m_end &&
+				delimiter != data[m_pos] &&
+				'\n' != data[m_pos] &&
+				'\r' != data[m_pos]
+			) {
+				++m_pos;
+			}
+			if (begin < m_pos) {
+				m_record.append(data + begin, m_pos - begin);
+				line_empty = false;
+				state = State::unquoted;
+			}
+			if (m_pos == m_end) {
+				break;
+			}
+			char const c = data[m_pos++];
+			if (delimiter == c) {
+				m_field_ends.push_back(m_record.size());
+				line_empty = false;
+				state = State::field_start;
+			} else if ('\n' == c) {
+				if (!line_empty) {
+					m_field_ends.push_back(m_record.size());
+					return true;
+				}
+				state = State::field_start;
+			}
+			// '\r' is dropped; the '\n' of CRLF ends the record
+		}	break;
+
+		case State::quoted: {
+			auto const* const quote = static_cast<char const*>(
+				std::memchr(data + m_pos, '"', m_end - m_pos)
+			);
+			auto const end
+				= quote
+				? static_cast<std::size_t>(quote - data)
+				: m_end
+			;
+			m_record.append(data + m_pos, end - m_pos);
+			if (quote) {
+				m_pos = end + 1u;
+				state = State::quote;
+			} else {
+				m_pos = m_end;
+			}
+		}	break;
+
+		case State::quote:
+			if ('"' == data[m_pos]) {
+				m_record.push_back('"');
+				++m_pos;
+				state = State::quoted;
+			} else {
+				// Closing quote; anything up to the delimiter is
+				// taken as-is
+				state = State::unquoted;
+			}
+			break;
+		}
+	}
+}
+
+} // namespace IO
+} // namespace Onsang
@@ -0,0 +1,147 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+
+@file
+@brief Streaming delimited text (CSV/TSV) reader.
+*/
+
+#pragma once
+
+#include <Onsang/config.hpp>
+#include <Onsang/aux.hpp>
+#include <Onsang/String.hpp>
+
+#include <cstdint>
+
+namespace Onsang {
+namespace IO {
+
+/**
+	Streaming reader for delimiter-separated records.
+
+	Fields may be quoted with @c " (RFC 4180); quoted fields can
+	contain delimiters, line breaks and doubled quotes. The file
+	is read in BUFFER_SIZE chunks and only the current record is
+	kept, so memory use does not depend on the file size.
+*/
+class DelimitedReader final {
+public:
+	enum : std::size_t {
+		BUFFER_SIZE = 1u << 20,
+	};
+
+private:
+	signed m_fd{-1};
+	bool m_failed{false};
+	char m_delimiter{','};
+	aux::unique_ptr<char[]> m_buffer{};
+	std::size_t m_pos{0u};
+	std::size_t m_end{0u};
+	std::uint64_t m_bytes_read{0u};
+	std::uint64_t m_file_size{0u};
+
+	/** Field contents of the current record. */
+	String m_record{};
+	/** End offset of each field in m_record. */
+	aux::vector<std::size_t> m_field_ends{};
+
+	DelimitedReader(DelimitedReader const&) = delete;
+	DelimitedReader(DelimitedReader&&) = delete;
+	DelimitedReader& operator=(DelimitedReader const&) = delete;
+	DelimitedReader& operator=(DelimitedReader&&) = delete;
+
+	bool
+	fill() noexcept;
+
+public:
+// special member functions
+	~DelimitedReader() noexcept;
+
+	DelimitedReader() noexcept = default;
+
+// properties
+	bool
+	is_open() const noexcept {
+		return 0 <= m_fd;
+	}
+
+	/**
+		Whether a read error occurred.
+	*/
+	bool
+	failed() const noexcept {
+		return m_failed;
+	}
+
+	char
+	delimiter() const noexcept {
+		return m_delimiter;
+	}
+
+	std::uint64_t
+	bytes_read() const noexcept {
+		return m_bytes_read;
+	}
+
+	/**
+		Size of the file when it was opened.
+	*/
+	std::uint64_t
+	file_size() const noexcept {
+		return m_file_size;
+	}
+
+	std::size_t
+	num_fields() const noexcept {
+		return m_field_ends.size();
+	}
+
+	char const*
+	field_data(
+		std::size_t const index
+	) const noexcept {
+		return m_record.data() + (0u < index ? m_field_ends[index - 1u] : 0u);
+	}
+
+	std::size_t
+	field_size(
+		std::size_t const index
+	) const noexcept {
+		return
+			m_field_ends[index] -
+			(0u < index ? m_field_ends[index - 1u] : 0u)
+		;
+	}
+
+// operations
+	/**
+		Open a file.
+
+		@param delimiter Field delimiter, or @c '\0' to use a tab for
+		@c .tsv files and a comma otherwise.
+
+		@returns @c false if the file could not be opened.
+	*/
+	bool
+	open(
+		String const& path,
+		char const delimiter = '\0'
+	);
+
+	void
+	close() noexcept;
+
+	/**
+		Read the next record.
+
+		Empty lines are skipped.
+
+		@returns @c false at the end of the file or on a read error
+		(see failed()).
+	*/
+	bool
+	next_record();
+};
+
+} // namespace IO
+} // namespace Onsang
@@ -0,0 +1,176 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+*/
+
+#include <Onsang/utility.hpp>
+#include <Onsang/IO/ExtentStreamBuf.hpp>
+
+#include <cstring>
+#include <algorithm>
+
+namespace Onsang {
+namespace IO {
+
+// class ExtentStreamBuf implementation
+
+void
+ExtentStreamBuf::reset(
+	std::streambuf& source,
+	std::uint64_t const offset,
+	std::uint64_t const length
+) noexcept {
+	m_source = &source;
+	m_begin = offset;
+	m_end = offset + length;
+	m_pos = offset;
+	setg(nullptr, nullptr, nullptr);
+}
+
+void
+ExtentStreamBuf::close() noexcept {
+	m_source = nullptr;
+	m_begin = m_end = m_pos = 0u;
+	setg(nullptr, nullptr, nullptr);
+}
+
+std::streamsize
+ExtentStreamBuf::read_source(
+	char_type* const s,
+	std::streamsize count
+) {
+	if (!m_source || m_end <= m_pos) {
+		return 0;
+	}
+	count = static_cast<std::streamsize>(
+		min_ce(static_cast<std::uint64_t>(count), m_end - m_pos)
+	);
+	if (
+		pos_type(off_type(-1)) == m_source->pubseekpos(
+			static_cast<off_type>(m_pos), std::ios_base::in
+		)
+	) {
+		return 0;
+	}
+	auto const got = m_source->sgetn(s, count);
+	if (0 < got) {
+		m_pos += static_cast<std::uint64_t>(got);
+	}
+	return max_ce(std::streamsize{0}, got);
+}
+
+// std::streambuf implementation
+
+ExtentStreamBuf::int_type
+ExtentStreamBuf::underflow() {
+	if (gptr() < egptr()) {
+		return traits_type::to_int_type(*gptr());
+	}
+	if (m_buffer.empty()) {
+		m_buffer.resize(BUFFER_SIZE);
+	}
+	auto const got = read_source(
+		m_buffer.data(),
+		static_cast<std::streamsize>(m_buffer.size())
+	);
+	if (0 >= got) {
+		setg(nullptr, nullptr, nullptr);
+		return traits_type::eof();
+	}
+	setg(m_buffer.data(), m_buffer.data(), m_buffer.data() + got);
+	return traits_type::to_int_type(*gptr());
+}
+
+ExtentStreamBuf::pos_type
+ExtentStreamBuf::seekoff(
+	off_type off,
+	std::ios_base::seekdir dir,
+	std::ios_base::openmode which
+) {
+	if (!(which & std::ios_base::in)) {
+		return pos_type(off_type(-1));
+	}
+	off_type base_off;
+	switch (dir) {
+	case std::ios_base::beg: base_off = 0; break;
+	case std::ios_base::cur:
+		base_off
+			= static_cast<off_type>(m_pos - m_begin)
+			- (egptr() - gptr())
+		;
+		break;
+	case std::ios_base::end: base_off = static_cast<off_type>(size()); break;
+	default: return pos_type(off_type(-1));
+	}
+	return seekpos(pos_type(base_off + off), which);
+}
+
+ExtentStreamBuf::pos_type
+ExtentStreamBuf::seekpos(
+	pos_type pos,
+	std::ios_base::openmode which
+) {
+	off_type const off = pos;
+	if (
+		!(which & std::ios_base::in) ||
+		0 > off || static_cast<off_type>(size()) < off
+	) {
+		return pos_type(off_type(-1));
+	}
+	m_pos = m_begin + static_cast<std::uint64_t>(off);
+	setg(nullptr, nullptr, nullptr);
+	return pos;
+}
+
+std::streamsize
+ExtentStreamBuf::showmanyc() {
+	auto const avail
+		= static_cast<std::uint64_t>(egptr() - gptr())
+		+ (m_end - m_pos)
+	;
+	return
+		0u < avail
+		? static_cast<std::streamsize>(avail)
+		: std::streamsize(-1)
+	;
+}
+
+std::streamsize
+ExtentStreamBuf::xsgetn(
+	char_type* s,
+	std::streamsize count
+) {
+	// Drain the get area, then read large requests straight from
+	// the source
+	std::streamsize const buffered = std::min(
+		count,
+		static_cast<std::streamsize>(egptr() - gptr())
+	);
+	if (0 < buffered) {
+		std::memcpy(s, gptr(), static_cast<std::size_t>(buffered));
+		setg(eback(), gptr() + buffered, egptr());
+	}
+	std::streamsize total = buffered;
+	while (total < count) {
+		std::streamsize got;
+		if (static_cast<std::streamsize>(BUFFER_SIZE) <= count - total) {
+			got = read_source(s + total, count - total);
+		} else if (traits_type::eof() != underflow()) {
+			got = std::min(
+				count - total,
+				static_cast<std::streamsize>(egptr() - gptr())
+			);
+			std::memcpy(s + total, gptr(), static_cast<std::size_t>(got));
+			setg(eback(), gptr() + got, egptr());
+		} else {
+			got = 0;
+		}
+		if (0 >= got) {
+			break;
+		}
+		total += got;
+	}
+	return total;
+}
+
+} // namespace IO
+} // namespace Onsang
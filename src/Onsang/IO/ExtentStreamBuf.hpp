@@ -0,0 +1,114 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+
+@file
+@brief Bounded input stream buffer.
+*/
+
+#pragma once
+
+#include <Onsang/config.hpp>
+#include <Onsang/aux.hpp>
+
+#include <cstdint>
+#include <streambuf>
+#include <ios>
+
+namespace Onsang {
+namespace IO {
+
+/**
+	Read-only stream buffer over an extent of another stream
+	buffer.
+
+	Reads stop at the end of the extent, so a prop reader cannot
+	run into the next prop in a shared data file.
+*/
+class ExtentStreamBuf final
+	: public std::streambuf
+{
+private:
+	using base = std::streambuf;
+
+	enum : std::size_t {
+		BUFFER_SIZE = 64u * 1024u,
+	};
+
+	std::streambuf* m_source{nullptr};
+	std::uint64_t m_begin{0u};
+	std::uint64_t m_end{0u};
+	/** Source position of egptr(). */
+	std::uint64_t m_pos{0u};
+	aux::vector<char> m_buffer{};
+
+	ExtentStreamBuf(ExtentStreamBuf const&) = delete;
+	ExtentStreamBuf(ExtentStreamBuf&&) = delete;
+	ExtentStreamBuf& operator=(ExtentStreamBuf const&) = delete;
+	ExtentStreamBuf& operator=(ExtentStreamBuf&&) = delete;
+
+	std::streamsize
+	read_source(
+		char_type* s,
+		std::streamsize count
+	);
+
+protected:
+// std::streambuf implementation
+	int_type
+	underflow() override;
+
+	pos_type
+	seekoff(
+		off_type off,
+		std::ios_base::seekdir dir,
+		std::ios_base::openmode which
+	) override;
+
+	pos_type
+	seekpos(
+		pos_type pos,
+		std::ios_base::openmode which
+	) override;
+
+	std::streamsize
+	showmanyc() override;
+
+	std::streamsize
+	xsgetn(
+		char_type* s,
+		std::streamsize count
+	) override;
+
+public:
+// special member functions
+	~ExtentStreamBuf() noexcept override = default;
+
+	ExtentStreamBuf() noexcept = default;
+
+// properties
+	std::uint64_t
+	size() const noexcept {
+		return m_end - m_begin;
+	}
+
+// operations
+	/**
+		Bound reads to [@a offset, @a offset + @a length) of
+		@a source.
+	*/
+	void
+	reset(
+		std::streambuf& source,
+		std::uint64_t const offset,
+		std::uint64_t const length
+	) noexcept;
+
+	/**
+		Detach from the source.
+	*/
+	void
+	close() noexcept;
+};
+
+} // namespace IO
+} // namespace Onsang
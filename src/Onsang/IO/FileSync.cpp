@@ -0,0 +1,55 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+*/
+
+#include <Onsang/String.hpp>
+#include <Onsang/IO/FileSync.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdio>
+
+namespace Onsang {
+namespace IO {
+
+namespace {
+
+static bool
+sync_path(
+	String const& path,
+	signed const flags
+) noexcept {
+	signed const fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC | flags);
+	if (0 > fd) {
+		return false;
+	}
+	bool const synced = 0 == ::fsync(fd);
+	::close(fd);
+	return synced;
+}
+
+} // anonymous namespace
+
+bool
+sync_file(
+	String const& path
+) noexcept {
+	return sync_path(path, 0);
+}
+
+bool
+replace_file(
+	String const& from,
+	String const& to,
+	String const& directory
+) noexcept {
+	return
+		sync_path(from, 0) &&
+		0 == std::rename(from.c_str(), to.c_str()) &&
+		sync_path(directory, O_DIRECTORY)
+	;
+}
+
+} // namespace IO
+} // namespace Onsang
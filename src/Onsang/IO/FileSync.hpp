@@ -0,0 +1,47 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+
+@file
+@brief File durability utilities.
+*/
+
+#pragma once
+
+#include <Onsang/config.hpp>
+#include <Onsang/String.hpp>
+
+namespace Onsang {
+namespace IO {
+
+/**
+	Sync the contents of the file at @a path to disk.
+
+	This covers writes made through any descriptor (or stream) for
+	the file, once they have reached the OS.
+
+	@returns @c false if the file could not be opened or synced.
+*/
+bool
+sync_file(
+	String const& path
+) noexcept;
+
+/**
+	Replace @a to with @a from so that a crash leaves either file
+	intact.
+
+	Syncs @a from, renames it over @a to, then syncs @a directory
+	so the rename itself is durable. Anything @a from refers to
+	must already be synced.
+
+	@returns @c false if any step failed.
+*/
+bool
+replace_file(
+	String const& from,
+	String const& to,
+	String const& directory
+) noexcept;
+
+} // namespace IO
+} // namespace Onsang
@@ -0,0 +1,93 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+*/
+
+#include <Onsang/aux.hpp>
+#include <Onsang/String.hpp>
+#include <Onsang/IO/FileWriter.hpp>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+
+namespace Onsang {
+namespace IO {
+
+// class FileWriter implementation
+
+FileWriter::~FileWriter() noexcept {
+	close();
+}
+
+void
+FileWriter::write_through(
+	char const* data,
+	std::size_t size
+) noexcept {
+	if (!is_open()) {
+		m_failed = true;
+	}
+	while (!m_failed && 0u < size) {
+		auto const count = ::write(m_fd, data, size);
+		if (0 > count) {
+			if (EINTR != errno) {
+				m_failed = true;
+			}
+			continue;
+		}
+		data += count;
+		size -= static_cast<std::size_t>(count);
+		m_bytes_written += static_cast<std::uint64_t>(count);
+	}
+}
+
+bool
+FileWriter::open(
+	String const& path
+) {
+	close();
+	signed const fd = ::open(
+		path.c_str(),
+		O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+		0644
+	);
+	if (0 > fd) {
+		return false;
+	}
+	if (!m_buffer) {
+		m_buffer.reset(new char[BUFFER_SIZE]);
+	}
+	m_fd = fd;
+	m_failed = false;
+	m_size = 0u;
+	m_bytes_written = 0u;
+	return true;
+}
+
+bool
+FileWriter::close() noexcept {
+	if (!is_open()) {
+		return !m_failed;
+	}
+	flush();
+	if (0 != ::close(m_fd)) {
+		m_failed = true;
+	}
+	m_fd = -1;
+	return !m_failed;
+}
+
+void
+FileWriter::flush() noexcept {
+	if (0u < m_size) {
+		auto const size = m_size;
+		m_size = 0u;
+		write_through(m_buffer.get(), size);
+	}
+}
+
+} // namespace IO
+} // namespace Onsang
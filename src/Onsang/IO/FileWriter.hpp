@@ -0,0 +1,134 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+
+@file
+@brief Buffered file writer.
+*/
+
+#pragma once
+
+#include <Onsang/config.hpp>
+#include <Onsang/aux.hpp>
+#include <Onsang/String.hpp>
+
+#include <algorithm>
+#include <cstdint>
+
+namespace Onsang {
+namespace IO {
+
+/**
+	Append-only file writer with a large output buffer.
+
+	Writes go to the file in BUFFER_SIZE chunks. Small writes are
+	plain copies into the buffer.
+*/
+class FileWriter final {
+public:
+	enum : std::size_t {
+		BUFFER_SIZE = 1u << 20,
+	};
+
+private:
+	signed m_fd{-1};
+	bool m_failed{false};
+	aux::unique_ptr<char[]> m_buffer{};
+	std::size_t m_size{0u};
+	std::uint64_t m_bytes_written{0u};
+
+	FileWriter(FileWriter const&) = delete;
+	FileWriter(FileWriter&&) = delete;
+	FileWriter& operator=(FileWriter const&) = delete;
+	FileWriter& operator=(FileWriter&&) = delete;
+
+	void
+	write_through(
+		char const* data,
+		std::size_t size
+	) noexcept;
+
+public:
+// special member functions
+	~FileWriter() noexcept;
+
+	FileWriter() noexcept = default;
+
+// properties
+	bool
+	is_open() const noexcept {
+		return 0 <= m_fd;
+	}
+
+	/**
+		Whether a write error occurred.
+
+		Further writes are dropped.
+	*/
+	bool
+	failed() const noexcept {
+		return m_failed;
+	}
+
+	/**
+		Number of bytes written (including buffered bytes).
+	*/
+	std::uint64_t
+	bytes_written() const noexcept {
+		return m_bytes_written + m_size;
+	}
+
+// operations
+	/**
+		Create or truncate a file.
+
+		@returns @c false if the file could not be opened.
+	*/
+	bool
+	open(
+		String const& path
+	);
+
+	/**
+		Flush and close the file.
+
+		@returns @c false if any write failed.
+	*/
+	bool
+	close() noexcept;
+
+	void
+	flush() noexcept;
+
+	void
+	write(
+		char const* const data,
+		std::size_t const size
+	) noexcept {
+		if (BUFFER_SIZE - m_size >= size) {
+			std::copy(data, data + size, m_buffer.get() + m_size);
+			m_size += size;
+		} else {
+			write_through(data, size);
+		}
+	}
+
+	void
+	put(
+		char const c
+	) noexcept {
+		if (BUFFER_SIZE == m_size) {
+			flush();
+		}
+		m_buffer[m_size++] = c;
+	}
+
+	void
+	write(
+		String const& str
+	) noexcept {
+		write(str.data(), str.size());
+	}
+};
+
+} // namespace IO
+} // namespace Onsang
@@ -6,6 +6,7 @@
 #include <Onsang/String.hpp>
 #include <Onsang/serialization.hpp>
 #include <Onsang/Log.hpp>
+#include <Onsang/IO/FileSync.hpp>
 #include <Onsang/IO/FlatDatastore.hpp>
 
 #include <Hord/IO/StorageInfo.hpp>
@@ -18,11 +19,13 @@
 #include <boost/filesystem.hpp>
 #pragma GCC diagnostic pop
 
+#include <chrono>
 #include <cstdio>
 #include <type_traits>
 #include <utility>
 #include <new>
 #include <exception>
+#include <iterator>
 
 #include <Onsang/detail/Hord/gr_ceformat.hpp>
 
@@ -40,6 +43,11 @@ HORD_DEF_FMT(
 	"%s: object %s does not exist"
 );
 
+enum : std::size_t {
+	// Fold the journal into the index after this many records
+	journal_compact_threshold = 4096u,
+};
+
 /*static constexpr ceformat::Format const
 s_fmt_object_id{
 	ONSANG_STR_LIT("%08x")
@@ -61,6 +69,17 @@ static_assert(
 
 }; // anonymous namespace
 
+inline static std::uint64_t
+elapsed_ns(
+	std::chrono::steady_clock::time_point const start
+) noexcept {
+	return static_cast<std::uint64_t>(
+		std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - start
+		).count()
+	);
+}
+
 inline static constexpr bool
 prop_info_equal(
 	Hord::IO::PropInfo const& x,
@@ -94,7 +113,13 @@ FlatDatastore::FlatDatastore(
 		std::move(root_path)
 	)
 	, m_lock()
+	, m_flags(Flags::mapped_input)
+	, m_index()
+	, m_index_dirty()
+	, m_index_rebuild(false)
+	, m_journal()
 	, m_prop()
+	, m_io_stats()
 {}
 
 void
@@ -120,17 +145,131 @@ FlatDatastore::read_index(
 	}
 }
 
+#define HORD_SCOPE_FUNC write_index
+void
+FlatDatastore::write_index() {
+	auto const& si_map = storage_info();
+	if (!m_index_rebuild && !m_index.has_room(m_index_dirty.size())) {
+		// Grow (and drop tombstones)
+		m_index_rebuild = true;
+	}
+	if (m_index_rebuild) {
+		// Build the new index beside the live one so a crash leaves
+		// either the old or the new index
+		auto const index_path = root_path() + "/index";
+		auto const temp_path = index_path + ".tmp";
+		if (!m_index.create(
+			temp_path,
+			IO::HashIndex::bucket_count_for(si_map.size())
+		)) {
+			Log::acquire(Log::error)
+				<< DUCT_GR_MSG_FQN("failed to create index file: '")
+				<< temp_path
+				<< "'\n"
+			;
+			return;
+		}
+		for (auto const& si_pair : si_map) {
+			m_index.assign(si_pair.second);
+		}
+		if (
+			!m_index.sync() ||
+			!replace_file(temp_path, index_path, root_path())
+		) {
+			m_index.close();
+			Log::acquire(Log::error)
+				<< DUCT_GR_MSG_FQN("failed to replace index file: '")
+				<< index_path
+				<< "'\n"
+			;
+			return;
+		}
+	} else {
+		// Only touch the buckets that changed
+		for (auto const id_value : m_index_dirty) {
+			Hord::Object::ID const object_id{id_value};
+			auto const it = si_map.find(object_id);
+			if (si_map.cend() != it) {
+				m_index.assign(it->second);
+			} else {
+				m_index.erase(object_id);
+			}
+		}
+	}
+	if (!m_index.sync()) {
+		// Keep the journal; it still has the changes
+		Log::acquire(Log::error)
+			<< DUCT_GR_MSG_FQN("failed to sync index file\n")
+		;
+		return;
+	}
+	m_index_dirty.clear();
+	m_index_rebuild = false;
+}
+#undef HORD_SCOPE_FUNC
+
+#define HORD_SCOPE_FUNC compact_journal
+void
+FlatDatastore::compact_journal() noexcept {
+	try {
+		write_index();
+	} catch (...) {
+		Log::acquire(Log::error)
+			<< DUCT_GR_MSG_FQN("failed to write index file:\n")
+		;
+		Log::report_error_ptr(std::current_exception());
+		return;
+	}
+	// Only drop the journal once the index has its changes
+	if (m_index_dirty.empty() && !m_journal.truncate()) {
+		Log::acquire(Log::error)
+			<< DUCT_GR_MSG_FQN("failed to truncate journal\n")
+		;
+	}
+}
+#undef HORD_SCOPE_FUNC
+
+#define HORD_SCOPE_FUNC note_assign
+void
+FlatDatastore::note_assign(
+	Hord::IO::StorageInfo const& sinfo
+) {
+	m_index_dirty.emplace(sinfo.object_id.value());
+	if (!m_journal.append_assign(sinfo)) {
+		Log::acquire(Log::error)
+			<< DUCT_GR_MSG_FQN("failed to append to journal\n")
+		;
+		if (m_journal.is_failed()) {
+			// Write the change to the index instead, which also
+			// truncates the torn record away
+			compact_journal();
+		}
+	} else if (journal_compact_threshold <= m_journal.num_records()) {
+		compact_journal();
+	}
+}
+#undef HORD_SCOPE_FUNC
+
+#define HORD_SCOPE_FUNC note_erase
 void
-FlatDatastore::write_index(
-	std::ostream& stream
+FlatDatastore::note_erase(
+	Hord::Object::ID const object_id
 ) {
-	auto ser = make_output_serializer(stream);
-	auto& si_map = storage_info();
-	ser(static_cast<uint32_t>(si_map.size()));
-	for (auto const& si_pair : si_map) {
-		ser(si_pair.second);
+	m_index_dirty.emplace(object_id.value());
+	if (!m_journal.append_erase(object_id)) {
+		Log::acquire(Log::error)
+			<< DUCT_GR_MSG_FQN("failed to append to journal\n")
+		;
+		if (m_journal.is_failed()) {
+			// Write the change to the index instead, which also
+			// truncates the torn record away
+			compact_journal();
+		}
+	} else if (journal_compact_threshold <= m_journal.num_records()) {
+		compact_journal();
 	}
 }
+#undef HORD_SCOPE_FUNC
 
 static_assert(
 	4u == sizeof(Hord::Object::IDValue),
@@ -139,16 +278,13 @@ static_assert(
 );
 
 void
-FlatDatastore::assign_prop(
-	Hord::IO::PropInfo const& prop_info,
-	Hord::IO::StorageInfo& sinfo,
-	bool const is_input
-) {
-	bool const is_orphan = Hord::IO::Linkage::orphan == sinfo.linkage;
-	m_prop.info = prop_info;
-	m_prop.sinfo = &sinfo;
-	m_prop.is_input = is_input;
-	m_prop.directory.reserve(
+FlatDatastore::object_directory(
+	Hord::Object::ID const object_id,
+	Hord::IO::Linkage const linkage,
+	String& directory
+) const {
+	bool const is_orphan = Hord::IO::Linkage::orphan == linkage;
+	directory.reserve(
 		root_path().size() +		// root
 		(is_orphan ? 8u : 10u) +	// "/orphan/" or "/resident/"
 		8u							// ID
@@ -167,9 +303,9 @@ FlatDatastore::assign_prop(
 		obj_id_str,
 		static_cast<signed>(obj_id_str_len),
 		"%08x",
-		prop_info.object_id.value()
+		object_id.value()
 	);
-	m_prop.directory
+	directory
 		.assign(root_path())
 		.append(
 			is_orphan
@@ -180,6 +316,18 @@ FlatDatastore::assign_prop(
 	;
 }
 
+void
+FlatDatastore::assign_prop(
+	Hord::IO::PropInfo const& prop_info,
+	Hord::IO::StorageInfo& sinfo,
+	bool const is_input
+) {
+	m_prop.info = prop_info;
+	m_prop.sinfo = &sinfo;
+	m_prop.is_input = is_input;
+	object_directory(prop_info.object_id, sinfo.linkage, m_prop.directory);
+}
+
 #define HORD_SCOPE_FUNC acquire_stream
 namespace {
 HORD_DEF_FMT_FQN(
@@ -237,19 +385,46 @@ FlatDatastore::acquire_stream(
 	}
 
 	assign_prop(prop_info, sinfo, is_input);
+	m_prop.acquired = std::chrono::steady_clock::now();
 	namespace fs = boost::filesystem;
 	boost::system::error_code ec;
-	if (!is_input && (fs::create_directory(fs::path{m_prop.directory}, ec), ec)) {
-		HORD_THROW_FMT(
-			Hord::ErrorCode::datastore_prop_void,
-			s_err_acquire_dir_creation_failed,
-			Hord::Object::IDPrinter{prop_info.object_id},
-			Hord::IO::get_prop_type_name(prop_info.prop_type),
-			ec.message()
-		);
+	if (!is_input) {
+		bool const created = fs::create_directory(fs::path{m_prop.directory}, ec);
+		{
+			std::lock_guard<std::mutex> lock{m_io_stats_mutex};
+			++m_io_stats.directory_checks;
+			m_io_stats.directories_created += created ? 1u : 0u;
+			m_io_stats.directory_time += elapsed_ns(m_prop.acquired);
+		}
+		if (ec) {
+			HORD_THROW_FMT(
+				Hord::ErrorCode::datastore_prop_void,
+				s_err_acquire_dir_creation_failed,
+				Hord::Object::IDPrinter{prop_info.object_id},
+				Hord::IO::get_prop_type_name(prop_info.prop_type),
+				ec.message()
+			);
+		}
 	}
 	String prop_path{m_prop.directory};
 	prop_path.append(s_prop_type_abbr_rel[enum_cast(prop_info.prop_type)]);
+	auto const open_start = std::chrono::steady_clock::now();
+	if (
+		is_input &&
+		m_flags.test(Flags::mapped_input) &&
+		m_prop.mapped_buf.open(prop_path)
+	) {
+		m_prop.mapped_stream.clear();
+		m_prop.is_mapped = true;
+		{
+			std::lock_guard<std::mutex> lock{m_io_stats_mutex};
+			++m_io_stats.opens;
+			++m_io_stats.mapped_opens;
+			m_io_stats.open_time += elapsed_ns(open_start);
+		}
+		base::enable_state(State::locked);
+		return;
+	}
 	m_prop.stream.open(
 		prop_path,
 		std::ios_base::binary
@@ -268,6 +443,11 @@ FlatDatastore::acquire_stream(
 			Hord::IO::get_prop_type_name(prop_info.prop_type)
 		);
 	}
+	{
+		std::lock_guard<std::mutex> lock{m_io_stats_mutex};
+		++m_io_stats.opens;
+		m_io_stats.open_time += elapsed_ns(open_start);
+	}
 
 	base::enable_state(State::locked);
 }
@@ -313,17 +493,202 @@ FlatDatastore::release_stream(
 		m_prop.info.prop_type,
 		Hord::IO::PropState::original
 	);
+	if (!is_input) {
+		note_assign(*m_prop.sinfo);
+	}
 
-	try {
-		// Ignore exceptions during close
-		m_prop.stream.close();
-	} catch (...) {}
+	// Position is the number of bytes read or written
+	std::streamoff const position = (
+		m_prop.is_mapped
+		? static_cast<std::streambuf&>(m_prop.mapped_buf)
+		: static_cast<std::streambuf&>(*m_prop.stream.rdbuf())
+	).pubseekoff(
+		0, std::ios_base::cur,
+		is_input ? std::ios_base::in : std::ios_base::out
+	);
+	auto const bytes = 0 < position ? static_cast<std::uint64_t>(position) : 0u;
+
+	if (m_prop.is_mapped) {
+		m_prop.mapped_buf.close();
+	} else {
+		try {
+			// Ignore exceptions during close
+			m_prop.stream.close();
+		} catch (...) {}
+	}
+	{
+		std::lock_guard<std::mutex> lock{m_io_stats_mutex};
+		auto& prop_stats = m_io_stats.props[enum_cast(m_prop.info.prop_type)];
+		if (is_input) {
+			++prop_stats.reads;
+			prop_stats.bytes_read += bytes;
+			prop_stats.read_time += elapsed_ns(m_prop.acquired);
+		} else {
+			++prop_stats.writes;
+			prop_stats.bytes_written += bytes;
+			prop_stats.write_time += elapsed_ns(m_prop.acquired);
+		}
+	}
 	m_prop.reset();
 	base::disable_state(State::locked);
 }
 #undef HORD_SCOPE_FUNC
 
 
+// extra files
+
+bool
+FlatDatastore::extra_path(
+	Hord::Object::ID const object_id,
+	String const& name,
+	String& path
+) const {
+	auto const& sinfo_map = storage_info();
+	auto const it = sinfo_map.find(object_id);
+	if (sinfo_map.cend() == it) {
+		return false;
+	}
+	object_directory(object_id, it->second.linkage, path);
+	path.append(1u, '/').append(name);
+	return true;
+}
+
+bool
+FlatDatastore::load_extra(
+	Hord::Object::ID const object_id,
+	String const& name,
+	String& data
+) const {
+	data.clear();
+	String path;
+	if (!extra_path(object_id, name, path)) {
+		return false;
+	}
+	std::ifstream stream{path, std::ios_base::in | std::ios_base::binary};
+	if (!stream.is_open()) {
+		return false;
+	}
+	data.assign(
+		std::istreambuf_iterator<char>{stream},
+		std::istreambuf_iterator<char>{}
+	);
+	if (stream.bad()) {
+		data.clear();
+		return false;
+	}
+	return true;
+}
+
+bool
+FlatDatastore::store_extra(
+	Hord::Object::ID const object_id,
+	String const& name,
+	String const& data
+) {
+	String path;
+	if (!extra_path(object_id, name, path)) {
+		return false;
+	}
+	namespace fs = boost::filesystem;
+	boost::system::error_code ec;
+	if (data.empty()) {
+		fs::remove(fs::path{path}, ec);
+		return !ec;
+	}
+	fs::create_directory(fs::path{path}.parent_path(), ec);
+	if (ec) {
+		return false;
+	}
+	std::ofstream stream{
+		path,
+		std::ios_base::out | std::ios_base::binary | std::ios_base::trunc
+	};
+	if (!stream.is_open()) {
+		return false;
+	}
+	stream.write(data.data(), static_cast<std::streamsize>(data.size()));
+	stream.close();
+	return !stream.fail();
+}
+
+// operations
+
+#define HORD_SCOPE_FUNC commit_journal
+void
+FlatDatastore::commit_journal() noexcept {
+	if (!m_journal.commit()) {
+		Log::acquire(Log::error)
+			<< DUCT_GR_MSG_FQN("failed to sync journal\n")
+		;
+	}
+}
+#undef HORD_SCOPE_FUNC
+
+#define HORD_SCOPE_FUNC bench_read
+FlatDatastore::ReadBench
+FlatDatastore::bench_read(
+	bool const mapped,
+	unsigned const passes
+) {
+	bool const was_mapped = m_flags.test(Flags::mapped_input);
+	m_flags.set(Flags::mapped_input, mapped);
+	ReadBench result{0u, 0u, 0.0};
+	aux::vector<char> buffer(64u * 1024u);
+	auto const read_all = [this, &buffer](ReadBench& bench) {
+		auto const& sinfo_map = storage_info();
+		for (auto const& si_pair : sinfo_map) {
+			auto const& sinfo = si_pair.second;
+			for (std::size_t index = 0u; index < NUM_PROP_TYPES; ++index) {
+				auto const type = static_cast<Hord::IO::PropType>(index);
+				if (
+					!sinfo.prop_storage.supplies(type) ||
+					!sinfo.prop_storage.is_initialized(type)
+				) {
+					continue;
+				}
+				Hord::IO::PropInfo const info{
+					sinfo.object_id, sinfo.object_type, type
+				};
+				acquire_stream(info, true);
+				std::istream& stream
+					= m_prop.is_mapped
+					? m_prop.mapped_stream
+					: static_cast<std::istream&>(m_prop.stream)
+				;
+				do {
+					stream.read(
+						buffer.data(),
+						static_cast<std::streamsize>(buffer.size())
+					);
+					bench.bytes += static_cast<std::uint64_t>(stream.gcount());
+				} while (0 < stream.gcount());
+				release_stream(info, true);
+				++bench.props;
+			}
+		}
+	};
+	try {
+		ReadBench warm{0u, 0u, 0.0};
+		read_all(warm);
+		auto const start = std::chrono::steady_clock::now();
+		for (unsigned pass = 0u; pass < passes; ++pass) {
+			read_all(result);
+		}
+		result.seconds = static_cast<double>(elapsed_ns(start)) * 1.0e-9;
+	} catch (...) {
+		if (is_locked()) {
+			try {
+				release_stream(m_prop.info, true);
+			} catch (...) {}
+		}
+		m_flags.set(Flags::mapped_input, was_mapped);
+		throw;
+	}
+	m_flags.set(Flags::mapped_input, was_mapped);
+	return result;
+}
+#undef HORD_SCOPE_FUNC
+
 // Hord::IO::Datastore implementation
 
 #define HORD_SCOPE_FUNC open_impl
@@ -370,6 +735,7 @@ FlatDatastore::open_impl(
 			);
 		}
 		do_index = false;
+		m_index_rebuild = true;
 	}
 
 	// Path could've changed (and we don't assign it in the ctor)
@@ -386,21 +752,67 @@ FlatDatastore::open_impl(
 
 	if (do_index) {
 		auto const index_path = root_path() + "/index";
-		std::ifstream index_stream{index_path};
-		if (!index_stream.is_open()) {
+		std::exception_ptr eptr;
+		auto const index_result = m_index.open(index_path);
+		if (IO::HashIndex::OpenResult::corrupt == index_result) {
+			// Never mistake a damaged hash index for a legacy one;
+			// the legacy reader would make an empty datastore of it
 			HORD_THROW_FQN(
 				Hord::ErrorCode::datastore_open_failed,
-				"failed to open index file for reading"
+				"index file is corrupt"
 			);
+		} else if (IO::HashIndex::OpenResult::opened == index_result) {
+			bool consistent = true;
+			try {
+				storage_info().clear();
+				consistent = m_index.read_all(storage_info());
+			} catch (...) {
+				eptr = std::current_exception();
+			}
+			if (!consistent) {
+				m_index.close();
+				storage_info().clear();
+				HORD_THROW_FQN(
+					Hord::ErrorCode::datastore_open_failed,
+					"index file is corrupt"
+				);
+			}
+		} else {
+			// Not a hash index; read the legacy index and convert it
+			// on close
+			std::ifstream index_stream{index_path};
+			if (!index_stream.is_open()) {
+				HORD_THROW_FQN(
+					Hord::ErrorCode::datastore_open_failed,
+					"failed to open index file for reading"
+				);
+			}
+			try {
+				read_index(index_stream);
+			} catch (...) {
+				eptr = std::current_exception();
+			}
+			index_stream.close();
+			m_index_rebuild = true;
 		}
-		std::exception_ptr eptr;
-		try {
-			read_index(index_stream);
-		} catch (...) {
-			eptr = std::current_exception();
+		if (!eptr && m_journal.open(root_path() + "/journal")) {
+			// Recover changes made after the index was last written
+			try {
+				auto const count = m_journal.replay(storage_info(), m_index_dirty);
+				if (0u < count) {
+					Log::acquire()
+						<< DUCT_GR_MSG_FQN("replayed ")
+						<< count
+						<< " journal records\n"
+					;
+				}
+			} catch (...) {
+				eptr = std::current_exception();
+			}
 		}
-		index_stream.close();
 		if (eptr) {
+			m_index.close();
+			m_journal.close();
 			Log::acquire(Log::error)
 				<< DUCT_GR_MSG_FQN("failed to read index file:\n")
 			;
@@ -410,6 +822,17 @@ FlatDatastore::open_impl(
 				"failed to read index file"
 			);
 		}
+	} else if (m_journal.open(root_path() + "/journal")) {
+		m_journal.truncate();
+	}
+	if (m_journal.is_open()) {
+		// Synced once per command by commit_journal()
+		m_journal.set_group_commit(true);
+	} else {
+		Log::acquire(Log::error)
+			<< DUCT_GR_MSG_FQN("failed to open journal; changes will only be")
+			<< " persisted on close\n"
+		;
 	}
 } catch (...) {
 	m_lock.release();
@@ -422,27 +845,11 @@ void
 FlatDatastore::close_impl() {
 	// NB: close() protects us from is_locked()
 
-	auto const index_path = root_path() + "/index";
-	std::ofstream index_stream{index_path};
-	if (index_stream.is_open()) {
-		try {
-			write_index(index_stream);
-			index_stream.close();
-		} catch (...) {
-			Log::acquire(Log::error)
-				<< DUCT_GR_MSG_FQN("failed to write index file: '")
-				<< index_path
-				<< "':\n"
-			;
-			Log::report_error_ptr(std::current_exception());
-		}
-	} else {
-		Log::acquire(Log::error)
-			<< DUCT_GR_MSG_FQN("failed to open index file for writing: '")
-			<< index_path
-			<< "'\n"
-		;
-	}
+	compact_journal();
+	m_journal.close();
+	m_index.close();
+	m_index_dirty.clear();
+	m_index_rebuild = false;
 
 	m_lock.release();
 	base::disable_state(State::opened);
@@ -455,6 +862,9 @@ FlatDatastore::acquire_input_stream_impl(
 	Hord::IO::PropInfo const& prop_info
 ) {
 	acquire_stream(prop_info, true);
+	if (m_prop.is_mapped) {
+		return m_prop.mapped_stream;
+	}
 	return m_prop.stream;
 }
 
@@ -510,6 +920,7 @@ FlatDatastore::create_object_impl(
 		}
 	);
 	// TODO: Throw if !emplace_pair.second
+	note_assign(emplace_pair.first->second);
 	return emplace_pair.first;
 }
 #undef HORD_SCOPE_FUNC
@@ -531,6 +942,7 @@ FlatDatastore::destroy_object_impl(
 	}
 	// TODO: Destroy data on the filesystem
 	sinfo_map.erase(it);
+	note_erase(object_id);
 }
 #undef HORD_SCOPE_FUNC
 
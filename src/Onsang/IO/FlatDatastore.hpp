@@ -11,6 +11,9 @@
 #include <Onsang/aux.hpp>
 #include <Onsang/utility.hpp>
 #include <Onsang/String.hpp>
+#include <Onsang/IO/MappedStreamBuf.hpp>
+#include <Onsang/IO/HashIndex.hpp>
+#include <Onsang/IO/Journal.hpp>
 
 #include <Hord/LockFile.hpp>
 #include <Hord/Object/Defs.hpp>
@@ -19,8 +22,13 @@
 #include <Hord/IO/StorageInfo.hpp>
 #include <Hord/IO/Datastore.hpp>
 
+#include <duct/StateStore.hpp>
+
+#include <chrono>
+#include <cstdint>
 #include <iostream>
 #include <fstream>
+#include <mutex>
 
 /*
 
@@ -30,13 +38,15 @@ Structure:
 
 "root/"
 	".lock" LockFile;
-	"index" <storage info>;
+	"index" HashIndex;
+	"journal" Journal; (changes since index was last written)
 	"resident/"
 		"$id/i" <identity>;
 		"$id/m" Metadata;
 		"$id/s" <scratch space>;
 		"$id/p" <primary data>;
 		"$id/a" <aux data>;
+		"$id/x" <column indexes>; (see System::ColumnIndex)
 	"orphan/"
 		[same layout]
 
@@ -55,8 +65,81 @@ public:
 	static base::TypeInfo const
 	s_type_info;
 
+	enum class Flags : unsigned {
+		/**
+			Read props through a memory mapping instead of an
+			@c std::fstream.
+		*/
+		mapped_input = bit(0u),
+	};
+
+	enum : std::size_t {
+		NUM_PROP_TYPES = static_cast<std::size_t>(Hord::IO::PropType::LAST),
+	};
+
+	struct PropIOStats {
+		std::uint64_t reads;
+		std::uint64_t writes;
+		std::uint64_t bytes_read;
+		std::uint64_t bytes_written;
+		/** Nanoseconds from acquire to release. */
+		std::uint64_t read_time;
+		std::uint64_t write_time;
+	};
+
+	/**
+		I/O counters.
+
+		Times are in nanoseconds.
+	*/
+	struct IOStats {
+		/** By Hord::IO::PropType. */
+		PropIOStats props[NUM_PROP_TYPES];
+		/** Prop files opened (including mappings). */
+		std::uint64_t opens;
+		std::uint64_t mapped_opens;
+		std::uint64_t open_time;
+		/** Object directories checked before writing a prop. */
+		std::uint64_t directory_checks;
+		std::uint64_t directories_created;
+		std::uint64_t directory_time;
+		/** Journal syncs; one per command that appended records. */
+		std::uint64_t syncs;
+		std::uint64_t sync_time;
+
+		std::uint64_t
+		total_bytes_read() const noexcept {
+			std::uint64_t total = 0u;
+			for (auto const& prop : props) {
+				total += prop.bytes_read;
+			}
+			return total;
+		}
+
+		std::uint64_t
+		total_bytes_written() const noexcept {
+			std::uint64_t total = 0u;
+			for (auto const& prop : props) {
+				total += prop.bytes_written;
+			}
+			return total;
+		}
+	};
+
+	/** Result of bench_read(). */
+	struct ReadBench {
+		std::uint64_t props;
+		std::uint64_t bytes;
+		double seconds;
+	};
+
 private:
 	Hord::LockFile m_lock;
+	duct::StateStore<Flags> m_flags;
+	IO::HashIndex m_index;
+	aux::unordered_set<Hord::Object::IDValue> m_index_dirty;
+	bool m_index_rebuild;
+	IO::Journal m_journal;
 
 	struct {
 		String directory{};
@@ -67,16 +150,28 @@ private:
 		};
 		Hord::IO::StorageInfo* sinfo;
 		std::fstream stream{};
+		IO::MappedStreamBuf mapped_buf{};
+		std::istream mapped_stream{&mapped_buf};
 		bool is_input{false};
+		bool is_mapped{false};
+		std::chrono::steady_clock::time_point acquired{};
 
 		void
 		reset() noexcept {
 			directory.clear();
 			info.object_id = Hord::Object::ID_NULL;
 			sinfo = nullptr;
+			is_mapped = false;
 		}
 	} m_prop;
 
+	/**
+		Written on whichever thread uses the datastore (e.g., the
+		write-back thread) and read by io_stats().
+	*/
+	IOStats m_io_stats;
+	mutable std::mutex m_io_stats_mutex{};
+
 	static Hord::IO::Datastore::UPtr
 	construct(
 		Hord::String root_path
@@ -96,16 +191,42 @@ public:
 	~FlatDatastore() noexcept override = default;
 
 private:
+	// Legacy (serialized) index
 	void
 	read_index(
 		std::istream&
 	);
 
 	void
-	write_index(
-		std::ostream&
+	write_index();
+
+	void
+	compact_journal() noexcept;
+
+	void
+	note_assign(
+		Hord::IO::StorageInfo const& sinfo
 	);
 
+	void
+	note_erase(
+		Hord::Object::ID const object_id
+	);
+
+	void
+	object_directory(
+		Hord::Object::ID const object_id,
+		Hord::IO::Linkage const linkage,
+		String& directory
+	) const;
+
+	bool
+	extra_path(
+		Hord::Object::ID const object_id,
+		String const& name,
+		String& path
+	) const;
+
 	void
 	assign_prop(
 		Hord::IO::PropInfo const&,
@@ -175,6 +296,73 @@ private:
 	) override;
 
 public:
+// properties
+	/**
+		Enable or disable memory-mapped prop reads.
+
+		@note This is enabled by default. If a prop cannot be
+		mapped, it is read through an @c std::fstream instead.
+	*/
+	void
+	set_mapped_input(
+		bool const enable
+	) noexcept {
+		m_flags.set(Flags::mapped_input, enable);
+	}
+
+	bool
+	mapped_input() const noexcept {
+		return m_flags.test(Flags::mapped_input);
+	}
+
+	/**
+		Get I/O counters since the datastore was constructed.
+
+		This may be called while another thread uses the datastore.
+	*/
+	IOStats
+	io_stats() const noexcept {
+		IOStats stats;
+		{
+			std::lock_guard<std::mutex> lock{m_io_stats_mutex};
+			stats = m_io_stats;
+		}
+		stats.syncs = m_journal.num_syncs();
+		stats.sync_time = m_journal.sync_time();
+		return stats;
+	}
+
+// extra files
+	/**
+		Read an extra file of an object.
+
+		Extra files live next to the props of an object but are
+		not props; Hord does not know about them.
+
+		@returns @c false if the object or file does not exist.
+	*/
+	bool
+	load_extra(
+		Hord::Object::ID const object_id,
+		String const& name,
+		String& data
+	) const;
+
+	/**
+		Write an extra file of an object.
+
+		An empty @a data removes the file.
+
+		@returns @c false if the object does not exist or the
+		write failed.
+	*/
+	bool
+	store_extra(
+		Hord::Object::ID const object_id,
+		String const& name,
+		String const& data
+	);
+
 // operations
 	/**
 		Creates the datastore if the root path is empty.
@@ -186,6 +374,33 @@ public:
 	open(
 		bool const create_if_empty
 	);
+
+	/**
+		Sync the journal records of the last command.
+
+		Records are group-committed: they reach the OS when
+		appended but are only synced to disk by this call.
+	*/
+	void
+	commit_journal() noexcept;
+
+	/**
+		Read every initialized prop @a passes times.
+
+		An untimed pass is made first so both read paths start
+		with the same page cache. The mapped_input() flag is
+		restored afterwards.
+
+		@pre The datastore is open and not locked.
+
+		Throws Hord::Error:
+		- see acquire_stream()
+	*/
+	ReadBench
+	bench_read(
+		bool const mapped,
+		unsigned const passes
+	);
 };
 
 } // namespace IO
@@ -0,0 +1,316 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+*/
+
+#include <Onsang/String.hpp>
+#include <Onsang/serialization.hpp>
+#include <Onsang/IO/HashIndex.hpp>
+
+#include <duct/IO/memstream.hpp>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <ios>
+#include <stdexcept>
+
+namespace Onsang {
+namespace IO {
+
+// class HashIndex implementation
+
+namespace {
+
+static char const
+s_magic[8]{'O', 'N', 'S', 'H', 'I', 'D', 'X', '\0'};
+
+enum : std::uint64_t {
+	min_bucket_count = 64u,
+};
+
+} // anonymous namespace
+
+HashIndex::~HashIndex() noexcept {
+	close();
+}
+
+std::uint64_t
+HashIndex::bucket_for(
+	Hord::Object::IDValue const object_id
+) const noexcept {
+	// Fibonacci hashing; bucket_count is a power of two
+	std::uint64_t const hash
+		= static_cast<std::uint64_t>(object_id) * 0x9E3779B97F4A7C15ull
+	;
+	return (hash >> 32u) & (header().bucket_count - 1u);
+}
+
+std::uint64_t
+HashIndex::probe(
+	Hord::Object::IDValue const object_id,
+	bool const for_insert
+) const noexcept {
+	auto const bucket_count = header().bucket_count;
+	auto const mask = bucket_count - 1u;
+	auto const* const base = slots();
+	std::uint64_t reusable = bucket_count;
+	for (
+		std::uint64_t index = bucket_for(object_id), count = 0u;
+		count < bucket_count;
+		index = (index + 1u) & mask, ++count
+	) {
+		auto const& slot = base[index];
+		switch (slot.state) {
+		case SlotState::empty:
+			if (!for_insert) {
+				return bucket_count;
+			}
+			return bucket_count != reusable ? reusable : index;
+
+		case SlotState::tombstone:
+			if (for_insert && bucket_count == reusable) {
+				reusable = index;
+			}
+			break;
+
+		case SlotState::used:
+			if (object_id == slot.object_id) {
+				return index;
+			}
+			break;
+		}
+	}
+	return for_insert ? reusable : bucket_count;
+}
+
+bool
+HashIndex::map(
+	signed const fd,
+	std::size_t const size
+) noexcept {
+	void* const addr = ::mmap(
+		nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0
+	);
+	::close(fd);
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+	bool const mapped = MAP_FAILED != addr;
+#pragma GCC diagnostic pop
+	if (!mapped) {
+		return false;
+	}
+	m_data = static_cast<char*>(addr);
+	m_size = size;
+	return true;
+}
+
+bool
+HashIndex::has_room(
+	std::uint64_t const count
+) const noexcept {
+	if (!is_open()) {
+		return false;
+	}
+	// Max load factor of 3/4, counting tombstones
+	auto const& h = header();
+	return (h.num_used + h.num_tombstones + count) * 4u <= h.bucket_count * 3u;
+}
+
+std::uint64_t
+HashIndex::bucket_count_for(
+	std::uint64_t const count
+) noexcept {
+	// Target a load factor of at most 1/2
+	std::uint64_t bucket_count = min_bucket_count;
+	while (bucket_count < count * 2u) {
+		bucket_count <<= 1u;
+	}
+	return bucket_count;
+}
+
+HashIndex::OpenResult
+HashIndex::open(
+	String const& path
+) noexcept {
+	close();
+	signed const fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+	if (0 > fd) {
+		return OpenResult::not_hash_index;
+	}
+	struct ::stat st;
+	if (0 != ::fstat(fd, &st)) {
+		::close(fd);
+		return OpenResult::not_hash_index;
+	}
+	char magic[sizeof(s_magic)];
+	auto const magic_size = ::pread(fd, magic, sizeof(magic), 0);
+	if (
+		static_cast<ssize_t>(sizeof(magic)) != magic_size ||
+		0 != std::memcmp(magic, s_magic, sizeof(s_magic))
+	) {
+		::close(fd);
+		return OpenResult::not_hash_index;
+	}
+	// From here on the file claims to be a hash index
+	if (sizeof(Header) > static_cast<std::size_t>(st.st_size)) {
+		::close(fd);
+		return OpenResult::corrupt;
+	}
+	if (!map(fd, static_cast<std::size_t>(st.st_size))) {
+		return OpenResult::corrupt;
+	}
+	auto const& h = header();
+	if (
+		VERSION != h.version ||
+		sizeof(Slot) != h.slot_size ||
+		0u == h.bucket_count ||
+		0u != (h.bucket_count & (h.bucket_count - 1u)) ||
+		sizeof(Header) + h.bucket_count * sizeof(Slot) != m_size
+	) {
+		close();
+		return OpenResult::corrupt;
+	}
+	return OpenResult::opened;
+}
+
+bool
+HashIndex::create(
+	String const& path,
+	std::uint64_t const bucket_count
+) noexcept {
+	close();
+	signed const fd = ::open(
+		path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644
+	);
+	if (0 > fd) {
+		return false;
+	}
+	// ftruncate() zero-fills, which makes every slot empty
+	std::size_t const size = sizeof(Header) + bucket_count * sizeof(Slot);
+	if (0 != ::ftruncate(fd, static_cast<off_t>(size))) {
+		::close(fd);
+		return false;
+	}
+	if (!map(fd, size)) {
+		return false;
+	}
+	auto& h = header();
+	std::memcpy(h.magic, s_magic, sizeof(s_magic));
+	h.version = VERSION;
+	h.slot_size = sizeof(Slot);
+	h.bucket_count = bucket_count;
+	h.num_used = 0u;
+	h.num_tombstones = 0u;
+	return true;
+}
+
+void
+HashIndex::close() noexcept {
+	if (m_data) {
+		sync();
+		::munmap(m_data, m_size);
+	}
+	m_data = nullptr;
+	m_size = 0u;
+}
+
+bool
+HashIndex::sync() noexcept {
+	return !m_data || 0 == ::msync(m_data, m_size, MS_SYNC);
+}
+
+bool
+HashIndex::assign(
+	Hord::IO::StorageInfo const& sinfo
+) {
+	if (!is_open()) {
+		return false;
+	}
+	auto const index = probe(sinfo.object_id.value(), true);
+	if (bucket_count() == index) {
+		return false;
+	}
+	char payload[SLOT_PAYLOAD_SIZE];
+	duct::IO::omemstream stream{payload, sizeof(payload)};
+	auto ser = make_output_serializer(stream);
+	ser(sinfo);
+	std::streamoff const length = stream.tellp();
+	if (
+		0 > length ||
+		static_cast<std::streamoff>(SLOT_PAYLOAD_SIZE) < length
+	) {
+		throw std::length_error(
+			"HashIndex::assign: storage info does not fit in a slot"
+		);
+	}
+
+	auto& h = header();
+	auto& slot = slots()[index];
+	if (SlotState::tombstone == slot.state) {
+		--h.num_tombstones;
+	}
+	if (SlotState::used != slot.state) {
+		++h.num_used;
+	}
+	slot.object_id = sinfo.object_id.value();
+	slot.state = SlotState::used;
+	slot.length = static_cast<std::uint8_t>(length);
+	std::memcpy(slot.payload, payload, slot.length);
+	return true;
+}
+
+void
+HashIndex::erase(
+	Hord::Object::ID const object_id
+) noexcept {
+	if (!is_open()) {
+		return;
+	}
+	auto const index = probe(object_id.value(), false);
+	if (bucket_count() != index) {
+		slots()[index].state = SlotState::tombstone;
+		auto& h = header();
+		--h.num_used;
+		++h.num_tombstones;
+	}
+}
+
+bool
+HashIndex::read_all(
+	Hord::IO::Datastore::storage_info_map_type& si_map
+) const {
+	if (!is_open()) {
+		return true;
+	}
+	Hord::IO::StorageInfo sinfo{
+		Hord::Object::ID_NULL,
+		Hord::Object::TYPE_NULL,
+		{true, true},
+		Hord::IO::Linkage::resident
+	};
+	auto const* const end = slots() + header().bucket_count;
+	for (auto const* slot = slots(); end != slot; ++slot) {
+		if (SlotState::used != slot->state) {
+			continue;
+		} else if (SLOT_PAYLOAD_SIZE < slot->length) {
+			// Would read past the payload (and past the mapping for
+			// the last slot)
+			return false;
+		}
+		duct::IO::imemstream stream{slot->payload, slot->length};
+		auto ser = make_input_serializer(stream);
+		ser(sinfo);
+		if (slot->object_id != sinfo.object_id.value()) {
+			return false;
+		}
+		si_map.emplace(sinfo.object_id, sinfo);
+	}
+	return true;
+}
+
+} // namespace IO
+} // namespace Onsang
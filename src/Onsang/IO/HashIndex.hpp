@@ -0,0 +1,261 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+
+@file
+@brief Memory-mapped storage info hash table.
+*/
+
+#pragma once
+
+#include <Onsang/config.hpp>
+#include <Onsang/aux.hpp>
+#include <Onsang/String.hpp>
+
+#include <Hord/Object/Defs.hpp>
+#include <Hord/IO/StorageInfo.hpp>
+#include <Hord/IO/Datastore.hpp>
+
+#include <cstdint>
+
+/*
+
+Hash index file.
+
+An open-addressed (linear probing) table of fixed-size slots keyed
+by object ID. Each slot holds a serialized StorageInfo. The file is
+mapped shared, so updates probe the mapping directly and only touch
+the slots they change.
+
+Hord keeps every StorageInfo in the datastore's map, so opening
+still reads each used slot (see read_all()); only writes are
+proportional to the number of changes.
+
+Structure:
+
+	Header (64 bytes);
+	Slot[bucket_count] (64 bytes each);
+
+*/
+
+namespace Onsang {
+namespace IO {
+
+class HashIndex final {
+public:
+	enum : std::uint32_t {
+		VERSION = 1u,
+	};
+
+	enum : std::size_t {
+		SLOT_PAYLOAD_SIZE = 56u,
+	};
+
+	/** Result of open(). */
+	enum class OpenResult : unsigned {
+		opened = 0u,
+		/** The file does not exist or is not a hash index. */
+		not_hash_index,
+		/** The file is a hash index but is malformed. */
+		corrupt,
+	};
+
+	enum class SlotState : std::uint8_t {
+		empty = 0u,
+		used,
+		tombstone,
+	};
+
+	struct Header {
+		char magic[8];
+		std::uint32_t version;
+		std::uint32_t slot_size;
+		std::uint64_t bucket_count;
+		std::uint64_t num_used;
+		std::uint64_t num_tombstones;
+		std::uint8_t reserved[24];
+	};
+
+	struct Slot {
+		Hord::Object::IDValue object_id;
+		SlotState state;
+		std::uint8_t length;
+		std::uint8_t reserved[2];
+		char payload[SLOT_PAYLOAD_SIZE];
+	};
+
+	static_assert(64u == sizeof(Header), "HashIndex::Header size changed");
+	static_assert(64u == sizeof(Slot), "HashIndex::Slot size changed");
+	static_assert(
+		SLOT_PAYLOAD_SIZE <= 0xFFu,
+		"HashIndex::Slot::length cannot hold SLOT_PAYLOAD_SIZE"
+	);
+
+private:
+	char* m_data{nullptr};
+	std::size_t m_size{0u};
+
+	HashIndex(HashIndex const&) = delete;
+	HashIndex(HashIndex&&) = delete;
+	HashIndex& operator=(HashIndex const&) = delete;
+	HashIndex& operator=(HashIndex&&) = delete;
+
+	Header&
+	header() noexcept {
+		return *reinterpret_cast<Header*>(m_data);
+	}
+
+	Header const&
+	header() const noexcept {
+		return *reinterpret_cast<Header const*>(m_data);
+	}
+
+	Slot*
+	slots() noexcept {
+		return reinterpret_cast<Slot*>(m_data + sizeof(Header));
+	}
+
+	Slot const*
+	slots() const noexcept {
+		return reinterpret_cast<Slot const*>(m_data + sizeof(Header));
+	}
+
+	std::uint64_t
+	bucket_for(
+		Hord::Object::IDValue const object_id
+	) const noexcept;
+
+	/**
+		Find the slot for @a object_id.
+
+		@returns The slot index, or bucket_count() if there is no
+		such slot.
+	*/
+	std::uint64_t
+	probe(
+		Hord::Object::IDValue const object_id,
+		bool const for_insert
+	) const noexcept;
+
+	bool
+	map(
+		signed const fd,
+		std::size_t const size
+	) noexcept;
+
+public:
+// special member functions
+	~HashIndex() noexcept;
+
+	HashIndex() noexcept = default;
+
+// properties
+	bool
+	is_open() const noexcept {
+		return nullptr != m_data;
+	}
+
+	std::uint64_t
+	bucket_count() const noexcept {
+		return is_open() ? header().bucket_count : 0u;
+	}
+
+	std::uint64_t
+	size() const noexcept {
+		return is_open() ? header().num_used : 0u;
+	}
+
+	/**
+		Whether the table can take @a count more entries
+		without exceeding its load factor.
+	*/
+	bool
+	has_room(
+		std::uint64_t const count
+	) const noexcept;
+
+	/**
+		Get the bucket count to use for @a count entries.
+	*/
+	static std::uint64_t
+	bucket_count_for(
+		std::uint64_t const count
+	) noexcept;
+
+// operations
+	/**
+		Map an existing index file.
+
+		A file without the hash index magic is not a hash index
+		(e.g. a legacy index); one with the magic but a bad
+		version or size is corrupt.
+	*/
+	OpenResult
+	open(
+		String const& path
+	) noexcept;
+
+	/**
+		Create (or truncate) an index file with @a bucket_count
+		empty buckets.
+
+		@note This does not replace @a path atomically; create a
+		temporary file and rename it over a live index.
+	*/
+	bool
+	create(
+		String const& path,
+		std::uint64_t const bucket_count
+	) noexcept;
+
+	/**
+		Flush changes and unmap.
+	*/
+	void
+	close() noexcept;
+
+	/**
+		Flush changes to disk.
+
+		@returns @c false if the flush failed.
+	*/
+	bool
+	sync() noexcept;
+
+	/**
+		Insert or update storage info.
+
+		Throws SerializerError or @c std::length_error if the
+		storage info does not fit in a slot.
+
+		@returns @c false if the table is full.
+	*/
+	bool
+	assign(
+		Hord::IO::StorageInfo const& sinfo
+	);
+
+	/**
+		Erase storage info by object ID.
+	*/
+	void
+	erase(
+		Hord::Object::ID const object_id
+	) noexcept;
+
+	/**
+		Read all entries into a storage info map.
+
+		Throws SerializerError if a slot payload is malformed.
+
+		@returns @c false if a slot is inconsistent with its header
+		(a length beyond the payload or a mismatched object ID), in
+		which case the index is corrupt.
+	*/
+	bool
+	read_all(
+		Hord::IO::Datastore::storage_info_map_type& si_map
+	) const;
+};
+
+} // namespace IO
+} // namespace Onsang
@@ -0,0 +1,309 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+*/
+
+#include <Onsang/aux.hpp>
+#include <Onsang/String.hpp>
+#include <Onsang/serialization.hpp>
+#include <Onsang/IO/Journal.hpp>
+
+#include <duct/IO/memstream.hpp>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+namespace Onsang {
+namespace IO {
+
+// class Journal implementation
+
+namespace {
+
+static char const
+s_magic[8]{'O', 'N', 'S', 'J', 'R', 'N', 'L', '\0'};
+
+enum : std::size_t {
+	header_size = sizeof(s_magic) + sizeof(std::uint32_t),
+	record_header_size = 1u + 1u + sizeof(std::uint32_t),
+	max_payload_size = 255u,
+};
+
+inline static std::uint32_t
+checksum(
+	char const* data,
+	std::size_t size
+) noexcept {
+	std::uint32_t hash = 2166136261u;
+	while (size--) {
+		hash ^= static_cast<std::uint8_t>(*data++);
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static bool
+write_all(
+	signed const fd,
+	char const* data,
+	std::size_t size
+) noexcept {
+	while (0u < size) {
+		auto const written = ::write(fd, data, size);
+		if (0 > written) {
+			if (EINTR == errno) {
+				continue;
+			}
+			return false;
+		}
+		data += written;
+		size -= static_cast<std::size_t>(written);
+	}
+	return true;
+}
+
+} // anonymous namespace
+
+Journal::~Journal() noexcept {
+	close();
+}
+
+bool
+Journal::open(
+	String const& path
+) noexcept {
+	close();
+	m_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+	if (0 > m_fd) {
+		return false;
+	}
+	m_num_records = 0u;
+	struct ::stat st;
+	if (0 != ::fstat(m_fd, &st)) {
+		close();
+		return false;
+	}
+	if (0 == st.st_size) {
+		return truncate();
+	}
+	return true;
+}
+
+void
+Journal::close() noexcept {
+	if (is_open()) {
+		sync();
+		::close(m_fd);
+	}
+	m_fd = -1;
+	m_num_records = 0u;
+	m_num_unsynced = 0u;
+	m_failed = false;
+}
+
+bool
+Journal::truncate() noexcept {
+	if (!is_open() || 0 != ::ftruncate(m_fd, 0)) {
+		return false;
+	}
+	char header[header_size];
+	std::uint32_t const version = VERSION;
+	std::memcpy(header, s_magic, sizeof(s_magic));
+	std::memcpy(header + sizeof(s_magic), &version, sizeof(version));
+	m_num_records = 0u;
+	m_num_unsynced = 0u;
+	m_failed = false;
+	return write_all(m_fd, header, sizeof(header)) && sync();
+}
+
+bool
+Journal::commit() noexcept {
+	if (!is_open() || 0u == m_num_unsynced) {
+		return true;
+	}
+	m_num_unsynced = 0u;
+	return sync();
+}
+
+void
+Journal::set_group_commit(
+	bool const enable
+) noexcept {
+	if (!enable) {
+		commit();
+	}
+	m_group_commit = enable;
+}
+
+bool
+Journal::sync() noexcept {
+	auto const start = std::chrono::steady_clock::now();
+	bool const synced = 0 == ::fdatasync(m_fd);
+	m_num_syncs.fetch_add(1u, std::memory_order_relaxed);
+	m_sync_time.fetch_add(static_cast<std::uint64_t>(
+		std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - start
+		).count()
+	), std::memory_order_relaxed);
+	return synced;
+}
+
+bool
+Journal::append(
+	RecordType const type,
+	char const* const payload,
+	std::uint8_t const length
+) noexcept {
+	if (!is_open() || m_failed) {
+		return false;
+	}
+	// Appends only come from the datastore's thread, so the end
+	// cannot move under us
+	auto const end = ::lseek(m_fd, 0, SEEK_END);
+	if (0 > end) {
+		return false;
+	}
+	// Single write() so that O_APPEND keeps the record contiguous
+	char record[record_header_size + max_payload_size];
+	std::uint32_t const sum = checksum(payload, length);
+	record[0] = static_cast<char>(type);
+	record[1] = static_cast<char>(length);
+	std::memcpy(record + 2u, &sum, sizeof(sum));
+	std::memcpy(record + record_header_size, payload, length);
+	if (!write_all(m_fd, record, record_header_size + length)) {
+		// Records appended after a partial one would be unreachable
+		if (0 != ::ftruncate(m_fd, end)) {
+			m_failed = true;
+		}
+		return false;
+	}
+	++m_num_records;
+	if (m_sync) {
+		if (m_group_commit) {
+			++m_num_unsynced;
+		} else if (!sync()) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool
+Journal::append_assign(
+	Hord::IO::StorageInfo const& sinfo
+) {
+	char payload[max_payload_size];
+	duct::IO::omemstream stream{payload, sizeof(payload)};
+	auto ser = make_output_serializer(stream);
+	ser(sinfo);
+	return append(
+		RecordType::assign,
+		payload,
+		static_cast<std::uint8_t>(stream.tellp())
+	);
+}
+
+bool
+Journal::append_erase(
+	Hord::Object::ID const object_id
+) noexcept {
+	Hord::Object::IDValue const value = object_id.value();
+	char payload[sizeof(value)];
+	std::memcpy(payload, &value, sizeof(value));
+	return append(RecordType::erase, payload, sizeof(payload));
+}
+
+std::size_t
+Journal::replay(
+	Hord::IO::Datastore::storage_info_map_type& si_map,
+	aux::unordered_set<Hord::Object::IDValue>& touched
+) {
+	if (!is_open()) {
+		return 0u;
+	}
+	struct ::stat st;
+	if (0 != ::fstat(m_fd, &st)) {
+		return 0u;
+	}
+	aux::vector<char> buffer(static_cast<std::size_t>(st.st_size));
+	std::size_t read_size = 0u;
+	while (read_size < buffer.size()) {
+		auto const result = ::pread(
+			m_fd,
+			buffer.data() + read_size,
+			buffer.size() - read_size,
+			static_cast<off_t>(read_size)
+		);
+		if (0 >= result) {
+			break;
+		}
+		read_size += static_cast<std::size_t>(result);
+	}
+	if (
+		header_size > read_size ||
+		0 != std::memcmp(buffer.data(), s_magic, sizeof(s_magic))
+	) {
+		// Nothing in it can be trusted; start over so appends are
+		// readable
+		truncate();
+		return 0u;
+	}
+
+	Hord::IO::StorageInfo sinfo{
+		Hord::Object::ID_NULL,
+		Hord::Object::TYPE_NULL,
+		{true, true},
+		Hord::IO::Linkage::resident
+	};
+	std::size_t count = 0u;
+	std::size_t pos = header_size;
+	while (pos + record_header_size <= read_size) {
+		auto const type = static_cast<RecordType>(buffer[pos]);
+		std::size_t const length = static_cast<std::uint8_t>(buffer[pos + 1u]);
+		std::uint32_t sum;
+		std::memcpy(&sum, buffer.data() + pos + 2u, sizeof(sum));
+		char const* const payload = buffer.data() + pos + record_header_size;
+		if (
+			pos + record_header_size + length > read_size ||
+			checksum(payload, length) != sum
+		) {
+			// Torn tail
+			break;
+		}
+		if (RecordType::assign == type) {
+			duct::IO::imemstream stream{payload, length};
+			auto ser = make_input_serializer(stream);
+			ser(sinfo);
+			si_map.erase(sinfo.object_id);
+			si_map.emplace(sinfo.object_id, sinfo);
+			touched.emplace(sinfo.object_id.value());
+		} else if (RecordType::erase == type && sizeof(Hord::Object::IDValue) == length) {
+			Hord::Object::IDValue value;
+			std::memcpy(&value, payload, sizeof(value));
+			si_map.erase(Hord::Object::ID{value});
+			touched.emplace(value);
+		} else {
+			break;
+		}
+		pos += record_header_size + length;
+		++count;
+	}
+	if (pos < read_size) {
+		// The file is O_APPEND, so records appended after a torn
+		// tail would be unreachable
+		if (0 != ::ftruncate(m_fd, static_cast<off_t>(pos)) || !sync()) {
+			close();
+			return count;
+		}
+	}
+	m_num_records = count;
+	return count;
+}
+
+} // namespace IO
+} // namespace Onsang
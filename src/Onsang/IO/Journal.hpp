@@ -0,0 +1,226 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+
+@file
+@brief Storage info write-ahead journal.
+*/
+
+#pragma once
+
+#include <Onsang/config.hpp>
+#include <Onsang/aux.hpp>
+#include <Onsang/String.hpp>
+
+#include <Hord/Object/Defs.hpp>
+#include <Hord/IO/StorageInfo.hpp>
+#include <Hord/IO/Datastore.hpp>
+
+#include <atomic>
+#include <cstdint>
+
+/*
+
+Journal file.
+
+An append-only log of storage info changes made since the index
+was last written. Records are idempotent, so replaying a journal
+over an index that already contains some of its changes is safe.
+
+Structure:
+
+	"ONSJRNL\0" u32 version;
+	Record:
+		u8 type;
+		u8 length;
+		u32 checksum; (FNV-1a of payload)
+		u8 payload[length];
+
+A torn record at the tail (from a crash during append) ends replay,
+and the file is truncated to the last whole record so that later
+appends follow it. A failed append is cut off the same way; if that
+fails too, the journal refuses appends until it is truncated.
+
+*/
+
+namespace Onsang {
+namespace IO {
+
+class Journal final {
+public:
+	enum : std::uint32_t {
+		VERSION = 1u,
+	};
+
+	enum class RecordType : std::uint8_t {
+		/** Payload is a serialized StorageInfo. */
+		assign = 1u,
+		/** Payload is an object ID. */
+		erase,
+	};
+
+private:
+	signed m_fd{-1};
+	std::size_t m_num_records{0u};
+	bool m_sync{true};
+	bool m_group_commit{false};
+	/** A torn record could not be cut off. */
+	bool m_failed{false};
+	/** Records appended since the last sync. */
+	std::size_t m_num_unsynced{0u};
+	/** Read from other threads (see FlatDatastore::io_stats()). */
+	std::atomic<std::uint64_t> m_num_syncs{0u};
+	std::atomic<std::uint64_t> m_sync_time{0u};
+
+	Journal(Journal const&) = delete;
+	Journal(Journal&&) = delete;
+	Journal& operator=(Journal const&) = delete;
+	Journal& operator=(Journal&&) = delete;
+
+	bool
+	sync() noexcept;
+
+	bool
+	append(
+		RecordType const type,
+		char const* const payload,
+		std::uint8_t const length
+	) noexcept;
+
+public:
+// special member functions
+	~Journal() noexcept;
+
+	Journal() noexcept = default;
+
+// properties
+	bool
+	is_open() const noexcept {
+		return 0 <= m_fd;
+	}
+
+	/**
+		Whether appends are refused because a failed append left
+		a torn record.
+	*/
+	bool
+	is_failed() const noexcept {
+		return m_failed;
+	}
+
+	/**
+		Number of records appended or replayed since the journal
+		was last truncated.
+	*/
+	std::size_t
+	num_records() const noexcept {
+		return m_num_records;
+	}
+
+	/**
+		Enable or disable syncing records to disk.
+
+		@note This is enabled by default. Without it, records
+		still reach the OS before append returns, so only a system
+		crash can lose them.
+	*/
+	void
+	set_sync(
+		bool const enable
+	) noexcept {
+		m_sync = enable;
+	}
+
+	/**
+		Enable or disable group commit.
+
+		With group commit, appended records are synced by commit()
+		instead of by every append. Disabling it commits.
+	*/
+	void
+	set_group_commit(
+		bool const enable
+	) noexcept;
+
+	/**
+		Number of syncs to disk.
+	*/
+	std::uint64_t
+	num_syncs() const noexcept {
+		return m_num_syncs.load(std::memory_order_relaxed);
+	}
+
+	/**
+		Time spent syncing in nanoseconds.
+	*/
+	std::uint64_t
+	sync_time() const noexcept {
+		return m_sync_time.load(std::memory_order_relaxed);
+	}
+
+// operations
+	/**
+		Open (or create) a journal file.
+	*/
+	bool
+	open(
+		String const& path
+	) noexcept;
+
+	void
+	close() noexcept;
+
+	/**
+		Discard all records.
+
+		This clears the failed state.
+	*/
+	bool
+	truncate() noexcept;
+
+	/**
+		Sync records appended since the last sync.
+
+		@returns @c false if the sync failed.
+	*/
+	bool
+	commit() noexcept;
+
+	/**
+		Append an assign record.
+
+		Throws SerializerError if the storage info could not be
+		serialized.
+	*/
+	bool
+	append_assign(
+		Hord::IO::StorageInfo const& sinfo
+	);
+
+	/**
+		Append an erase record.
+	*/
+	bool
+	append_erase(
+		Hord::Object::ID const object_id
+	) noexcept;
+
+	/**
+		Apply all records to a storage info map.
+
+		The IDs of all objects touched are inserted into @a touched.
+
+		A torn or corrupt tail is cut off the file.
+
+		Throws SerializerError if a record payload is malformed.
+
+		@returns The number of records replayed.
+	*/
+	std::size_t
+	replay(
+		Hord::IO::Datastore::storage_info_map_type& si_map,
+		aux::unordered_set<Hord::Object::IDValue>& touched
+	);
+};
+
+} // namespace IO
+} // namespace Onsang
@@ -0,0 +1,138 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+*/
+
+#include <Onsang/String.hpp>
+#include <Onsang/IO/MappedStreamBuf.hpp>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <algorithm>
+
+namespace Onsang {
+namespace IO {
+
+// class MappedStreamBuf implementation
+
+MappedStreamBuf::~MappedStreamBuf() noexcept {
+	close();
+}
+
+bool
+MappedStreamBuf::open(
+	String const& path
+) noexcept {
+	close();
+	signed const fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (0 > fd) {
+		return false;
+	}
+	struct ::stat st;
+	if (0 != ::fstat(fd, &st) || !S_ISREG(st.st_mode)) {
+		::close(fd);
+		return false;
+	}
+	m_size = static_cast<std::size_t>(st.st_size);
+	if (0u < m_size) {
+		void* const addr = ::mmap(
+			nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0
+		);
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+		bool const mapped = MAP_FAILED != addr;
+#pragma GCC diagnostic pop
+		if (!mapped) {
+			::close(fd);
+			m_size = 0u;
+			return false;
+		}
+		// Props are always read front-to-back
+		::madvise(addr, m_size, MADV_SEQUENTIAL);
+		m_data = static_cast<char*>(addr);
+	}
+	// The mapping holds its own reference to the file
+	::close(fd);
+	m_open = true;
+	setg(m_data, m_data, m_data + m_size);
+	return true;
+}
+
+void
+MappedStreamBuf::close() noexcept {
+	if (m_data) {
+		::munmap(m_data, m_size);
+	}
+	m_data = nullptr;
+	m_size = 0u;
+	m_open = false;
+	setg(nullptr, nullptr, nullptr);
+}
+
+// std::streambuf implementation
+
+MappedStreamBuf::pos_type
+MappedStreamBuf::seekoff(
+	off_type off,
+	std::ios_base::seekdir dir,
+	std::ios_base::openmode which
+) {
+	if (!(which & std::ios_base::in)) {
+		return pos_type(off_type(-1));
+	}
+	off_type base_off;
+	switch (dir) {
+	case std::ios_base::beg: base_off = 0; break;
+	case std::ios_base::cur: base_off = gptr() - eback(); break;
+	case std::ios_base::end: base_off = static_cast<off_type>(m_size); break;
+	default: return pos_type(off_type(-1));
+	}
+	return seekpos(pos_type(base_off + off), which);
+}
+
+MappedStreamBuf::pos_type
+MappedStreamBuf::seekpos(
+	pos_type pos,
+	std::ios_base::openmode which
+) {
+	off_type const off = pos;
+	if (
+		!(which & std::ios_base::in) ||
+		0 > off || static_cast<off_type>(m_size) < off
+	) {
+		return pos_type(off_type(-1));
+	}
+	setg(m_data, m_data + off, m_data + m_size);
+	return pos;
+}
+
+std::streamsize
+MappedStreamBuf::showmanyc() {
+	return
+		gptr() < egptr()
+		? static_cast<std::streamsize>(egptr() - gptr())
+		: std::streamsize(-1)
+	;
+}
+
+std::streamsize
+MappedStreamBuf::xsgetn(
+	char_type* s,
+	std::streamsize count
+) {
+	std::streamsize const avail = egptr() - gptr();
+	count = std::min(count, avail);
+	if (0 < count) {
+		std::memcpy(s, gptr(), static_cast<std::size_t>(count));
+		// gbump() takes an int; props can be larger than that
+		setg(eback(), gptr() + count, egptr());
+	}
+	return count;
+}
+
+} // namespace IO
+} // namespace Onsang
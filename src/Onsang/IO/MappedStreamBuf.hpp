@@ -0,0 +1,101 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+
+@file
+@brief Memory-mapped input stream buffer.
+*/
+
+#pragma once
+
+#include <Onsang/config.hpp>
+#include <Onsang/String.hpp>
+
+#include <streambuf>
+#include <ios>
+
+namespace Onsang {
+namespace IO {
+
+/**
+	Read-only stream buffer over a memory-mapped file.
+
+	The get area is the mapping itself, so reads through an
+	@c std::istream on this buffer do not copy into an
+	intermediate buffer.
+*/
+class MappedStreamBuf final
+	: public std::streambuf
+{
+private:
+	using base = std::streambuf;
+
+	char* m_data{nullptr};
+	std::size_t m_size{0u};
+	bool m_open{false};
+
+	MappedStreamBuf(MappedStreamBuf const&) = delete;
+	MappedStreamBuf(MappedStreamBuf&&) = delete;
+	MappedStreamBuf& operator=(MappedStreamBuf const&) = delete;
+	MappedStreamBuf& operator=(MappedStreamBuf&&) = delete;
+
+protected:
+// std::streambuf implementation
+	pos_type
+	seekoff(
+		off_type off,
+		std::ios_base::seekdir dir,
+		std::ios_base::openmode which
+	) override;
+
+	pos_type
+	seekpos(
+		pos_type pos,
+		std::ios_base::openmode which
+	) override;
+
+	std::streamsize
+	showmanyc() override;
+
+	std::streamsize
+	xsgetn(
+		char_type* s,
+		std::streamsize count
+	) override;
+
+public:
+// special member functions
+	~MappedStreamBuf() noexcept override;
+
+	MappedStreamBuf() noexcept = default;
+
+// properties
+	bool
+	is_open() const noexcept {
+		return m_open;
+	}
+
+	std::size_t
+	size() const noexcept {
+		return m_size;
+	}
+
+// operations
+	/**
+		Map a file.
+
+		@returns @c false if the file could not be opened or mapped.
+	*/
+	bool
+	open(
+		String const& path
+	) noexcept;
+
+	/**
+		Unmap the current file (if any).
+	*/
+	void
+	close() noexcept;
+};
+
+} // namespace IO
+} // namespace Onsang
@@ -0,0 +1,714 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+*/
+
+#include <Onsang/utility.hpp>
+#include <Onsang/String.hpp>
+#include <Onsang/serialization.hpp>
+#include <Onsang/Log.hpp>
+#include <Onsang/IO/FileSync.hpp>
+#include <Onsang/IO/PackedDatastore.hpp>
+
+#include <Hord/IO/StorageInfo.hpp>
+#include <Hord/IO/PropStream.hpp>
+#include <Hord/Object/Ops.hpp>
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+#include <boost/system/error_code.hpp>
+#include <boost/filesystem.hpp>
+#pragma GCC diagnostic pop
+
+#include <type_traits>
+#include <iterator>
+#include <utility>
+#include <new>
+#include <exception>
+
+#include <Onsang/detail/Hord/gr_ceformat.hpp>
+
+namespace Onsang {
+namespace IO {
+
+// class PackedDatastore implementation
+
+#define HORD_SCOPE_CLASS IO::PackedDatastore
+
+namespace {
+
+HORD_DEF_FMT(
+	s_err_object_not_found,
+	"%s: object %s does not exist"
+);
+
+enum : std::uint64_t {
+	// Extent alignment in the data file
+	extent_align = 64u,
+};
+
+inline static constexpr std::uint64_t
+extent_capacity(
+	std::uint64_t const length
+) noexcept {
+	// Leave room for the prop to grow in-place
+	return
+		((length + (length >> 2u) + extent_align - 1u) / extent_align)
+		* extent_align
+	;
+}
+
+} // anonymous namespace
+
+inline static constexpr bool
+prop_info_equal(
+	Hord::IO::PropInfo const& x,
+	Hord::IO::PropInfo const& y
+) noexcept {
+	return
+		x.object_id == y.object_id &&
+		x.prop_type == y.prop_type
+	;
+}
+
+Hord::IO::Datastore::UPtr
+PackedDatastore::construct(
+	Hord::String root_path
+) noexcept {
+	return Hord::IO::Datastore::UPtr{
+		new(std::nothrow) IO::PackedDatastore(std::move(root_path))
+	};
+}
+
+IO::PackedDatastore::base::TypeInfo const
+PackedDatastore::s_type_info{
+	IO::PackedDatastore::construct
+};
+
+PackedDatastore::PackedDatastore(
+	Hord::String root_path
+)
+	: base(
+		IO::PackedDatastore::s_type_info,
+		std::move(root_path)
+	)
+	, m_lock()
+	, m_data()
+	, m_data_end(0u)
+	, m_extents()
+	, m_free()
+	, m_pending_free()
+	, m_unpersisted()
+	, m_index_dirty(false)
+	, m_prop()
+{}
+
+void
+PackedDatastore::read_index(
+	std::istream& stream
+) {
+	auto ser = make_input_serializer(stream);
+	auto& si_map = storage_info();
+	si_map.clear();
+	m_extents.clear();
+	m_free.clear();
+	m_pending_free.clear();
+	m_unpersisted.clear();
+	m_index_dirty = false;
+
+	std::uint32_t size = 0u;
+	ser(size);
+	Hord::IO::StorageInfo sinfo{
+		Hord::Object::ID_NULL,
+		Hord::Object::TYPE_NULL,
+		{true, true},
+		Hord::IO::Linkage::resident
+	};
+	while (size--) {
+		ser(sinfo);
+		si_map.emplace(sinfo.object_id, sinfo);
+	}
+
+	ser(size);
+	std::uint64_t key = 0u;
+	Extent extent{0u, 0u, 0u};
+	while (size--) {
+		ser(key, extent.offset, extent.length, extent.capacity);
+		m_extents.emplace(key, extent);
+	}
+
+	ser(size);
+	while (size--) {
+		ser(extent.offset, extent.capacity);
+		m_free.emplace(extent.offset, extent.capacity);
+	}
+	ser(m_data_end);
+}
+
+void
+PackedDatastore::write_index(
+	std::ostream& stream
+) {
+	auto ser = make_output_serializer(stream);
+	auto& si_map = storage_info();
+	ser(static_cast<std::uint32_t>(si_map.size()));
+	for (auto const& si_pair : si_map) {
+		ser(si_pair.second);
+	}
+
+	ser(static_cast<std::uint32_t>(m_extents.size()));
+	for (auto const& extent_pair : m_extents) {
+		auto const& extent = extent_pair.second;
+		ser(extent_pair.first, extent.offset, extent.length, extent.capacity);
+	}
+
+	ser(static_cast<std::uint32_t>(m_free.size()));
+	for (auto const& free_pair : m_free) {
+		ser(free_pair.first, free_pair.second);
+	}
+	ser(m_data_end);
+}
+
+PackedDatastore::Extent
+PackedDatastore::allocate_extent(
+	std::uint64_t const length
+) {
+	std::uint64_t const capacity = max_ce(
+		std::uint64_t{extent_align},
+		extent_capacity(length)
+	);
+	// First fit from the free list
+	for (auto it = m_free.begin(); m_free.end() != it; ++it) {
+		if (it->second < capacity) {
+			continue;
+		}
+		Extent const extent{it->first, length, capacity};
+		auto const remaining = it->second - capacity;
+		m_free.erase(it);
+		if (0u < remaining) {
+			m_free.emplace(extent.offset + capacity, remaining);
+		}
+		return extent;
+	}
+	Extent const extent{m_data_end, length, capacity};
+	m_data_end += capacity;
+	return extent;
+}
+
+void
+PackedDatastore::free_extent(
+	std::uint64_t offset,
+	std::uint64_t capacity
+) {
+	// Coalesce with the following extent
+	auto next = m_free.find(offset + capacity);
+	if (m_free.end() != next) {
+		capacity += next->second;
+		m_free.erase(next);
+	}
+	// Coalesce with the preceding extent
+	auto it = m_free.lower_bound(offset);
+	if (m_free.begin() != it) {
+		auto prev = std::prev(it);
+		if (prev->first + prev->second == offset) {
+			offset = prev->first;
+			capacity += prev->second;
+			m_free.erase(prev);
+		}
+	}
+	if (offset + capacity == m_data_end) {
+		m_data_end = offset;
+	} else {
+		m_free.emplace(offset, capacity);
+	}
+}
+
+void
+PackedDatastore::retire_extent(
+	std::uint64_t const key,
+	Extent const& extent
+) {
+	if (m_unpersisted.erase(key)) {
+		// Not referenced by the index on disk
+		free_extent(extent.offset, extent.capacity);
+	} else {
+		m_pending_free.emplace(extent.offset, extent.capacity);
+	}
+}
+
+#define HORD_SCOPE_FUNC sync_data
+bool
+PackedDatastore::sync_data() noexcept {
+	m_data.flush();
+	if (m_data.fail() || !sync_file(root_path() + "/data")) {
+		Log::acquire(Log::error)
+			<< DUCT_GR_MSG_FQN("failed to sync data file\n")
+		;
+		return false;
+	}
+	return true;
+}
+#undef HORD_SCOPE_FUNC
+
+#define HORD_SCOPE_FUNC persist_index
+bool
+PackedDatastore::persist_index() {
+	// The new index must only refer to data that is on disk
+	if (!sync_data()) {
+		return false;
+	}
+
+	// The written free list includes the pending extents, since the
+	// new index does not reference them
+	auto const free = m_free;
+	auto const data_end = m_data_end;
+	for (auto const& free_pair : m_pending_free) {
+		free_extent(free_pair.first, free_pair.second);
+	}
+
+	auto const index_path = root_path() + "/index";
+	auto const temp_path = index_path + ".tmp";
+	bool written = false;
+	std::ofstream index_stream{
+		temp_path,
+		std::ios_base::out | std::ios_base::binary | std::ios_base::trunc
+	};
+	if (index_stream.is_open()) {
+		try {
+			write_index(index_stream);
+			index_stream.close();
+			written = !index_stream.fail();
+		} catch (...) {
+			Log::acquire(Log::error)
+				<< DUCT_GR_MSG_FQN("failed to write index file: '")
+				<< temp_path
+				<< "':\n"
+			;
+			Log::report_error_ptr(std::current_exception());
+		}
+	} else {
+		Log::acquire(Log::error)
+			<< DUCT_GR_MSG_FQN("failed to open index file for writing: '")
+			<< temp_path
+			<< "'\n"
+		;
+	}
+	if (written && !replace_file(temp_path, index_path, root_path())) {
+		Log::acquire(Log::error)
+			<< DUCT_GR_MSG_FQN("failed to replace index file: '")
+			<< index_path
+			<< "'\n"
+		;
+		written = false;
+	}
+	if (written) {
+		m_pending_free.clear();
+		m_unpersisted.clear();
+		m_index_dirty = false;
+	} else {
+		// The index on disk still references the pending extents
+		m_free = free;
+		m_data_end = data_end;
+	}
+	return written;
+}
+#undef HORD_SCOPE_FUNC
+
+#define HORD_SCOPE_FUNC commit
+void
+PackedDatastore::commit() noexcept {
+	if (!m_index_dirty || !is_open()) {
+		return;
+	}
+	try {
+		persist_index();
+	} catch (...) {
+		Log::acquire(Log::error)
+			<< DUCT_GR_MSG_FQN("failed to persist index:\n")
+		;
+		Log::report_error_ptr(std::current_exception());
+	}
+}
+#undef HORD_SCOPE_FUNC
+
+#define HORD_SCOPE_FUNC acquire_stream
+namespace {
+HORD_DEF_FMT_FQN(
+	s_err_acquire_prop_unsupplied,
+	"prop %s -> %s is not supplied for type %s"
+);
+HORD_DEF_FMT_FQN(
+	s_err_acquire_prop_void,
+	"prop %s -> %s is void"
+);
+} // anonymous namespace
+
+void
+PackedDatastore::acquire_stream(
+	Hord::IO::PropInfo const& prop_info,
+	bool const is_input
+) {
+	auto& sinfo_map = storage_info();
+	auto it = sinfo_map.find(prop_info.object_id);
+	if (sinfo_map.cend() == it) {
+		HORD_THROW_FMT(
+			Hord::ErrorCode::datastore_object_not_found,
+			s_err_object_not_found,
+			HORD_SCOPE_FQN_STR_LIT,
+			Hord::Object::IDPrinter{prop_info.object_id}
+		);
+	}
+
+	auto& sinfo = it->second;
+	if (!sinfo.prop_storage.supplies(prop_info.prop_type)) {
+		HORD_THROW_FMT(
+			Hord::ErrorCode::datastore_prop_unsupplied,
+			s_err_acquire_prop_unsupplied,
+			Hord::Object::IDPrinter{prop_info.object_id},
+			Hord::IO::get_prop_type_name(prop_info.prop_type),
+			Hord::Object::get_base_type_name(sinfo.object_type.base())
+		);
+	}
+
+	if (is_input) {
+		auto const extent_it = m_extents.find(
+			extent_key(prop_info.object_id, prop_info.prop_type)
+		);
+		if (
+			!sinfo.prop_storage.is_initialized(prop_info.prop_type) ||
+			m_extents.cend() == extent_it
+		) {
+			HORD_THROW_FMT(
+				Hord::ErrorCode::datastore_prop_void,
+				s_err_acquire_prop_void,
+				Hord::Object::IDPrinter{prop_info.object_id},
+				Hord::IO::get_prop_type_name(prop_info.prop_type)
+			);
+		}
+		// Read straight from the data file, but only the prop's extent
+		m_data.clear();
+		m_prop.input_buf.reset(
+			*m_data.rdbuf(),
+			extent_it->second.offset,
+			extent_it->second.length
+		);
+		m_prop.input.clear();
+	} else {
+		m_prop.output_buf.clear();
+		m_prop.output.clear();
+	}
+
+	m_prop.info = prop_info;
+	m_prop.sinfo = &sinfo;
+	m_prop.is_input = is_input;
+	base::enable_state(State::locked);
+}
+#undef HORD_SCOPE_FUNC
+
+#define HORD_SCOPE_FUNC release_stream
+namespace {
+HORD_DEF_FMT_FQN(
+	s_err_release_prop_not_locked,
+	"prop %s -> %s is not locked"
+);
+HORD_DEF_FMT_FQN(
+	s_err_release_prop_write_failed,
+	"failed to write prop %s -> %s to data file"
+);
+} // anonymous namespace
+
+void
+PackedDatastore::release_stream(
+	Hord::IO::PropInfo const& prop_info,
+	bool const is_input
+) {
+	if (
+		!prop_info_equal(m_prop.info, prop_info) ||
+		is_input != m_prop.is_input
+	) {
+		HORD_THROW_FMT(
+			Hord::ErrorCode::datastore_prop_not_locked,
+			s_err_release_prop_not_locked,
+			Hord::Object::IDPrinter{prop_info.object_id},
+			Hord::IO::get_prop_type_name(prop_info.prop_type)
+		);
+	}
+
+	if (!is_input) {
+		auto const& buffer = m_prop.output_buf;
+		std::uint64_t const length = buffer.size();
+		auto const key = extent_key(prop_info.object_id, prop_info.prop_type);
+		auto it = m_extents.find(key);
+		if (m_extents.end() == it) {
+			it = m_extents.emplace(key, allocate_extent(length)).first;
+			m_unpersisted.emplace(key);
+		} else if (
+			m_unpersisted.count(key) &&
+			length <= it->second.capacity
+		) {
+			// Not referenced by the index on disk; rewrite in-place
+			it->second.length = length;
+		} else {
+			retire_extent(key, it->second);
+			it->second = allocate_extent(length);
+			m_unpersisted.emplace(key);
+		}
+		m_index_dirty = true;
+		m_data.clear();
+		m_data.seekp(static_cast<std::streamoff>(it->second.offset));
+		m_data.write(buffer.data(), static_cast<std::streamsize>(length));
+		if (m_data.fail()) {
+			// TODO: This should really not be datastore_prop_void
+			m_prop.reset();
+			base::disable_state(State::locked);
+			HORD_THROW_FMT(
+				Hord::ErrorCode::datastore_prop_void,
+				s_err_release_prop_write_failed,
+				Hord::Object::IDPrinter{prop_info.object_id},
+				Hord::IO::get_prop_type_name(prop_info.prop_type)
+			);
+		}
+	}
+	m_prop.sinfo->prop_storage.assign(
+		m_prop.info.prop_type,
+		Hord::IO::PropState::original
+	);
+	m_prop.reset();
+	base::disable_state(State::locked);
+}
+#undef HORD_SCOPE_FUNC
+
+
+// Hord::IO::Datastore implementation
+
+#define HORD_SCOPE_FUNC open_impl
+void
+PackedDatastore::open_impl(
+	bool const create_if_nonexistent
+) try {
+	// NB: open() protects us from the ill logic of trying to open
+	// when the datastore is already open
+
+	bool do_index = true;
+
+	namespace fs = boost::filesystem;
+	boost::system::error_code ec;
+	fs::path const path{root_path()};
+	auto const stat = fs::status(path, ec);
+	if (!fs::is_directory(stat)) {
+		HORD_THROW_FQN(
+			Hord::ErrorCode::datastore_open_failed,
+			"root path does not exist or is not a directory"
+		);
+	}
+
+	auto const data_path = root_path() + "/data";
+	if (
+		create_if_nonexistent &&
+		fs::directory_iterator(path, ec) == fs::directory_iterator()
+	) {
+		std::ofstream data_stream{data_path, std::ios_base::binary};
+		if (!data_stream.is_open()) {
+			HORD_THROW_FQN(
+				Hord::ErrorCode::datastore_open_failed,
+				"failed to create data file"
+			);
+		}
+		m_extents.clear();
+		m_free.clear();
+		m_pending_free.clear();
+		m_unpersisted.clear();
+		m_data_end = 0u;
+		m_index_dirty = false;
+		do_index = false;
+	}
+
+	m_lock.set_path(root_path() + "/.lock");
+	try {
+		m_lock.acquire();
+		base::enable_state(State::opened);
+	} catch (...) {
+		HORD_THROW_FQN(
+			Hord::ErrorCode::datastore_open_failed,
+			"failed to obtain datastore lockfile"
+		);
+	}
+
+	m_data.open(
+		data_path,
+		std::ios_base::binary | std::ios_base::in | std::ios_base::out
+	);
+	if (!m_data.is_open()) {
+		HORD_THROW_FQN(
+			Hord::ErrorCode::datastore_open_failed,
+			"failed to open data file"
+		);
+	}
+
+	if (!do_index) {
+		// Without an index on disk, nothing in a new datastore
+		// would survive a crash before the first commit
+		if (!persist_index()) {
+			HORD_THROW_FQN(
+				Hord::ErrorCode::datastore_open_failed,
+				"failed to write index file"
+			);
+		}
+	} else {
+		auto const index_path = root_path() + "/index";
+		std::ifstream index_stream{index_path, std::ios_base::binary};
+		if (!index_stream.is_open()) {
+			HORD_THROW_FQN(
+				Hord::ErrorCode::datastore_open_failed,
+				"failed to open index file for reading"
+			);
+		}
+		std::exception_ptr eptr;
+		try {
+			read_index(index_stream);
+		} catch (...) {
+			eptr = std::current_exception();
+		}
+		index_stream.close();
+		if (eptr) {
+			Log::acquire(Log::error)
+				<< DUCT_GR_MSG_FQN("failed to read index file:\n")
+			;
+			Log::report_error_ptr(eptr);
+			HORD_THROW_FQN(
+				Hord::ErrorCode::datastore_open_failed,
+				"failed to read index file"
+			);
+		}
+	}
+} catch (...) {
+	if (m_data.is_open()) {
+		m_data.close();
+	}
+	m_lock.release();
+	throw;
+}
+#undef HORD_SCOPE_FUNC
+
+#define HORD_SCOPE_FUNC close_impl
+void
+PackedDatastore::close_impl() {
+	// NB: close() protects us from is_locked()
+
+	// Written even if clean, so a failed commit is retried
+	try {
+		persist_index();
+	} catch (...) {
+		Log::acquire(Log::error)
+			<< DUCT_GR_MSG_FQN("failed to persist index:\n")
+		;
+		Log::report_error_ptr(std::current_exception());
+	}
+	m_data.close();
+	m_pending_free.clear();
+	m_unpersisted.clear();
+	m_index_dirty = false;
+
+	m_lock.release();
+	base::disable_state(State::opened);
+}
+#undef HORD_SCOPE_FUNC
+
+// acquire
+std::istream&
+PackedDatastore::acquire_input_stream_impl(
+	Hord::IO::PropInfo const& prop_info
+) {
+	acquire_stream(prop_info, true);
+	return m_prop.input;
+}
+
+std::ostream&
+PackedDatastore::acquire_output_stream_impl(
+	Hord::IO::PropInfo const& prop_info
+) {
+	acquire_stream(prop_info, false);
+	return m_prop.output;
+}
+
+// release
+void
+PackedDatastore::release_input_stream_impl(
+	Hord::IO::PropInfo const& prop_info
+) {
+	release_stream(prop_info, true);
+}
+
+void
+PackedDatastore::release_output_stream_impl(
+	Hord::IO::PropInfo const& prop_info
+) {
+	release_stream(prop_info, false);
+}
+
+
+// objects
+Hord::Object::ID
+PackedDatastore::generate_id_impl(
+	Hord::System::IDGenerator& id_generator
+) const noexcept {
+	return id_generator.generate_unique(make_const(storage_info()));
+}
+
+#define HORD_SCOPE_FUNC create_object_impl
+Hord::IO::Datastore::storage_info_map_type::const_iterator
+PackedDatastore::create_object_impl(
+	Hord::Object::ID const object_id,
+	Hord::Object::TypeInfo const& type_info,
+	Hord::IO::Linkage const linkage
+) {
+	// NB: Base protects us from: closed state, locked state, and
+	// IDs that already exist
+	auto const emplace_pair = storage_info().emplace(
+		object_id,
+		Hord::IO::StorageInfo{
+			object_id,
+			type_info.type,
+			{true, true},
+			linkage
+		}
+	);
+	m_index_dirty = true;
+	return emplace_pair.first;
+}
+#undef HORD_SCOPE_FUNC
+
+#define HORD_SCOPE_FUNC destroy_object_impl
+void
+PackedDatastore::destroy_object_impl(
+	Hord::Object::ID const object_id
+) {
+	auto& sinfo_map = storage_info();
+	auto const it = sinfo_map.find(object_id);
+	if (sinfo_map.cend() == it) {
+		HORD_THROW_FMT(
+			Hord::ErrorCode::datastore_object_not_found,
+			s_err_object_not_found,
+			HORD_SCOPE_FQN_STR_LIT,
+			Hord::Object::IDPrinter{object_id}
+		);
+	}
+	// Return the object's extents to the free list
+	for (unsigned index = 0u; index < enum_cast(Hord::IO::PropType::LAST); ++index) {
+		auto const extent_it = m_extents.find(extent_key(
+			object_id,
+			static_cast<Hord::IO::PropType>(index)
+		));
+		if (m_extents.end() != extent_it) {
+			retire_extent(extent_it->first, extent_it->second);
+			m_extents.erase(extent_it);
+		}
+	}
+	sinfo_map.erase(it);
+	m_index_dirty = true;
+}
+#undef HORD_SCOPE_FUNC
+
+#undef HORD_SCOPE_CLASS // PackedDatastore
+
+} // namespace IO
+} // namespace Onsang
@@ -0,0 +1,296 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+
+@file
+@brief Packed single-file datastore.
+*/
+
+#pragma once
+
+#include <Onsang/config.hpp>
+#include <Onsang/aux.hpp>
+#include <Onsang/utility.hpp>
+#include <Onsang/String.hpp>
+#include <Onsang/IO/ExtentStreamBuf.hpp>
+#include <Onsang/IO/BufferStreamBuf.hpp>
+
+#include <Hord/LockFile.hpp>
+#include <Hord/Object/Defs.hpp>
+#include <Hord/IO/Defs.hpp>
+#include <Hord/IO/Prop.hpp>
+#include <Hord/IO/StorageInfo.hpp>
+#include <Hord/IO/Datastore.hpp>
+
+#include <cstdint>
+#include <iostream>
+#include <fstream>
+
+/*
+
+Packed datastore.
+
+Every prop lives in a single data file as an extent. The index
+maps (object ID, prop type) to the prop's extent.
+
+Structure:
+
+"root/"
+	".lock" LockFile;
+	"index" <storage info> <extent table> <free extent table>;
+	"data" <prop extents>;
+
+Extents referenced by the index on disk are never overwritten:
+a prop written after the index was last persisted goes to a new
+extent, and the extents it replaces are only reused once an index
+that no longer references them has been written.
+
+The index is written when the datastore is created, by commit()
+after each command that changed it, and on close. The data file
+is synced before each write, and the new index replaces the old
+one through a synced temporary file, so after a crash the index
+on disk only refers to data on disk.
+
+*/
+
+namespace Onsang {
+namespace IO {
+
+class PackedDatastore final
+	: public Hord::IO::Datastore
+{
+public:
+	using base = Hord::IO::Datastore;
+	using base::State;
+
+	static base::TypeInfo const
+	s_type_info;
+
+	/**
+		Prop extent in the data file.
+	*/
+	struct Extent {
+		std::uint64_t offset;
+		std::uint64_t length;
+		std::uint64_t capacity;
+	};
+
+	/**
+		Extent map.
+
+		Keyed by extent_key().
+	*/
+	using extent_map_type = aux::unordered_map<
+		std::uint64_t,
+		Extent
+	>;
+
+	/**
+		Free extent map (offset to capacity).
+	*/
+	using free_map_type = aux::map<
+		std::uint64_t,
+		std::uint64_t
+	>;
+
+private:
+	Hord::LockFile m_lock;
+	std::fstream m_data;
+	std::uint64_t m_data_end;
+	extent_map_type m_extents;
+	free_map_type m_free;
+	/** Extents freed since the index was last written. */
+	free_map_type m_pending_free;
+	/** Keys of extents allocated since the index was last written. */
+	aux::unordered_set<std::uint64_t> m_unpersisted;
+	/** Whether anything in the index changed since it was written. */
+	bool m_index_dirty;
+
+	struct {
+		Hord::IO::PropInfo info{
+			Hord::Object::ID_NULL,
+			Hord::Object::TYPE_NULL,
+			Hord::IO::PropType::identity
+		};
+		Hord::IO::StorageInfo* sinfo;
+		IO::ExtentStreamBuf input_buf{};
+		std::istream input{&input_buf};
+		IO::BufferStreamBuf output_buf{};
+		std::ostream output{&output_buf};
+		bool is_input{false};
+
+		void
+		reset() noexcept {
+			info.object_id = Hord::Object::ID_NULL;
+			sinfo = nullptr;
+			input_buf.close();
+		}
+	} m_prop;
+
+	static Hord::IO::Datastore::UPtr
+	construct(
+		Hord::String root_path
+	) noexcept;
+
+	PackedDatastore() = delete;
+	PackedDatastore(PackedDatastore const&) = delete;
+	PackedDatastore(PackedDatastore&&) = delete;
+	PackedDatastore& operator=(PackedDatastore const&) = delete;
+	PackedDatastore& operator=(PackedDatastore&&) = delete;
+
+	PackedDatastore(
+		Hord::String root_path
+	);
+
+public:
+	~PackedDatastore() noexcept override = default;
+
+	static constexpr std::uint64_t
+	extent_key(
+		Hord::Object::ID const object_id,
+		Hord::IO::PropType const prop_type
+	) noexcept {
+		return
+			(static_cast<std::uint64_t>(object_id.value()) << 8u) |
+			static_cast<std::uint64_t>(prop_type)
+		;
+	}
+
+private:
+	void
+	read_index(
+		std::istream&
+	);
+
+	void
+	write_index(
+		std::ostream&
+	);
+
+	Extent
+	allocate_extent(
+		std::uint64_t const length
+	);
+
+	void
+	free_extent(
+		std::uint64_t offset,
+		std::uint64_t capacity
+	);
+
+	/**
+		Free the extent of @a key once it is no longer
+		referenced by the index on disk.
+	*/
+	void
+	retire_extent(
+		std::uint64_t const key,
+		Extent const& extent
+	);
+
+	/**
+		Flush and sync the data file.
+	*/
+	bool
+	sync_data() noexcept;
+
+	/**
+		Sync the data file, then write the index through a
+		temporary file.
+
+		Pending extents are made reusable only if the index was
+		written.
+	*/
+	bool
+	persist_index();
+
+	void
+	acquire_stream(
+		Hord::IO::PropInfo const&,
+		bool const is_input
+	);
+	void
+	release_stream(
+		Hord::IO::PropInfo const&,
+		bool const is_input
+	);
+
+// Hord::IO::Datastore implementation
+private:
+	void
+	open_impl(
+		bool const create_if_nonexistent
+	) override;
+
+	void
+	close_impl() override;
+
+// acquire
+	std::istream&
+	acquire_input_stream_impl(
+		Hord::IO::PropInfo const&
+	) override;
+
+	std::ostream&
+	acquire_output_stream_impl(
+		Hord::IO::PropInfo const&
+	) override;
+
+// release
+	void
+	release_input_stream_impl(
+		Hord::IO::PropInfo const&
+	) override;
+
+	void
+	release_output_stream_impl(
+		Hord::IO::PropInfo const&
+	) override;
+
+// objects
+	Hord::Object::ID
+	generate_id_impl(
+		Hord::System::IDGenerator&
+	) const noexcept override;
+
+	Hord::IO::Datastore::storage_info_map_type::const_iterator
+	create_object_impl(
+		Hord::Object::ID const,
+		Hord::Object::TypeInfo const&,
+		Hord::IO::Linkage const
+	) override;
+
+	void
+	destroy_object_impl(
+		Hord::Object::ID const
+	) override;
+
+public:
+// operations
+	/**
+		Persist the index if objects or props changed since it was
+		last written.
+
+		Call after each command; until then, its changes are lost
+		if the process dies.
+	*/
+	void
+	commit() noexcept;
+
+// properties
+	extent_map_type const&
+	extents() const noexcept {
+		return m_extents;
+	}
+
+	free_map_type const&
+	free_extents() const noexcept {
+		return m_free;
+	}
+};
+
+} // namespace IO
+} // namespace Onsang
+
+template struct Hord::IO::Datastore::ensure_traits<
+	Onsang::IO::PackedDatastore
+>;
@@ -2,6 +2,9 @@
 @copyright MIT license; see @ref index or the accompanying LICENSE file.
 */
 
+#include <Onsang/aux.hpp>
+#include <Onsang/utility.hpp>
+#include <Onsang/String.hpp>
 #include <Onsang/Error.hpp>
 #include <Onsang/serialization.hpp>
 #include <Onsang/Log.hpp>
@@ -10,11 +13,437 @@
 
 #include <Hord/Error.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
 #include <exception>
+#include <mutex>
+#include <thread>
 
 namespace Onsang {
 namespace Log {
 
+namespace detail {
+std::atomic<bool> s_debug{true};
+} // namespace detail
+
+namespace {
+
+enum : std::size_t {
+	/** Bytes per thread ring. */
+	RING_SIZE = 1u << 18,
+};
+
+enum : unsigned {
+	/** Longest wait between flushes, in milliseconds. */
+	FLUSH_INTERVAL = 25u,
+};
+
+struct RecordHeader {
+	std::uint64_t sequence;
+	std::uint32_t size;
+	std::uint32_t type;
+};
+
+/**
+	Single-producer, single-consumer byte ring.
+
+	Only the owning thread advances head; only the flush thread
+	advances tail. Records may wrap around the end.
+*/
+struct Ring {
+	aux::unique_ptr<char[]> data{new char[RING_SIZE]};
+	std::atomic<std::uint64_t> head{0u};
+	std::atomic<std::uint64_t> tail{0u};
+	/** Messages dropped because the ring was full. */
+	std::atomic<std::uint64_t> dropped{0u};
+	/** Set when the owning thread exits. */
+	std::atomic<bool> closed{false};
+
+	void
+	copy_in(
+		std::uint64_t const position,
+		void const* const src,
+		std::size_t const size
+	) noexcept {
+		auto const offset = static_cast<std::size_t>(position % RING_SIZE);
+		auto const first = min_ce(size, RING_SIZE - offset);
+		std::memcpy(data.get() + offset, src, first);
+		std::memcpy(data.get(), static_cast<char const*>(src) + first, size - first);
+	}
+
+	void
+	copy_out(
+		std::uint64_t const position,
+		void* const dst,
+		std::size_t const size
+	) const noexcept {
+		auto const offset = static_cast<std::size_t>(position % RING_SIZE);
+		auto const first = min_ce(size, RING_SIZE - offset);
+		std::memcpy(dst, data.get() + offset, first);
+		std::memcpy(static_cast<char*>(dst) + first, data.get(), size - first);
+	}
+};
+
+struct State {
+	std::mutex mutex{};
+	std::condition_variable cv{};
+	/** Registered rings; guarded by mutex. */
+	aux::vector<aux::shared_ptr<Ring>> rings{};
+	std::thread thread{};
+	std::atomic<bool> running{false};
+	std::atomic<bool> pending{false};
+	std::atomic<std::uint64_t> sequence{0u};
+	/** Messages dropped by threads without a ring. */
+	std::atomic<std::uint64_t> dropped{0u};
+	bool stop{false};
+	std::uint64_t flush_requested{0u};
+	std::uint64_t flush_completed{0u};
+
+	~State() noexcept {
+		Log::stop_async();
+	}
+};
+
+struct ThreadLog {
+	aux::shared_ptr<Ring> ring{};
+	/** Formatting buffer for the outermost stream. */
+	String scratch{};
+	bool scratch_busy{false};
+
+	~ThreadLog() noexcept {
+		if (ring) {
+			ring->closed.store(true, std::memory_order_release);
+		}
+	}
+};
+
+static State s_state{};
+static thread_local ThreadLog t_log{};
+
+static void
+write_sync(
+	unsigned const type,
+	String const& text
+) noexcept try {
+	if (Log::Stream::TYPE_DEFAULT == type) {
+		Hord::Log::acquire() << text;
+	} else {
+		Hord::Log::acquire(static_cast<Hord::Log::OutputType>(type)) << text;
+	}
+} catch (...) {
+	// Nowhere left to report to
+}
+
+static void
+wake() noexcept {
+	s_state.pending.store(true, std::memory_order_release);
+	// A notify that races the flush thread going to sleep is lost,
+	// which only delays the message by FLUSH_INTERVAL
+	s_state.cv.notify_one();
+}
+
+static void
+enqueue(
+	unsigned const type,
+	String const& text
+) noexcept {
+	// The flush thread is the controller's only writer while it
+	// runs, so nothing here may fall back to write_sync()
+	auto const size = min_ce(text.size(), RING_SIZE - sizeof(RecordHeader));
+	auto const needed = sizeof(RecordHeader) + size;
+	if (!t_log.ring) {
+		try {
+			auto ring = aux::make_shared<Ring>();
+			std::lock_guard<std::mutex> lock{s_state.mutex};
+			s_state.rings.push_back(ring);
+			t_log.ring = std::move(ring);
+		} catch (...) {
+			s_state.dropped.fetch_add(1u, std::memory_order_relaxed);
+			wake();
+			return;
+		}
+	}
+	auto& ring = *t_log.ring;
+	auto const head = ring.head.load(std::memory_order_relaxed);
+	auto const tail = ring.tail.load(std::memory_order_acquire);
+	if (RING_SIZE - (head - tail) < needed) {
+		// Never wait on the flush thread
+		ring.dropped.fetch_add(1u, std::memory_order_relaxed);
+		wake();
+		return;
+	}
+	// Oversized messages keep as much of their start as fits
+	RecordHeader const header{
+		s_state.sequence.fetch_add(1u, std::memory_order_relaxed),
+		static_cast<std::uint32_t>(size),
+		type
+	};
+	ring.copy_in(head, &header, sizeof(header));
+	ring.copy_in(head + sizeof(header), text.data(), size);
+	ring.head.store(head + needed, std::memory_order_release);
+	if (
+		static_cast<unsigned>(Hord::Log::error) == type ||
+		RING_SIZE / 2u < head + needed - tail
+	) {
+		wake();
+	}
+}
+
+/**
+	Write everything queued in @a rings, ordered by sequence.
+*/
+static void
+drain(
+	aux::vector<aux::shared_ptr<Ring>> const& rings,
+	String& message
+) noexcept {
+	struct Cursor {
+		Ring* ring;
+		std::uint64_t tail;
+		std::uint64_t head;
+		RecordHeader header;
+	};
+
+	aux::vector<Cursor> cursors;
+	for (auto const& ring : rings) {
+		Cursor cursor{
+			ring.get(),
+			ring->tail.load(std::memory_order_relaxed),
+			ring->head.load(std::memory_order_acquire),
+			{}
+		};
+		if (cursor.tail != cursor.head) {
+			ring->copy_out(cursor.tail, &cursor.header, sizeof(RecordHeader));
+			cursors.push_back(cursor);
+		}
+	}
+	while (!cursors.empty()) {
+		auto it = std::min_element(
+			cursors.begin(), cursors.end(),
+			[](Cursor const& x, Cursor const& y) {
+				return x.header.sequence < y.header.sequence;
+			}
+		);
+		auto& cursor = *it;
+		message.resize(cursor.header.size);
+		cursor.ring->copy_out(
+			cursor.tail + sizeof(RecordHeader), &message[0], message.size()
+		);
+		write_sync(cursor.header.type, message);
+		cursor.tail += sizeof(RecordHeader) + cursor.header.size;
+		cursor.ring->tail.store(cursor.tail, std::memory_order_release);
+		if (cursor.tail == cursor.head) {
+			cursors.erase(it);
+		} else {
+			cursor.ring->copy_out(cursor.tail, &cursor.header, sizeof(RecordHeader));
+		}
+	}
+	auto dropped = s_state.dropped.exchange(0u, std::memory_order_relaxed);
+	for (auto const& ring : rings) {
+		dropped += ring->dropped.exchange(0u, std::memory_order_relaxed);
+	}
+	if (0u < dropped) {
+		message.assign("Log: dropped ");
+		message.append(std::to_string(dropped));
+		message.append(" messages\n");
+		write_sync(static_cast<unsigned>(Hord::Log::error), message);
+	}
+}
+
+static void
+run() noexcept {
+	String message;
+	aux::vector<aux::shared_ptr<Ring>> rings;
+	aux::vector<Ring*> retired;
+	std::unique_lock<std::mutex> lock{s_state.mutex};
+	while (true) {
+		s_state.cv.wait_for(
+			lock,
+			std::chrono::milliseconds{FLUSH_INTERVAL},
+			[]() {
+				return
+					s_state.stop ||
+					s_state.flush_requested != s_state.flush_completed ||
+					s_state.pending.load(std::memory_order_acquire)
+				;
+			}
+		);
+		s_state.pending.store(false, std::memory_order_relaxed);
+		bool const stopping = s_state.stop;
+		auto const target = s_state.flush_requested;
+		rings = s_state.rings;
+		lock.unlock();
+
+		// A closed ring gets no more records, so it is empty after
+		// this drain
+		retired.clear();
+		for (auto const& ring : rings) {
+			if (ring->closed.load(std::memory_order_acquire)) {
+				retired.push_back(ring.get());
+			}
+		}
+		drain(rings, message);
+		rings.clear();
+
+		lock.lock();
+		if (!retired.empty()) {
+			auto& registered = s_state.rings;
+			registered.erase(
+				std::remove_if(
+					registered.begin(), registered.end(),
+					[&retired](aux::shared_ptr<Ring> const& ring) {
+						return retired.cend() != std::find(
+							retired.cbegin(), retired.cend(), ring.get()
+						);
+					}
+				),
+				registered.end()
+			);
+		}
+		s_state.flush_completed = target;
+		s_state.cv.notify_all();
+		if (stopping) {
+			break;
+		}
+	}
+}
+
+} // anonymous namespace
+
+// class Stream implementation
+
+Stream::Buffer::~Buffer() noexcept {
+	if (m_owned) {
+		delete m_text;
+	} else if (m_text) {
+		m_text->clear();
+		t_log.scratch_busy = false;
+	}
+}
+
+Stream::Buffer::Buffer() noexcept {
+	if (!t_log.scratch_busy) {
+		t_log.scratch_busy = true;
+		m_text = &t_log.scratch;
+	} else {
+		// Nested stream on this thread
+		m_text = new String();
+		m_owned = true;
+	}
+}
+
+Stream::Buffer::Buffer(Buffer&& other) noexcept
+	: std::streambuf()
+	, m_text(other.m_text)
+	, m_owned(other.m_owned)
+{
+	other.m_text = nullptr;
+	other.m_owned = false;
+}
+
+Stream::Buffer::int_type
+Stream::Buffer::overflow(
+	int_type const c
+) {
+	if (!traits_type::eq_int_type(c, traits_type::eof())) {
+		m_text->push_back(traits_type::to_char_type(c));
+	}
+	return traits_type::not_eof(c);
+}
+
+std::streamsize
+Stream::Buffer::xsputn(
+	char_type const* const data,
+	std::streamsize const size
+) {
+	m_text->append(data, static_cast<std::size_t>(size));
+	return size;
+}
+
+Stream::~Stream() noexcept {
+	auto const* const text = m_buffer.m_text;
+	if (
+		!text || text->empty() || (
+			static_cast<unsigned>(Hord::Log::debug) == m_type &&
+			!Log::enabled(Hord::Log::debug)
+		)
+	) {
+		return;
+	} else if (s_state.running.load(std::memory_order_acquire)) {
+		enqueue(m_type, *text);
+	} else {
+		write_sync(m_type, *text);
+	}
+}
+
+Stream::Stream(
+	unsigned const type
+) noexcept
+	: std::ostream(nullptr)
+	, m_type(type)
+	, m_buffer()
+{
+	rdbuf(&m_buffer);
+}
+
+Stream::Stream(Stream&& other) noexcept
+	: std::ostream(std::move(other))
+	, m_type(other.m_type)
+	, m_buffer(std::move(other.m_buffer))
+{
+	set_rdbuf(&m_buffer);
+}
+
+// async control
+
+void
+start_async() {
+	std::lock_guard<std::mutex> lock{s_state.mutex};
+	if (s_state.thread.joinable()) {
+		return;
+	}
+	s_state.stop = false;
+	s_state.thread = std::thread(&run);
+	s_state.running.store(true, std::memory_order_release);
+}
+
+void
+stop_async() noexcept {
+	{
+		std::lock_guard<std::mutex> lock{s_state.mutex};
+		if (!s_state.thread.joinable()) {
+			return;
+		}
+		s_state.running.store(false, std::memory_order_release);
+		s_state.stop = true;
+	}
+	s_state.cv.notify_all();
+	s_state.thread.join();
+
+	// Catch records queued by threads that saw running before it
+	// was cleared
+	String message;
+	std::lock_guard<std::mutex> lock{s_state.mutex};
+	drain(s_state.rings, message);
+}
+
+void
+flush() noexcept {
+	std::unique_lock<std::mutex> lock{s_state.mutex};
+	if (!s_state.thread.joinable() || s_state.stop) {
+		return;
+	}
+	auto const target = ++s_state.flush_requested;
+	s_state.cv.notify_all();
+	s_state.cv.wait(lock, [target]() {
+		return target <= s_state.flush_completed;
+	});
+}
+
 void
 report_error_ptr(
 	std::exception_ptr err
@@ -8,6 +8,7 @@
 #pragma once
 
 #include <Onsang/config.hpp>
+#include <Onsang/String.hpp>
 #include <Onsang/Error.hpp>
 #include <Onsang/serialization.hpp>
 
@@ -16,14 +17,214 @@
 #include <Hord/Log.hpp>
 #include <Hord/Error.hpp>
 
+#include <atomic>
 #include <exception>
+#include <ostream>
+#include <streambuf>
 
 namespace Onsang {
 namespace Log {
 
-using Hord::Log::report_error;
 using namespace Hord::Log;
 
+namespace detail {
+extern std::atomic<bool> s_debug;
+} // namespace detail
+
+/**
+	Whether messages of a type are written.
+
+	Debug messages are written only if they are compiled in (see
+	ONSANG_CONFIG_LOG_DEBUG) and enabled with set_debug().
+*/
+inline bool
+enabled(
+	Hord::Log::OutputType const type
+) noexcept {
+	return
+		Hord::Log::debug != type || (
+			ONSANG_CONFIG_LOG_DEBUG &&
+			detail::s_debug.load(std::memory_order_relaxed)
+		)
+	;
+}
+
+/**
+	Enable or disable debug messages at runtime.
+*/
+inline void
+set_debug(
+	bool const enable
+) noexcept {
+	detail::s_debug.store(enable, std::memory_order_relaxed);
+}
+
+/**
+	Write a message if its type is enabled.
+
+	The stream operands are only evaluated if the message is
+	written. @a type_ is evaluated twice.
+
+	@code
+	ONSANG_LOG(Log::error,
+		"failed to open '" << path << "'\n"
+	);
+	@endcode
+*/
+#define ONSANG_LOG(type_, ...) \
+	if (!::Onsang::Log::enabled(type_)) {} else \
+		::Onsang::Log::acquire(type_) << __VA_ARGS__
+
+/**
+	Write a debug message if debug messages are enabled.
+
+	Costs a branch on a constant when ONSANG_CONFIG_LOG_DEBUG is
+	@c 0; the operands are still compiled.
+*/
+#define ONSANG_LOG_DEBUG(...) \
+	ONSANG_LOG(::Onsang::Log::debug, __VA_ARGS__)
+
+/**
+	%Log message stream.
+
+	Text is formatted into a per-thread buffer. When the stream is
+	destroyed, the message is queued on the calling thread's ring
+	buffer. The flush thread writes it through the Hord log
+	controller. A message that does not fit in the ring is dropped
+	and counted; producers never write to the controller. Before
+	start_async() and after stop_async(), messages are written
+	immediately.
+*/
+class Stream final
+	: public std::ostream
+{
+private:
+	class Buffer final
+		: public std::streambuf
+	{
+	public:
+		String* m_text{nullptr};
+		bool m_owned{false};
+
+		~Buffer() noexcept override;
+		Buffer() noexcept;
+		Buffer(Buffer&& other) noexcept;
+
+	protected:
+		int_type
+		overflow(
+			int_type const c
+		) override;
+
+		std::streamsize
+		xsputn(
+			char_type const* const data,
+			std::streamsize const size
+		) override;
+	};
+
+	/** Message type, or TYPE_DEFAULT. */
+	unsigned m_type;
+	Buffer m_buffer;
+
+	Stream(Stream const&) = delete;
+	Stream& operator=(Stream const&) = delete;
+	Stream& operator=(Stream&&) = delete;
+
+public:
+	enum : unsigned {
+		/** Hord::Log::acquire() without a type. */
+		TYPE_DEFAULT = ~0u,
+	};
+
+// special member functions
+	/**
+		Queue the message.
+	*/
+	~Stream() noexcept override;
+
+	Stream(
+		unsigned const type
+	) noexcept;
+
+	Stream(Stream&& other) noexcept;
+};
+
+/**
+	Acquire a stream for a general message.
+*/
+inline Log::Stream
+acquire() noexcept {
+	return Log::Stream{Log::Stream::TYPE_DEFAULT};
+}
+
+/**
+	Acquire a stream for a message of the given type.
+*/
+inline Log::Stream
+acquire(
+	Hord::Log::OutputType const type
+) noexcept {
+	return Log::Stream{static_cast<unsigned>(type)};
+}
+
+/**
+	Start the flush thread.
+
+	The controller's destinations must not be reconfigured while
+	it runs, except after flush().
+*/
+void
+start_async();
+
+/**
+	Write all queued messages and stop the flush thread.
+*/
+void
+stop_async() noexcept;
+
+/**
+	Block until all messages queued before the call are written.
+*/
+void
+flush() noexcept;
+
+// Hord's report_error() overloads write to the controller directly,
+// so they are replaced with queued equivalents
+
+inline void
+report_error(
+	std::exception const& err
+) {
+	Log::acquire(Log::error)
+		<< "[std::exception] "
+		<< err.what()
+		<< '\n'
+	;
+}
+
+inline void
+report_error(
+	SerializerError const& err
+) {
+	Log::acquire(Log::error)
+		<< "[Serializer:" << get_ser_error_name(err.code()) << "] "
+		<< err.message()
+		<< '\n'
+	;
+}
+
+inline void
+report_error(
+	Hord::Error const& err
+) {
+	Log::acquire(Log::error)
+		<< "[Hord:" << Hord::get_error_name(err.code()) << "] "
+		<< err.message()
+		<< '\n'
+	;
+}
+
 inline void
 report_error(
 	Beard::Error const& err
@@ -0,0 +1,734 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+*/
+
+#include <Onsang/utility.hpp>
+#include <Onsang/String.hpp>
+#include <Onsang/System/ValueQuery.hpp>
+#include <Onsang/System/ColumnIndex.hpp>
+
+#include <Hord/Data/Defs.hpp>
+#include <Hord/Data/ValueRef.hpp>
+#include <Hord/Data/Table.hpp>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+namespace Onsang {
+namespace System {
+
+// class ColumnIndex implementation
+
+namespace {
+
+static char const
+s_magic[8]{'O', 'N', 'S', 'C', 'I', 'D', 'X', '\0'};
+
+template<class T>
+inline static void
+put(
+	String& data,
+	T const value
+) {
+	data.append(reinterpret_cast<char const*>(&value), sizeof(T));
+}
+
+template<class T>
+inline static bool
+get(
+	char const*& it,
+	char const* const end,
+	T& value
+) noexcept {
+	if (static_cast<std::size_t>(end - it) < sizeof(T)) {
+		return false;
+	}
+	std::memcpy(&value, it, sizeof(T));
+	it += sizeof(T);
+	return true;
+}
+
+static void
+write_key(
+	String& data,
+	ColumnIndex::Key const& key
+) {
+	put<std::uint8_t>(data, enum_cast(key.rank));
+	switch (key.rank) {
+	case ColumnIndex::KeyRank::number:
+		put<std::uint8_t>(data, key.is_integer ? 1u : 0u);
+		if (key.is_integer) {
+			put<std::int64_t>(data, key.integer);
+		} else {
+			put<double>(data, key.decimal);
+		}
+		break;
+
+	case ColumnIndex::KeyRank::string:
+		put<std::uint32_t>(data, static_cast<std::uint32_t>(key.string.size()));
+		data.append(key.string);
+		break;
+
+	case ColumnIndex::KeyRank::object_id:
+		put<std::uint32_t>(data, static_cast<std::uint32_t>(key.integer));
+		break;
+
+	default:
+		break;
+	}
+}
+
+static bool
+read_key(
+	char const*& it,
+	char const* const end,
+	ColumnIndex::Key& key
+) {
+	std::uint8_t rank = 0u;
+	if (!get(it, end, rank) || enum_cast(ColumnIndex::KeyRank::other) < rank) {
+		return false;
+	}
+	key.rank = static_cast<ColumnIndex::KeyRank>(rank);
+	key.is_integer = false;
+	key.integer = 0;
+	key.decimal = 0.0;
+	key.string.clear();
+	switch (key.rank) {
+	case ColumnIndex::KeyRank::number: {
+		std::uint8_t is_integer = 0u;
+		if (!get(it, end, is_integer)) {
+			return false;
+		}
+		key.is_integer = 0u != is_integer;
+		return key.is_integer ? get(it, end, key.integer) : get(it, end, key.decimal);
+	}
+
+	case ColumnIndex::KeyRank::string: {
+		std::uint32_t size = 0u;
+		if (!get(it, end, size) || static_cast<std::size_t>(end - it) < size) {
+			return false;
+		}
+		key.string.assign(it, size);
+		it += size;
+		return true;
+	}
+
+	case ColumnIndex::KeyRank::object_id: {
+		std::uint32_t id_value = 0u;
+		if (!get(it, end, id_value)) {
+			return false;
+		}
+		key.integer = id_value;
+		return true;
+	}
+
+	default:
+		return true;
+	}
+}
+
+inline static long double
+number_value(
+	ColumnIndex::Key const& key
+) noexcept {
+	return
+		key.is_integer
+		? static_cast<long double>(key.integer)
+		: static_cast<long double>(key.decimal)
+	;
+}
+
+/**
+	Get @a value as an integer if it is integral and in range.
+*/
+inline static bool
+integral_value(
+	double const value,
+	std::int64_t& integer
+) noexcept {
+	// Also rejects NaN
+	if (!(-9223372036854775808.0 <= value && value < 9223372036854775808.0)) {
+		return false;
+	}
+	integer = static_cast<std::int64_t>(value);
+	auto const round_trip = static_cast<double>(integer);
+	return !(round_trip < value) && !(value < round_trip);
+}
+
+inline static ColumnIndex::Key
+make_number_key(
+	bool const is_integer,
+	std::int64_t const integer,
+	double const decimal
+) {
+	return {ColumnIndex::KeyRank::number, is_integer, integer, decimal, {}};
+}
+
+} // anonymous namespace
+
+ColumnIndex::Key
+ColumnIndex::Key::from_value(
+	Hord::Data::ValueRef const& value
+) {
+	Key key{KeyRank::other, false, 0, 0.0, {}};
+	switch (value.type.type()) {
+	case Hord::Data::ValueType::null:
+		key.rank = KeyRank::null;
+		break;
+
+	case Hord::Data::ValueType::integer:
+		key.rank = KeyRank::number;
+		key.is_integer = true;
+		key.integer = value.data.integer;
+		break;
+
+	case Hord::Data::ValueType::decimal:
+		key.rank = KeyRank::number;
+		key.decimal = value.data.decimal;
+		break;
+
+	case Hord::Data::ValueType::string:
+		key.rank = KeyRank::string;
+		key.string.assign(value.data.string, value.size);
+		break;
+
+	case Hord::Data::ValueType::object_id:
+		key.rank = KeyRank::object_id;
+		key.integer = Hord::Object::ID{value.data.object_id}.value();
+		break;
+
+	default:
+		break;
+	}
+	return key;
+}
+
+ColumnIndex::Key
+ColumnIndex::Key::from_string(
+	String const& text
+) {
+	if (!text.empty()) {
+		char* end = nullptr;
+		errno = 0;
+		auto const integer = std::strtoll(text.c_str(), &end, 10);
+		if ('\0' == *end && 0 == errno) {
+			return make_number_key(true, static_cast<std::int64_t>(integer), 0.0);
+		}
+		errno = 0;
+		auto const decimal = std::strtod(text.c_str(), &end);
+		if ('\0' == *end && 0 == errno) {
+			return make_number_key(false, 0, decimal);
+		}
+	}
+	return {KeyRank::string, false, 0, 0.0, text};
+}
+
+ColumnIndex::Key
+ColumnIndex::Key::from_object_id(
+	Hord::Object::ID const object_id
+) noexcept {
+	return {KeyRank::object_id, false, object_id.value(), 0.0, {}};
+}
+
+bool
+ColumnIndex::KeyLess::operator()(
+	Key const& x,
+	Key const& y
+) const noexcept {
+	if (x.rank != y.rank) {
+		return x.rank < y.rank;
+	}
+	switch (x.rank) {
+	case KeyRank::number:
+		if (x.is_integer && y.is_integer) {
+			return x.integer < y.integer;
+		}
+		return number_value(x) < number_value(y);
+
+	case KeyRank::string:
+		return x.string < y.string;
+
+	case KeyRank::object_id:
+		return x.integer < y.integer;
+
+	default:
+		return false;
+	}
+}
+
+bool
+ColumnIndex::KeyEqual::operator()(
+	Key const& x,
+	Key const& y
+) const noexcept {
+	if (x.rank != y.rank) {
+		return false;
+	}
+	switch (x.rank) {
+	case KeyRank::number:
+		if (x.is_integer && y.is_integer) {
+			return x.integer == y.integer;
+		}
+		return
+			!(number_value(x) < number_value(y)) &&
+			!(number_value(y) < number_value(x))
+		;
+
+	case KeyRank::string:
+		return x.string == y.string;
+
+	case KeyRank::object_id:
+		return x.integer == y.integer;
+
+	default:
+		return true;
+	}
+}
+
+std::size_t
+ColumnIndex::KeyHash::operator()(
+	Key const& key
+) const noexcept {
+	std::size_t hash = 0u;
+	std::int64_t integer = 0;
+	switch (key.rank) {
+	case KeyRank::number:
+		if (key.is_integer) {
+			hash = std::hash<std::int64_t>{}(key.integer);
+		} else if (integral_value(key.decimal, integer)) {
+			// Must match the equal integer
+			hash = std::hash<std::int64_t>{}(integer);
+		} else {
+			hash = std::hash<double>{}(key.decimal);
+		}
+		break;
+
+	case KeyRank::string:
+		hash = std::hash<String>{}(key.string);
+		break;
+
+	case KeyRank::object_id:
+		hash = std::hash<std::int64_t>{}(key.integer);
+		break;
+
+	default:
+		break;
+	}
+	return hash ^ (static_cast<std::size_t>(key.rank) * 0x9E3779B9u);
+}
+
+void
+ColumnIndex::clear() noexcept {
+	m_valid = false;
+	m_num_records = 0u;
+	m_num_object_ids = 0u;
+	m_hash.clear();
+	m_ordered.clear();
+	m_keys.clear();
+	m_free_keys.clear();
+	m_record_keys.clear();
+}
+
+std::pair<ColumnIndex::entry_type*, bool>
+ColumnIndex::emplace_entry(
+	Key const& key
+) {
+	if (Kind::hash == m_kind) {
+		auto const result = m_hash.emplace(key, Entry{0u, {}});
+		return {&*result.first, result.second};
+	} else {
+		auto const result = m_ordered.emplace(key, Entry{0u, {}});
+		return {&*result.first, result.second};
+	}
+}
+
+std::uint32_t
+ColumnIndex::add(
+	record_type const record,
+	Key const& key
+) {
+	if (m_free_keys.empty()) {
+		// Assigning an ordinal to a new entry cannot throw
+		m_keys.reserve(m_keys.size() + 1u);
+		m_free_keys.reserve(m_keys.capacity());
+	}
+	auto const result = emplace_entry(key);
+	auto& entry = result.first->second;
+	if (result.second) {
+		if (m_free_keys.empty()) {
+			entry.ordinal = static_cast<std::uint32_t>(m_keys.size());
+			m_keys.push_back(&result.first->first);
+		} else {
+			entry.ordinal = m_free_keys.back();
+			m_free_keys.pop_back();
+			m_keys[entry.ordinal] = &result.first->first;
+		}
+	}
+	auto& records = entry.records;
+	records.insert(
+		std::upper_bound(records.begin(), records.end(), record),
+		record
+	);
+	if (KeyRank::object_id == key.rank) {
+		++m_num_object_ids;
+	}
+	return entry.ordinal;
+}
+
+void
+ColumnIndex::remove(
+	record_type const record,
+	std::uint32_t const ordinal
+) {
+	auto const& key = *m_keys[ordinal];
+	if (KeyRank::object_id == key.rank) {
+		--m_num_object_ids;
+	}
+	// Returns whether the entry is left empty
+	auto const erase_from = [this, record, ordinal](Entry& entry) {
+		auto& records = entry.records;
+		auto const it = std::lower_bound(records.begin(), records.end(), record);
+		if (records.end() != it && record == *it) {
+			records.erase(it);
+		}
+		if (!records.empty()) {
+			return false;
+		}
+		m_keys[ordinal] = nullptr;
+		m_free_keys.push_back(ordinal);
+		return true;
+	};
+	// key refers to the entry; nothing may use it after erasing
+	if (Kind::hash == m_kind) {
+		auto const it = m_hash.find(key);
+		if (m_hash.end() != it && erase_from(it->second)) {
+			m_hash.erase(it);
+		}
+	} else {
+		auto const it = m_ordered.find(key);
+		if (m_ordered.end() != it && erase_from(it->second)) {
+			m_ordered.erase(it);
+		}
+	}
+}
+
+template<class F>
+void
+ColumnIndex::for_each_entry(
+	F&& f
+) const {
+	if (Kind::hash == m_kind) {
+		for (auto const& entry : m_hash) {
+			f(entry.first, entry.second.records);
+		}
+	} else {
+		for (auto const& entry : m_ordered) {
+			f(entry.first, entry.second.records);
+		}
+	}
+}
+
+void
+ColumnIndex::build(
+	Hord::Data::Table& table
+) {
+	clear();
+	auto const num_records = static_cast<std::size_t>(table.num_records());
+	if (
+		0u < num_records &&
+		0 <= m_column &&
+		m_column < static_cast<UI::index_type>(table.num_columns())
+	) {
+		m_record_keys.reserve(num_records);
+		auto it = table.iterator_at(0);
+		for (std::size_t index = 0u; index < num_records; ++index, ++it) {
+			m_record_keys.push_back(add(
+				static_cast<record_type>(index),
+				Key::from_value(it.get_field(m_column))
+			));
+		}
+	}
+	m_num_records = num_records;
+	m_valid = true;
+}
+
+void
+ColumnIndex::invalidate() noexcept {
+	clear();
+}
+
+void
+ColumnIndex::update(
+	record_type const record,
+	Hord::Data::ValueRef const& value
+) {
+	if (!m_valid || m_record_keys.size() <= record) {
+		return;
+	}
+	auto const key = Key::from_value(value);
+	auto& ordinal = m_record_keys[record];
+	if (KeyEqual{}(*m_keys[ordinal], key)) {
+		return;
+	}
+	remove(record, ordinal);
+	try {
+		ordinal = add(record, key);
+	} catch (...) {
+		// The record is in no entry
+		clear();
+		throw;
+	}
+}
+
+ColumnIndex::record_vector_type const*
+ColumnIndex::find(
+	Key const& key
+) const noexcept {
+	if (Kind::hash == m_kind) {
+		auto const it = m_hash.find(key);
+		return m_hash.cend() != it ? &it->second.records : nullptr;
+	} else {
+		auto const it = m_ordered.find(key);
+		return m_ordered.cend() != it ? &it->second.records : nullptr;
+	}
+}
+
+ColumnIndex::record_vector_type const*
+ColumnIndex::find_nearest(
+	Key const& key
+) const noexcept {
+	if (Kind::hash == m_kind) {
+		return find(key);
+	}
+	auto const it = m_ordered.lower_bound(key);
+	return m_ordered.cend() != it ? &it->second.records : nullptr;
+}
+
+bool
+ColumnIndex::collect(
+	System::ValueQuery const& filter,
+	record_vector_type& records
+) const {
+	using Op = System::ValueQuery::Op;
+
+	auto const op = filter.op();
+	if (!m_valid || Op::substring == op) {
+		return false;
+	}
+	auto const append = [&records](record_vector_type const& found) {
+		records.insert(records.end(), found.cbegin(), found.cend());
+	};
+	if (!filter.numeric()) {
+		// Object IDs match by path, which is not indexed
+		if (0u < m_num_object_ids) {
+			return false;
+		}
+		Key const key{KeyRank::string, false, 0, 0.0, filter.text()};
+		if (auto const* const found = find(key)) {
+			append(*found);
+		}
+		return true;
+	}
+
+	auto const key = make_number_key(
+		filter.integer(), filter.integer_value(), filter.decimal_value()
+	);
+	if (Op::equal == op) {
+		if (auto const* const found = find(key)) {
+			append(*found);
+		}
+		return true;
+	} else if (Kind::hash == m_kind) {
+		return false;
+	}
+
+	// Numbers are contiguous in the map, between nulls and strings
+	auto const numbers_begin = m_ordered.lower_bound(make_number_key(
+		false, 0, -std::numeric_limits<double>::infinity()
+	));
+	auto const numbers_end = m_ordered.lower_bound(
+		Key{KeyRank::string, false, 0, 0.0, {}}
+	);
+	auto first = numbers_begin;
+	auto last = numbers_end;
+	switch (op) {
+	case Op::less: last = m_ordered.lower_bound(key); break;
+	case Op::less_equal: last = m_ordered.upper_bound(key); break;
+	case Op::greater: first = m_ordered.upper_bound(key); break;
+	case Op::greater_equal: first = m_ordered.lower_bound(key); break;
+	default: break;
+	}
+	for (; last != first; ++first) {
+		append(first->second.records);
+	}
+	std::sort(records.begin(), records.end());
+	return true;
+}
+
+bool
+ColumnIndex::ordered_records(
+	bool const descending,
+	record_vector_type& records
+) const {
+	if (!m_valid || Kind::hash == m_kind || 0u < m_num_object_ids) {
+		return false;
+	}
+	records.reserve(records.size() + m_num_records);
+	auto const append = [&records](record_vector_type const& found) {
+		records.insert(records.end(), found.cbegin(), found.cend());
+	};
+	if (descending) {
+		for (auto it = m_ordered.crbegin(); m_ordered.crend() != it; ++it) {
+			append(it->second.records);
+		}
+	} else {
+		for (auto const& entry : m_ordered) {
+			append(entry.second.records);
+		}
+	}
+	return true;
+}
+
+void
+ColumnIndex::write(
+	String& data
+) const {
+	put<std::uint8_t>(data, enum_cast(m_source));
+	put<std::uint8_t>(data, enum_cast(m_kind));
+	put<std::uint16_t>(data, 0u);
+	put<std::int32_t>(data, static_cast<std::int32_t>(m_column));
+	put<std::uint32_t>(data, static_cast<std::uint32_t>(m_num_records));
+	put<std::uint32_t>(data, static_cast<std::uint32_t>(
+		Kind::hash == m_kind ? m_hash.size() : m_ordered.size()
+	));
+	for_each_entry([&data](Key const& key, record_vector_type const& records) {
+		write_key(data, key);
+		put<std::uint32_t>(data, static_cast<std::uint32_t>(records.size()));
+		data.append(
+			reinterpret_cast<char const*>(records.data()),
+			records.size() * sizeof(record_type)
+		);
+	});
+}
+
+aux::unique_ptr<ColumnIndex>
+ColumnIndex::read(
+	Hord::Object::ID const object_id,
+	char const*& it,
+	char const* const end
+) {
+	std::uint8_t source = 0u, kind = 0u;
+	std::uint16_t reserved = 0u;
+	std::int32_t column = 0;
+	std::uint32_t num_records = 0u, num_keys = 0u;
+	if (
+		!get(it, end, source) || !get(it, end, kind) ||
+		!get(it, end, reserved) || !get(it, end, column) ||
+		!get(it, end, num_records) || !get(it, end, num_keys) ||
+		enum_cast(Source::data) < source ||
+		enum_cast(Kind::ordered) < kind
+	) {
+		return nullptr;
+	}
+	aux::unique_ptr<ColumnIndex> index{new ColumnIndex(
+		object_id,
+		static_cast<Source>(source),
+		static_cast<UI::index_type>(column),
+		static_cast<Kind>(kind)
+	)};
+	index->m_record_keys.resize(num_records);
+	std::size_t num_assigned = 0u;
+	Key key{KeyRank::null, false, 0, 0.0, {}};
+	while (num_keys--) {
+		std::uint32_t count = 0u;
+		if (
+			!read_key(it, end, key) ||
+			!get(it, end, count) || 0u == count ||
+			static_cast<std::size_t>(end - it) / sizeof(record_type) < count
+		) {
+			return nullptr;
+		}
+		auto const ordinal = static_cast<std::uint32_t>(index->m_keys.size());
+		auto const result = index->emplace_entry(key);
+		if (!result.second) {
+			// Keys are unique
+			return nullptr;
+		}
+		index->m_keys.push_back(&result.first->first);
+		auto& entry = result.first->second;
+		entry.ordinal = ordinal;
+		entry.records.resize(count);
+		std::memcpy(entry.records.data(), it, count * sizeof(record_type));
+		it += count * sizeof(record_type);
+		for (auto const record : entry.records) {
+			if (num_records <= record) {
+				return nullptr;
+			}
+			index->m_record_keys[record] = ordinal;
+		}
+		num_assigned += count;
+		if (KeyRank::object_id == key.rank) {
+			index->m_num_object_ids += count;
+		}
+	}
+	if (num_assigned != num_records) {
+		// Every record has exactly one key
+		return nullptr;
+	}
+	index->m_free_keys.reserve(index->m_keys.size());
+	index->m_num_records = num_records;
+	index->m_valid = true;
+	return index;
+}
+
+void
+ColumnIndex::write_file(
+	aux::vector<ColumnIndex const*> const& indexes,
+	String& data
+) {
+	data.append(s_magic, sizeof(s_magic));
+	put<std::uint32_t>(data, VERSION);
+	put<std::uint32_t>(data, static_cast<std::uint32_t>(indexes.size()));
+	for (auto const* const index : indexes) {
+		index->write(data);
+	}
+}
+
+bool
+ColumnIndex::read_file(
+	Hord::Object::ID const object_id,
+	String const& data,
+	aux::vector<aux::unique_ptr<ColumnIndex>>& indexes
+) {
+	indexes.clear();
+	char const* it = data.data();
+	char const* const end = data.data() + data.size();
+	std::uint32_t version = 0u, count = 0u;
+	if (
+		static_cast<std::size_t>(end - it) < sizeof(s_magic) ||
+		0 != std::memcmp(it, s_magic, sizeof(s_magic))
+	) {
+		return false;
+	}
+	it += sizeof(s_magic);
+	if (!get(it, end, version) || VERSION != version || !get(it, end, count)) {
+		return false;
+	}
+	while (count--) {
+		auto index = read(object_id, it, end);
+		if (!index) {
+			indexes.clear();
+			return false;
+		}
+		indexes.emplace_back(std::move(index));
+	}
+	return true;
+}
+
+} // namespace System
+} // namespace Onsang
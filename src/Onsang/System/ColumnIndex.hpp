@@ -0,0 +1,395 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+
+@file
+@brief Secondary table column index.
+*/
+
+#pragma once
+
+#include <Onsang/config.hpp>
+#include <Onsang/aux.hpp>
+#include <Onsang/String.hpp>
+#include <Onsang/System/ValueQuery.hpp>
+#include <Onsang/UI/Defs.hpp>
+
+#include <Hord/Object/Defs.hpp>
+#include <Hord/Data/ValueRef.hpp>
+#include <Hord/Data/Table.hpp>
+
+#include <cstdint>
+#include <utility>
+
+/*
+
+Column index file ("$id/x" in a FlatDatastore).
+
+Holds every column index of one object. Contents are checked
+against the table record count when loaded; a mismatched index is
+rebuilt.
+
+Structure:
+
+	"ONSCIDX\0" u32 version; u32 count;
+	Index[count]:
+		u8 source; u8 kind; u16 reserved;
+		i32 column;
+		u32 num_records;
+		u32 num_keys;
+		Entry[num_keys]:
+			Key;
+			u32 count; u32 record[count];
+	Key:
+		u8 rank;
+		number: u8 is_integer; (i64 integer | f64 decimal);
+		string: u32 size; u8 data[size];
+		object_id: u32 id;
+
+All values are in host byte order.
+
+*/
+
+namespace Onsang {
+namespace System {
+
+/**
+	Index of record values in one table column.
+
+	Hash indexes answer equality lookups. Ordered indexes also
+	answer comparisons and nearest-value lookups.
+*/
+class ColumnIndex final {
+public:
+	using record_type = std::uint32_t;
+	using record_vector_type = aux::vector<record_type>;
+
+	enum : std::uint32_t {
+		VERSION = 1u,
+	};
+
+	enum class Kind : std::uint8_t {
+		hash = 0u,
+		ordered,
+	};
+
+	/**
+		Table of the object that the index covers.
+	*/
+	enum class Source : std::uint8_t {
+		metadata = 0u,
+		data,
+	};
+
+	enum class KeyRank : std::uint8_t {
+		null = 0u,
+		number,
+		string,
+		object_id,
+		other,
+	};
+
+	/**
+		Normalized value.
+
+		Integers and decimals compare by value.
+	*/
+	struct Key {
+		KeyRank rank;
+		bool is_integer;
+		/** Integer value or object ID value. */
+		std::int64_t integer;
+		double decimal;
+		String string;
+
+		static Key
+		from_value(
+			Hord::Data::ValueRef const& value
+		);
+
+		/**
+			Number if @a text is one, otherwise string.
+		*/
+		static Key
+		from_string(
+			String const& text
+		);
+
+		static Key
+		from_object_id(
+			Hord::Object::ID const object_id
+		) noexcept;
+	};
+
+	struct KeyLess {
+		bool
+		operator()(
+			Key const& x,
+			Key const& y
+		) const noexcept;
+	};
+
+	struct KeyEqual {
+		bool
+		operator()(
+			Key const& x,
+			Key const& y
+		) const noexcept;
+	};
+
+	struct KeyHash {
+		std::size_t
+		operator()(
+			Key const& key
+		) const noexcept;
+	};
+
+private:
+	/** Records with one key. */
+	struct Entry {
+		/** Ordinal of the key in m_keys. */
+		std::uint32_t ordinal;
+		record_vector_type records;
+	};
+
+	using entry_type = std::pair<Key const, Entry>;
+
+	Hord::Object::IDValue m_object_id;
+	Source m_source;
+	UI::index_type m_column;
+	Kind m_kind;
+	bool m_valid{false};
+	std::size_t m_num_records{0u};
+	std::size_t m_num_object_ids{0u};
+
+	aux::unordered_map<Key, Entry, KeyHash, KeyEqual> m_hash{};
+	aux::map<Key, Entry, KeyLess> m_ordered{};
+	/**
+		Key of each ordinal, in m_hash or m_ordered.
+
+		@c nullptr for unused ordinals.
+	*/
+	aux::vector<Key const*> m_keys{};
+	aux::vector<std::uint32_t> m_free_keys{};
+	/** Record to the ordinal of its key, for updates. */
+	aux::vector<std::uint32_t> m_record_keys{};
+
+	void
+	clear() noexcept;
+
+	/**
+		Find or insert the entry for @a key.
+
+		An inserted entry has no ordinal or records.
+
+		@returns The entry and whether it was inserted.
+	*/
+	std::pair<entry_type*, bool>
+	emplace_entry(
+		Key const& key
+	);
+
+	/**
+		Add @a record to the entry for @a key.
+
+		@returns The ordinal of the key.
+	*/
+	std::uint32_t
+	add(
+		record_type const record,
+		Key const& key
+	);
+
+	/**
+		Remove @a record from the entry for the key @a ordinal.
+	*/
+	void
+	remove(
+		record_type const record,
+		std::uint32_t const ordinal
+	);
+
+	template<class F>
+	void
+	for_each_entry(
+		F&& f
+	) const;
+
+	void
+	write(
+		String& data
+	) const;
+
+	/**
+		Read an index from [@a it, @a end), moving @a it past it.
+
+		@returns The index, or @c nullptr if the data is malformed.
+	*/
+	static aux::unique_ptr<ColumnIndex>
+	read(
+		Hord::Object::ID const object_id,
+		char const*& it,
+		char const* const end
+	);
+
+public:
+// special member functions
+	~ColumnIndex() noexcept = default;
+
+	ColumnIndex() = delete;
+	ColumnIndex(ColumnIndex const&) = delete;
+	ColumnIndex(ColumnIndex&&) = default;
+	ColumnIndex& operator=(ColumnIndex const&) = delete;
+	ColumnIndex& operator=(ColumnIndex&&) = default;
+
+	ColumnIndex(
+		Hord::Object::ID const object_id,
+		Source const source,
+		UI::index_type const column,
+		Kind const kind
+	) noexcept
+		: m_object_id(object_id.value())
+		, m_source(source)
+		, m_column(column)
+		, m_kind(kind)
+	{}
+
+// properties
+	Hord::Object::ID
+	object_id() const noexcept {
+		return Hord::Object::ID{m_object_id};
+	}
+
+	Source
+	source() const noexcept {
+		return m_source;
+	}
+
+	UI::index_type
+	column() const noexcept {
+		return m_column;
+	}
+
+	Kind
+	kind() const noexcept {
+		return m_kind;
+	}
+
+	/**
+		Whether the index reflects the table.
+	*/
+	bool
+	valid() const noexcept {
+		return m_valid;
+	}
+
+	/**
+		Number of records when the index was built.
+	*/
+	std::size_t
+	num_records() const noexcept {
+		return m_num_records;
+	}
+
+// operations
+	/**
+		Index every record of @a table.
+	*/
+	void
+	build(
+		Hord::Data::Table& table
+	);
+
+	/**
+		Mark the index as stale.
+
+		It must be rebuilt before use.
+	*/
+	void
+	invalidate() noexcept;
+
+	/**
+		Update the value of one record.
+
+		Inserting or erasing records shifts record indices; the
+		index must be invalidated instead.
+	*/
+	void
+	update(
+		record_type const record,
+		Hord::Data::ValueRef const& value
+	);
+
+	/**
+		Find records with a value equal to @a key.
+
+		@returns Sorted records, or @c nullptr if there are none.
+	*/
+	record_vector_type const*
+	find(
+		Key const& key
+	) const noexcept;
+
+	/**
+		Find records with the smallest value not less than @a key.
+
+		Hash indexes only find equal values.
+
+		@returns Sorted records, or @c nullptr if there are none.
+	*/
+	record_vector_type const*
+	find_nearest(
+		Key const& key
+	) const noexcept;
+
+	/**
+		Collect records matching @a filter in sorted order.
+
+		@returns @c false if this index cannot answer the query
+		(e.g., a substring search), leaving @a records untouched.
+	*/
+	bool
+	collect(
+		System::ValueQuery const& filter,
+		record_vector_type& records
+	) const;
+
+	/**
+		Collect every record in value order.
+
+		Records with equal values stay in record order, as with a
+		stable sort. Object IDs sort by path, which is not indexed.
+
+		@returns @c false if this index cannot order the records,
+		leaving @a records untouched.
+	*/
+	bool
+	ordered_records(
+		bool const descending,
+		record_vector_type& records
+	) const;
+
+	/**
+		Serialize the indexes of one object to @a data.
+	*/
+	static void
+	write_file(
+		aux::vector<ColumnIndex const*> const& indexes,
+		String& data
+	);
+
+	/**
+		Deserialize the indexes of one object from @a data.
+
+		@returns @c false if the data is malformed, leaving
+		@a indexes empty.
+	*/
+	static bool
+	read_file(
+		Hord::Object::ID const object_id,
+		String const& data,
+		aux::vector<aux::unique_ptr<ColumnIndex>>& indexes
+	);
+};
+
+} // namespace System
+} // namespace Onsang
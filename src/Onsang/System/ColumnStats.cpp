@@ -0,0 +1,262 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+*/
+
+#include <Onsang/config.hpp>
+#include <Onsang/aux.hpp>
+#include <Onsang/utility.hpp>
+#include <Onsang/UI/Defs.hpp>
+#include <Onsang/System/ColumnStats.hpp>
+
+#include <Hord/Data/Defs.hpp>
+#include <Hord/Data/ValueRef.hpp>
+#include <Hord/Data/Table.hpp>
+
+#include <array>
+#include <cmath>
+
+namespace Onsang {
+namespace System {
+
+// class ColumnStats implementation
+
+namespace {
+
+enum : unsigned {
+	/** Independent accumulators per reduction. */
+	LANES = 4u,
+};
+
+enum : std::int64_t {
+	/**
+		Integers within this magnitude sum exactly in an
+		@c std::int64_t over a whole batch.
+	*/
+	EXACT_INTEGER_LIMIT = std::int64_t{1} << 52,
+};
+
+static_assert(
+	0u == ColumnStats::BATCH_SIZE % LANES,
+	"batch size must be a multiple of the lane count"
+);
+
+struct Batch {
+	std::array<std::int64_t, ColumnStats::BATCH_SIZE> integers;
+	std::array<double, ColumnStats::BATCH_SIZE> decimals;
+	unsigned num_integers;
+	unsigned num_decimals;
+};
+
+struct Totals {
+	long double sum;
+	double min;
+	double max;
+};
+
+template<class T>
+inline static void
+reduce_min_max(
+	T const* const values,
+	unsigned const size,
+	T& min,
+	T& max
+) noexcept {
+	std::array<T, LANES> lane_min, lane_max;
+	lane_min.fill(values[0]);
+	lane_max.fill(values[0]);
+	unsigned index = 0u;
+	for (; index + LANES <= size; index += LANES) {
+		for (unsigned lane = 0u; lane < LANES; ++lane) {
+			auto const value = values[index + lane];
+			lane_min[lane] = value < lane_min[lane] ? value : lane_min[lane];
+			lane_max[lane] = value > lane_max[lane] ? value : lane_max[lane];
+		}
+	}
+	for (; index < size; ++index) {
+		lane_min[0] = values[index] < lane_min[0] ? values[index] : lane_min[0];
+		lane_max[0] = values[index] > lane_max[0] ? values[index] : lane_max[0];
+	}
+	min = lane_min[0];
+	max = lane_max[0];
+	for (unsigned lane = 1u; lane < LANES; ++lane) {
+		min = lane_min[lane] < min ? lane_min[lane] : min;
+		max = lane_max[lane] > max ? lane_max[lane] : max;
+	}
+}
+
+template<class T>
+inline static T
+reduce_sum(
+	T const* const values,
+	unsigned const size
+) noexcept {
+	std::array<T, LANES> lane_sum;
+	lane_sum.fill(T{0});
+	unsigned index = 0u;
+	for (; index + LANES <= size; index += LANES) {
+		for (unsigned lane = 0u; lane < LANES; ++lane) {
+			lane_sum[lane] += values[index + lane];
+		}
+	}
+	for (; index < size; ++index) {
+		lane_sum[0] += values[index];
+	}
+	T sum{0};
+	for (auto const value : lane_sum) {
+		sum += value;
+	}
+	return sum;
+}
+
+static void
+fold(
+	Batch& batch,
+	Totals& totals,
+	bool& first
+) noexcept {
+	auto const merge = [&totals, &first](double const min, double const max) {
+		if (first) {
+			totals.min = min;
+			totals.max = max;
+			first = false;
+		} else {
+			totals.min = min < totals.min ? min : totals.min;
+			totals.max = max > totals.max ? max : totals.max;
+		}
+	};
+	if (0u < batch.num_integers) {
+		std::int64_t min = 0, max = 0;
+		reduce_min_max(batch.integers.data(), batch.num_integers, min, max);
+		merge(static_cast<double>(min), static_cast<double>(max));
+		if (-EXACT_INTEGER_LIMIT < min && max < EXACT_INTEGER_LIMIT) {
+			totals.sum += static_cast<long double>(
+				reduce_sum(batch.integers.data(), batch.num_integers)
+			);
+		} else {
+			for (unsigned index = 0u; index < batch.num_integers; ++index) {
+				totals.sum += static_cast<long double>(batch.integers[index]);
+			}
+		}
+		batch.num_integers = 0u;
+	}
+	if (0u < batch.num_decimals) {
+		double min = 0.0, max = 0.0;
+		reduce_min_max(batch.decimals.data(), batch.num_decimals, min, max);
+		merge(min, max);
+		totals.sum += static_cast<long double>(
+			reduce_sum(batch.decimals.data(), batch.num_decimals)
+		);
+		batch.num_decimals = 0u;
+	}
+}
+
+} // anonymous namespace
+
+struct ColumnStats::Builder::State {
+	Batch batch;
+	Totals totals;
+	bool first;
+	/** Kept for the histogram, which needs the range. */
+	aux::vector<double> values;
+};
+
+ColumnStats::Builder::~Builder() noexcept = default;
+
+ColumnStats::Builder::Builder(
+	Hord::Data::Table& table,
+	UI::index_type const column
+)
+	: m_state(new State())
+	, m_column(column)
+{
+	m_state->batch.num_integers = 0u;
+	m_state->batch.num_decimals = 0u;
+	m_state->totals = Totals{0.0L, 0.0, 0.0};
+	m_state->first = true;
+	m_stats.m_num_records = static_cast<std::size_t>(table.num_records());
+	if (
+		0 > column ||
+		column >= static_cast<UI::index_type>(table.num_columns())
+	) {
+		// Nothing to aggregate
+		m_next = m_stats.m_num_records;
+	} else {
+		m_state->values.reserve(m_stats.m_num_records);
+	}
+}
+
+bool
+ColumnStats::Builder::step(
+	Hord::Data::Table& table,
+	std::size_t const count
+) {
+	if (m_stats.m_valid) {
+		return true;
+	}
+	auto& stats = m_stats;
+	auto& state = *m_state;
+	auto& batch = state.batch;
+	auto const end = min_ce(m_next + count, stats.m_num_records);
+	if (m_next < end) {
+		auto it = table.iterator_at(static_cast<UI::index_type>(m_next));
+		for (; m_next < end; ++m_next, ++it) {
+			auto const value = it.get_field(m_column);
+			switch (value.type.type()) {
+			case Hord::Data::ValueType::null:
+				++stats.m_num_nulls;
+				break;
+
+			case Hord::Data::ValueType::integer:
+				batch.integers[batch.num_integers++] = value.data.integer;
+				state.values.push_back(static_cast<double>(value.data.integer));
+				++stats.m_num_integers;
+				break;
+
+			case Hord::Data::ValueType::decimal:
+				if (!std::isfinite(value.data.decimal)) {
+					// Counted with non-numeric values
+					break;
+				}
+				batch.decimals[batch.num_decimals++] = value.data.decimal;
+				state.values.push_back(value.data.decimal);
+				++stats.m_num_decimals;
+				break;
+
+			default:
+				break;
+			}
+			if (
+				BATCH_SIZE == batch.num_integers ||
+				BATCH_SIZE == batch.num_decimals
+			) {
+				fold(batch, state.totals, state.first);
+			}
+		}
+	}
+	if (m_next < stats.m_num_records) {
+		return false;
+	}
+
+	fold(batch, state.totals, state.first);
+	stats.m_sum = state.totals.sum;
+	stats.m_min = state.totals.min;
+	stats.m_max = state.totals.max;
+	if (!state.values.empty()) {
+		auto const range = stats.m_max - stats.m_min;
+		auto const scale
+			= 0.0 < range
+			? static_cast<double>(HISTOGRAM_BINS) / range
+			: 0.0
+		;
+		for (auto const value : state.values) {
+			auto const bin = static_cast<unsigned>((value - stats.m_min) * scale);
+			++stats.m_histogram[bin < HISTOGRAM_BINS ? bin : HISTOGRAM_BINS - 1u];
+		}
+	}
+	aux::vector<double>{}.swap(state.values);
+	stats.m_valid = true;
+	return true;
+}
+
+} // namespace System
+} // namespace Onsang
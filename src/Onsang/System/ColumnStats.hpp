@@ -0,0 +1,216 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+
+@file
+@brief Table column aggregates.
+*/
+
+#pragma once
+
+#include <Onsang/config.hpp>
+#include <Onsang/aux.hpp>
+#include <Onsang/UI/Defs.hpp>
+
+#include <Hord/Data/Table.hpp>
+
+#include <array>
+#include <cstdint>
+
+namespace Onsang {
+namespace System {
+
+/**
+	Aggregates of the numeric values in one table column.
+
+	Values are gathered from the table into fixed-size batches of
+	integers and decimals, which are then reduced with branch-free
+	loops the compiler can vectorize.
+*/
+class ColumnStats final {
+public:
+	enum : unsigned {
+		/** Values gathered per reduction. */
+		BATCH_SIZE = 1024u,
+		HISTOGRAM_BINS = 16u,
+	};
+
+	using histogram_type = std::array<std::uint32_t, HISTOGRAM_BINS>;
+
+	class Builder;
+
+private:
+	bool m_valid{false};
+	std::size_t m_num_records{0u};
+	std::size_t m_num_integers{0u};
+	std::size_t m_num_decimals{0u};
+	std::size_t m_num_nulls{0u};
+	long double m_sum{0.0L};
+	double m_min{0.0};
+	double m_max{0.0};
+	histogram_type m_histogram{};
+
+public:
+// special member functions
+	~ColumnStats() noexcept = default;
+
+	ColumnStats() = default;
+	ColumnStats(ColumnStats const&) = default;
+	ColumnStats(ColumnStats&&) = default;
+	ColumnStats& operator=(ColumnStats const&) = default;
+	ColumnStats& operator=(ColumnStats&&) = default;
+
+// properties
+	/**
+		Whether the aggregates reflect the table.
+	*/
+	bool
+	valid() const noexcept {
+		return m_valid;
+	}
+
+	std::size_t
+	num_records() const noexcept {
+		return m_num_records;
+	}
+
+	/**
+		Number of integer and decimal values.
+	*/
+	std::size_t
+	count() const noexcept {
+		return m_num_integers + m_num_decimals;
+	}
+
+	/**
+		Whether every numeric value is an integer.
+	*/
+	bool
+	integral() const noexcept {
+		return 0u == m_num_decimals;
+	}
+
+	std::size_t
+	num_nulls() const noexcept {
+		return m_num_nulls;
+	}
+
+	/**
+		Number of non-null values that are not numbers.
+	*/
+	std::size_t
+	num_other() const noexcept {
+		return m_num_records - m_num_nulls - count();
+	}
+
+	long double
+	sum() const noexcept {
+		return m_sum;
+	}
+
+	double
+	min() const noexcept {
+		return m_min;
+	}
+
+	double
+	max() const noexcept {
+		return m_max;
+	}
+
+	double
+	mean() const noexcept {
+		return
+			0u < count()
+			? static_cast<double>(m_sum / static_cast<long double>(count()))
+			: 0.0
+		;
+	}
+
+	/**
+		Value counts in equal-width bins over [min(), max()].
+	*/
+	histogram_type const&
+	histogram() const noexcept {
+		return m_histogram;
+	}
+
+// operations
+	/**
+		Mark the aggregates as stale.
+	*/
+	void
+	invalidate() noexcept {
+		m_valid = false;
+	}
+};
+
+/**
+	Aggregates a column in chunks of records.
+
+	This lets a large table be aggregated between UI events. The
+	table must not have records inserted or erased between steps.
+*/
+class ColumnStats::Builder final {
+private:
+	struct State;
+
+	aux::unique_ptr<State> m_state;
+	ColumnStats m_stats{};
+	UI::index_type m_column;
+	std::size_t m_next{0u};
+
+	Builder() = delete;
+	Builder(Builder const&) = delete;
+	Builder(Builder&&) = delete;
+	Builder& operator=(Builder const&) = delete;
+	Builder& operator=(Builder&&) = delete;
+
+public:
+// special member functions
+	~Builder() noexcept;
+
+	/**
+		Start aggregating @a column of @a table.
+	*/
+	Builder(
+		Hord::Data::Table& table,
+		UI::index_type const column
+	);
+
+// properties
+	UI::index_type
+	column() const noexcept {
+		return m_column;
+	}
+
+	/**
+		Number of records aggregated so far.
+	*/
+	std::size_t
+	progress() const noexcept {
+		return m_next;
+	}
+
+	/**
+		The aggregates, valid once step() has returned @c true.
+	*/
+	ColumnStats const&
+	stats() const noexcept {
+		return m_stats;
+	}
+
+// operations
+	/**
+		Aggregate up to @a count more records.
+
+		@returns Whether all records have been aggregated.
+	*/
+	bool
+	step(
+		Hord::Data::Table& table,
+		std::size_t const count
+	);
+};
+
+} // namespace System
+} // namespace Onsang
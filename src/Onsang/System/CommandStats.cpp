@@ -0,0 +1,130 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+*/
+
+#include <Onsang/aux.hpp>
+#include <Onsang/utility.hpp>
+#include <Onsang/System/CommandStats.hpp>
+
+#include <cmath>
+
+namespace Onsang {
+namespace System {
+
+// class CommandStats::Histogram implementation
+
+unsigned
+CommandStats::Histogram::bucket_index(
+	std::uint64_t value
+) noexcept {
+	value = min_ce(value, (std::uint64_t{1u} << VALUE_BITS) - 1u);
+	if (value < SUB_BUCKET_COUNT) {
+		return static_cast<unsigned>(value);
+	}
+	// Values in [2^(B + m - 1), 2^(B + m)) have a bucket width of 2^m
+	unsigned magnitude = 1u;
+	while (SUB_BUCKET_COUNT <= (value >> magnitude)) {
+		++magnitude;
+	}
+	return
+		SUB_BUCKET_COUNT +
+		(magnitude - 1u) * SUB_BUCKET_HALF +
+		static_cast<unsigned>(value >> magnitude) - SUB_BUCKET_HALF
+	;
+}
+
+std::uint64_t
+CommandStats::Histogram::bucket_value(
+	unsigned const index
+) noexcept {
+	if (index < SUB_BUCKET_COUNT) {
+		return index;
+	}
+	auto const offset = index - SUB_BUCKET_COUNT;
+	auto const magnitude = offset / SUB_BUCKET_HALF + 1u;
+	std::uint64_t const sub = offset % SUB_BUCKET_HALF + SUB_BUCKET_HALF;
+	return ((sub + 1u) << magnitude) - 1u;
+}
+
+void
+CommandStats::Histogram::record(
+	std::uint64_t const value
+) {
+	if (m_buckets.empty()) {
+		m_buckets.resize(NUM_BUCKETS, 0u);
+	}
+	++m_buckets[bucket_index(value)];
+	++m_count;
+	m_max = max_ce(m_max, value);
+	m_sum += value;
+}
+
+std::uint64_t
+CommandStats::Histogram::percentile(
+	double const percent
+) const noexcept {
+	if (0u == m_count) {
+		return 0u;
+	}
+	auto const rank = max_ce(
+		std::uint64_t{1u},
+		static_cast<std::uint64_t>(
+			std::ceil(percent / 100.0 * static_cast<double>(m_count))
+		)
+	);
+	std::uint64_t seen = 0u;
+	for (unsigned index = 0u; index < NUM_BUCKETS; ++index) {
+		seen += m_buckets[index];
+		if (rank <= seen) {
+			return min_ce(bucket_value(index), m_max);
+		}
+	}
+	return m_max;
+}
+
+// class CommandStats implementation
+
+void
+CommandStats::record(
+	Hord::Cmd::TypeInfo const& type_info,
+	System::CommandTrace::Result const result,
+	std::uint64_t const start,
+	std::uint64_t const end
+) noexcept try {
+	std::lock_guard<std::mutex> lock{m_mutex};
+	auto const command_id = static_cast<std::uint32_t>(type_info.id);
+	auto it = m_index.find(command_id);
+	if (m_index.end() == it) {
+		m_entries.push_back(Entry{command_id, type_info.name, {0u, 0u, 0u, 0u}, {}});
+		it = m_index.emplace(command_id, m_entries.size() - 1u).first;
+	}
+	auto& entry = m_entries[it->second];
+	++entry.results[enum_cast(result)];
+	if (0u != start && start <= end) {
+		entry.latency.record(end - start);
+	}
+	++m_revision;
+} catch (...) {
+	// Statistics are dropped if memory runs out
+}
+
+void
+CommandStats::snapshot(
+	aux::vector<Entry>& entries,
+	std::uint64_t& revision
+) const {
+	std::lock_guard<std::mutex> lock{m_mutex};
+	entries = m_entries;
+	revision = m_revision;
+}
+
+void
+CommandStats::clear() noexcept {
+	std::lock_guard<std::mutex> lock{m_mutex};
+	m_entries.clear();
+	m_index.clear();
+	++m_revision;
+}
+
+} // namespace System
+} // namespace Onsang
@@ -0,0 +1,174 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+
+@file
+@brief Command latency statistics.
+*/
+
+#pragma once
+
+#include <Onsang/config.hpp>
+#include <Onsang/aux.hpp>
+#include <Onsang/String.hpp>
+#include <Onsang/System/CommandTrace.hpp>
+
+#include <Hord/Cmd/Defs.hpp>
+
+#include <cstdint>
+#include <mutex>
+
+namespace Onsang {
+namespace System {
+
+/**
+	Latency histograms and result counts by command type.
+
+	Histograms are log-linear (as in HdrHistogram): every power of
+	two is split into SUB_BUCKET_COUNT / 2 buckets, so percentiles
+	are within 1 / SUB_BUCKET_COUNT of the recorded latency with a
+	fixed amount of memory per command type.
+*/
+class CommandStats final {
+public:
+	enum : unsigned {
+		SUB_BUCKET_BITS = 7u,
+		SUB_BUCKET_COUNT = 1u << SUB_BUCKET_BITS,
+		SUB_BUCKET_HALF = SUB_BUCKET_COUNT >> 1,
+		/** Latencies are clamped to 2^VALUE_BITS - 1 ns (~18 minutes). */
+		VALUE_BITS = 40u,
+		NUM_BUCKETS
+			= SUB_BUCKET_COUNT
+			+ (VALUE_BITS - SUB_BUCKET_BITS) * SUB_BUCKET_HALF
+		,
+		NUM_RESULTS = 4u,
+	};
+
+	class Histogram final {
+	private:
+		/** Allocated by the first record(). */
+		aux::vector<std::uint64_t> m_buckets{};
+		std::uint64_t m_count{0u};
+		std::uint64_t m_max{0u};
+		std::uint64_t m_sum{0u};
+
+	public:
+	// properties
+		std::uint64_t
+		count() const noexcept {
+			return m_count;
+		}
+
+		std::uint64_t
+		max() const noexcept {
+			return m_max;
+		}
+
+		std::uint64_t
+		mean() const noexcept {
+			return 0u < m_count ? m_sum / m_count : 0u;
+		}
+
+	// operations
+		static unsigned
+		bucket_index(
+			std::uint64_t value
+		) noexcept;
+
+		/**
+			Get the largest value that falls into a bucket.
+		*/
+		static std::uint64_t
+		bucket_value(
+			unsigned const index
+		) noexcept;
+
+		void
+		record(
+			std::uint64_t const value
+		);
+
+		/**
+			Get the value at or below which @a percent percent of
+			the recorded values lie.
+
+			@returns 0 if nothing was recorded.
+		*/
+		std::uint64_t
+		percentile(
+			double const percent
+		) const noexcept;
+	};
+
+	struct Entry {
+		std::uint32_t command_id;
+		String name;
+		/** Commands by result (System::CommandTrace::Result). */
+		std::uint64_t results[NUM_RESULTS];
+		/** Latency in nanoseconds of commands with a start time. */
+		Histogram latency;
+
+		std::uint64_t
+		count() const noexcept {
+			return results[0] + results[1] + results[2] + results[3];
+		}
+	};
+
+private:
+	/** Guards everything below; commands finish on other threads. */
+	mutable std::mutex m_mutex{};
+	/** Entries by first execution. */
+	aux::vector<Entry> m_entries{};
+	aux::unordered_map<std::uint32_t, std::size_t> m_index{};
+	std::uint64_t m_revision{0u};
+
+	CommandStats(CommandStats const&) = delete;
+	CommandStats(CommandStats&&) = delete;
+	CommandStats& operator=(CommandStats const&) = delete;
+	CommandStats& operator=(CommandStats&&) = delete;
+
+public:
+// special member functions
+	~CommandStats() noexcept = default;
+
+	CommandStats() noexcept = default;
+
+// properties
+	/**
+		Get the number of changes to the statistics.
+	*/
+	std::uint64_t
+	revision() const noexcept {
+		std::lock_guard<std::mutex> lock{m_mutex};
+		return m_revision;
+	}
+
+// operations
+	/**
+		Copy the entries and the revision they are at.
+	*/
+	void
+	snapshot(
+		aux::vector<Entry>& entries,
+		std::uint64_t& revision
+	) const;
+
+	/**
+		Add an executed command.
+
+		If @a start is 0, only the result is counted.
+		This may be called from any thread.
+	*/
+	void
+	record(
+		Hord::Cmd::TypeInfo const& type_info,
+		System::CommandTrace::Result const result,
+		std::uint64_t const start,
+		std::uint64_t const end
+	) noexcept;
+
+	void
+	clear() noexcept;
+};
+
+} // namespace System
+} // namespace Onsang
@@ -0,0 +1,434 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+*/
+
+#include <Onsang/aux.hpp>
+#include <Onsang/utility.hpp>
+#include <Onsang/String.hpp>
+#include <Onsang/Log.hpp>
+#include <Onsang/IO/MappedStreamBuf.hpp>
+#include <Onsang/System/CommandTrace.hpp>
+
+#include <Hord/IO/Defs.hpp>
+#include <Hord/Cmd/Defs.hpp>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <istream>
+
+namespace Onsang {
+namespace System {
+
+// class CommandTrace implementation
+
+static_assert(
+	32u == sizeof(CommandTrace::Record),
+	"trace records must be packed"
+);
+
+char const
+CommandTrace::s_magic[8]{'O', 'N', 'S', 'T', 'R', 'A', 'C', 'E'};
+
+namespace {
+
+enum : std::size_t {
+	OFFSET_NUM_RECORDS = 16u,
+	OFFSET_NAMES = 24u,
+};
+
+struct Header {
+	char magic[8];
+	std::uint32_t version;
+	std::uint32_t record_size;
+	std::uint64_t num_records;
+	std::uint64_t names_offset;
+	std::int64_t system_time;
+	std::uint64_t steady_time;
+	std::uint8_t reserved[16];
+};
+
+static_assert(
+	CommandTrace::HEADER_SIZE == sizeof(Header),
+	"trace header size mismatch"
+);
+
+inline static std::size_t
+mapping_size(
+	std::size_t const capacity
+) noexcept {
+	return CommandTrace::HEADER_SIZE + capacity * sizeof(CommandTrace::Record);
+}
+
+inline static bool
+write_all(
+	signed const fd,
+	void const* const data,
+	std::size_t const size,
+	off_t const offset
+) noexcept {
+	return static_cast<ssize_t>(size) == ::pwrite(fd, data, size, offset);
+}
+
+} // anonymous namespace
+
+CommandTrace::~CommandTrace() noexcept {
+	close();
+}
+
+std::uint64_t
+CommandTrace::now() noexcept {
+	return static_cast<std::uint64_t>(
+		std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()
+		).count()
+	);
+}
+
+bool
+CommandTrace::map(
+	std::size_t const capacity
+) noexcept {
+	auto const size = mapping_size(capacity);
+	if (0 != ::ftruncate(m_fd, static_cast<off_t>(size))) {
+		return false;
+	}
+	void* const addr
+		= m_data
+		? ::mremap(m_data, mapping_size(m_capacity), size, MREMAP_MAYMOVE)
+		: ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0)
+	;
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+	bool const mapped = MAP_FAILED != addr;
+#pragma GCC diagnostic pop
+	if (!mapped) {
+		return false;
+	}
+	m_data = static_cast<char*>(addr);
+	m_capacity = capacity;
+	return true;
+}
+
+bool
+CommandTrace::open(
+	String const& path
+) {
+	std::lock_guard<std::mutex> lock{m_mutex};
+	close_impl();
+	m_fd = ::open(
+		path.c_str(),
+		O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC,
+		0644
+	);
+	if (0 > m_fd) {
+		return false;
+	} else if (!map(GROW_RECORDS)) {
+		::close(m_fd);
+		m_fd = -1;
+		return false;
+	}
+	Header header{};
+	std::copy(s_magic, s_magic + sizeof(s_magic), header.magic);
+	header.version = VERSION;
+	header.record_size = sizeof(Record);
+	header.system_time = static_cast<std::int64_t>(
+		std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::system_clock::now().time_since_epoch()
+		).count()
+	);
+	header.steady_time = now();
+	std::memcpy(m_data, &header, sizeof(header));
+	m_num_records = 0u;
+	m_names.clear();
+	return true;
+}
+
+void
+CommandTrace::close_impl() noexcept {
+	if (!is_open()) {
+		return;
+	}
+	auto const records_end = mapping_size(static_cast<std::size_t>(m_num_records));
+	::munmap(m_data, mapping_size(m_capacity));
+	m_data = nullptr;
+	m_capacity = 0u;
+
+	bool written = 0 == ::ftruncate(m_fd, static_cast<off_t>(records_end));
+	String names;
+	auto const put = [&names](std::uint32_t const value) {
+		names.append(reinterpret_cast<char const*>(&value), sizeof(value));
+	};
+	try {
+		put(static_cast<std::uint32_t>(m_names.size()));
+		for (auto const& pair : m_names) {
+			put(pair.first);
+			put(static_cast<std::uint32_t>(pair.second.size()));
+			names.append(pair.second);
+		}
+	} catch (...) {
+		written = false;
+	}
+	std::uint64_t const names_offset = records_end;
+	written
+		= written
+		&& write_all(m_fd, names.data(), names.size(), static_cast<off_t>(records_end))
+		&& write_all(m_fd, &names_offset, sizeof(names_offset), OFFSET_NAMES)
+	;
+	if (!written) {
+		Log::acquire(Log::error)
+			<< "Failed to write command names to trace; "
+			<< m_num_records
+			<< " records are intact\n"
+		;
+	}
+	::close(m_fd);
+	m_fd = -1;
+	m_names.clear();
+}
+
+void
+CommandTrace::close() noexcept {
+	std::lock_guard<std::mutex> lock{m_mutex};
+	close_impl();
+}
+
+void
+CommandTrace::record(
+	Hord::Cmd::TypeInfo const& type_info,
+	Hord::Object::ID const object_id,
+	CommandTrace::Result const result,
+	std::uint8_t const props,
+	std::uint64_t const start,
+	std::uint64_t const end
+) noexcept {
+	std::lock_guard<std::mutex> lock{m_mutex};
+	if (!is_open()) {
+		return;
+	} else if (m_capacity == m_num_records && !map(m_capacity + GROW_RECORDS)) {
+		Log::acquire(Log::error)
+			<< "Failed to grow command trace; stopping after "
+			<< m_num_records
+			<< " records\n"
+		;
+		close_impl();
+		return;
+	}
+	Record const record{
+		start, end,
+		static_cast<std::uint32_t>(type_info.id),
+		object_id.value(),
+		enum_cast(result), props,
+		{}
+	};
+	std::memcpy(
+		m_data + mapping_size(static_cast<std::size_t>(m_num_records)),
+		&record, sizeof(record)
+	);
+	++m_num_records;
+	std::memcpy(m_data + OFFSET_NUM_RECORDS, &m_num_records, sizeof(m_num_records));
+	if (m_names.end() == m_names.find(record.command_id)) {
+		try {
+			m_names.emplace(record.command_id, type_info.name);
+		} catch (...) {
+			// The summary falls back to the ID
+		}
+	}
+}
+
+namespace {
+
+struct TypeStats {
+	std::uint64_t count[4]{0u, 0u, 0u, 0u};
+	std::uint8_t props{0u};
+	/** Durations of records with a start time. */
+	aux::vector<std::uint64_t> durations{};
+	std::uint64_t total{0u};
+};
+
+inline static double
+microseconds(
+	std::uint64_t const ns
+) noexcept {
+	return static_cast<double>(ns) / 1000.0;
+}
+
+static void
+write_props(
+	std::ostream& stream,
+	std::uint8_t const props
+) {
+	static struct {
+		Hord::IO::PropTypeBit bit;
+		char c;
+	} const s_props[]{
+		{Hord::IO::PropTypeBit::identity, 'i'},
+		{Hord::IO::PropTypeBit::metadata, 'm'},
+		{Hord::IO::PropTypeBit::scratch, 's'},
+		{Hord::IO::PropTypeBit::primary, 'p'},
+		{Hord::IO::PropTypeBit::auxiliary, 'a'},
+	};
+	String text;
+	for (auto const& prop : s_props) {
+		text.push_back(props & enum_cast(prop.bit) ? prop.c : '-');
+	}
+	stream << ' ' << text;
+}
+
+} // anonymous namespace
+
+bool
+CommandTrace::summarize(
+	String const& path,
+	std::ostream& stream
+) {
+	IO::MappedStreamBuf buffer;
+	if (!buffer.open(path)) {
+		return false;
+	}
+	std::istream in{&buffer};
+	Header header;
+	if (
+		!in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+		!std::equal(s_magic, s_magic + sizeof(s_magic), header.magic) ||
+		VERSION != header.version ||
+		sizeof(Record) != header.record_size
+	) {
+		return false;
+	}
+	// Trust the file size over the header if the trace was cut off
+	auto const num_records = min_ce(
+		header.num_records,
+		static_cast<std::uint64_t>(
+			(buffer.size() - HEADER_SIZE) / sizeof(Record)
+		)
+	);
+
+	aux::unordered_map<std::uint32_t, TypeStats> types;
+	std::uint64_t first_start = ~std::uint64_t{0u};
+	std::uint64_t last_end = 0u;
+	Record record;
+	for (std::uint64_t index = 0u; index < num_records; ++index) {
+		in.read(reinterpret_cast<char*>(&record), sizeof(record));
+		auto& stats = types[record.command_id];
+		++stats.count[min_ce(record.result, std::uint8_t{3u})];
+		stats.props |= record.props;
+		if (0u != record.start && record.start <= record.end) {
+			stats.durations.push_back(record.end - record.start);
+			stats.total += record.end - record.start;
+			first_start = min_ce(first_start, record.start);
+		}
+		last_end = max_ce(last_end, record.end);
+	}
+
+	aux::unordered_map<std::uint32_t, String> names;
+	if (0u != header.names_offset && in.seekg(
+		static_cast<std::streamoff>(header.names_offset)
+	)) {
+		std::uint32_t count = 0u;
+		in.read(reinterpret_cast<char*>(&count), sizeof(count));
+		for (std::uint32_t index = 0u; in && index < count; ++index) {
+			std::uint32_t id = 0u;
+			std::uint32_t size = 0u;
+			in.read(reinterpret_cast<char*>(&id), sizeof(id));
+			in.read(reinterpret_cast<char*>(&size), sizeof(size));
+			if (!in || buffer.size() < size) {
+				break;
+			}
+			String name(size, '\0');
+			if (in.read(&name[0], size)) {
+				names.emplace(id, std::move(name));
+			}
+		}
+	}
+
+	// Most total time first
+	aux::vector<std::pair<std::uint32_t, TypeStats*>> order;
+	for (auto& pair : types) {
+		auto& durations = pair.second.durations;
+		std::sort(durations.begin(), durations.end());
+		order.emplace_back(pair.first, &pair.second);
+	}
+	std::sort(order.begin(), order.end(), [](
+		std::pair<std::uint32_t, TypeStats*> const& x,
+		std::pair<std::uint32_t, TypeStats*> const& y
+	) {
+		return x.second->total > y.second->total;
+	});
+
+	stream
+		<< num_records << " records, "
+		<< types.size() << " command types"
+	;
+	if (first_start <= last_end) {
+		stream << ", " << microseconds(last_end - first_start) / 1.0e6 << " s";
+	}
+	if (0u == header.names_offset) {
+		stream << " (trace was not closed)";
+	}
+	stream
+		<< "\nlatency in us; props: identity, metadata, scratch, primary, auxiliary\n"
+		<< std::left << std::setw(28) << "command" << std::right
+		<< std::setw(9) << "count"
+		<< std::setw(8) << "ok"
+		<< std::setw(8) << "no-op"
+		<< std::setw(8) << "error"
+		<< std::setw(6) << "exc"
+		<< std::setw(11) << "p50"
+		<< std::setw(11) << "p90"
+		<< std::setw(11) << "p99"
+		<< std::setw(11) << "max"
+		<< std::setw(11) << "mean"
+		<< " props\n"
+		<< std::fixed << std::setprecision(1)
+	;
+	for (auto const& pair : order) {
+		auto const& stats = *pair.second;
+		auto const& durations = stats.durations;
+		auto const name_it = names.find(pair.first);
+		if (names.end() != name_it) {
+			stream << std::left << std::setw(28) << name_it->second << std::right;
+		} else {
+			stream
+				<< std::left << "0x" << std::hex << std::setw(26)
+				<< pair.first << std::dec << std::right
+			;
+		}
+		stream
+			<< std::setw(9)
+			<< stats.count[0] + stats.count[1] + stats.count[2] + stats.count[3]
+			<< std::setw(8) << stats.count[0]
+			<< std::setw(8) << stats.count[1]
+			<< std::setw(8) << stats.count[2]
+			<< std::setw(6) << stats.count[3]
+		;
+		if (durations.empty()) {
+			stream << std::setw(55) << "-";
+		} else {
+			auto const percentile = [&durations](unsigned const p) {
+				return durations[(durations.size() - 1u) * p / 100u];
+			};
+			stream
+				<< std::setw(11) << microseconds(percentile(50u))
+				<< std::setw(11) << microseconds(percentile(90u))
+				<< std::setw(11) << microseconds(percentile(99u))
+				<< std::setw(11) << microseconds(durations.back())
+				<< std::setw(11)
+				<< microseconds(stats.total) / static_cast<double>(durations.size())
+			;
+		}
+		write_props(stream, stats.props);
+		stream << '\n';
+	}
+	return true;
+}
+
+} // namespace System
+} // namespace Onsang
@@ -0,0 +1,178 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+
+@file
+@brief Binary command trace.
+*/
+
+#pragma once
+
+#include <Onsang/config.hpp>
+#include <Onsang/aux.hpp>
+#include <Onsang/String.hpp>
+
+#include <Hord/Object/Defs.hpp>
+#include <Hord/Cmd/Defs.hpp>
+
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+
+/*
+
+Command trace file.
+
+Records are appended in place through a shared mapping; the header
+record count is updated with each record, so a trace that was not
+closed (e.g., after a crash) is still readable. Command names are
+written when the trace is closed.
+
+Structure:
+
+	Header: (HEADER_SIZE bytes)
+		"ONSTRACE" u32 version; u32 record_size;
+		u64 num_records;
+		u64 names_offset; (0 if the trace was not closed)
+		i64 system_time; (ns since the Unix epoch at open)
+		u64 steady_time; (steady clock ns at open)
+		u8 reserved[16];
+	Record[num_records]:
+		u64 start; u64 end; (steady clock ns; start is 0 if unknown)
+		u32 command_id; u32 object_id;
+		u8 result; u8 props; (Hord::IO::PropTypeBit)
+		u8 reserved[6];
+	Names (at names_offset):
+		u32 count;
+		Name[count]: u32 command_id; u32 size; u8 name[size];
+
+All values are in host byte order.
+
+*/
+
+namespace Onsang {
+namespace System {
+
+/**
+	Append-only trace of executed commands.
+
+	record() may be called from any thread.
+*/
+class CommandTrace final {
+public:
+	enum class Result : std::uint8_t {
+		success = 0u,
+		success_no_action,
+		error,
+		/** The command threw. */
+		exception,
+	};
+
+	struct Record {
+		std::uint64_t start;
+		std::uint64_t end;
+		std::uint32_t command_id;
+		std::uint32_t object_id;
+		std::uint8_t result;
+		std::uint8_t props;
+		std::uint8_t reserved[6];
+	};
+
+	enum : std::size_t {
+		HEADER_SIZE = 64u,
+		/** Records added to the mapping when it is full. */
+		GROW_RECORDS = 1u << 15,
+	};
+
+	enum : std::uint32_t {
+		VERSION = 1u,
+	};
+
+	static char const
+	s_magic[8];
+
+private:
+	std::mutex m_mutex{};
+	signed m_fd{-1};
+	char* m_data{nullptr};
+	/** Records that fit in the mapping. */
+	std::size_t m_capacity{0u};
+	std::uint64_t m_num_records{0u};
+	aux::unordered_map<std::uint32_t, String> m_names{};
+
+	CommandTrace(CommandTrace const&) = delete;
+	CommandTrace(CommandTrace&&) = delete;
+	CommandTrace& operator=(CommandTrace const&) = delete;
+	CommandTrace& operator=(CommandTrace&&) = delete;
+
+	bool
+	map(
+		std::size_t const capacity
+	) noexcept;
+
+	void
+	close_impl() noexcept;
+
+public:
+// special member functions
+	~CommandTrace() noexcept;
+
+	CommandTrace() noexcept = default;
+
+// properties
+	bool
+	is_open() const noexcept {
+		return 0 <= m_fd;
+	}
+
+// operations
+	/**
+		Steady clock time in nanoseconds.
+	*/
+	static std::uint64_t
+	now() noexcept;
+
+	/**
+		Create or truncate a trace file.
+
+		@returns @c false if the file could not be created.
+	*/
+	bool
+	open(
+		String const& path
+	);
+
+	/**
+		Write command names and close the file.
+	*/
+	void
+	close() noexcept;
+
+	/**
+		Append a record.
+
+		Does nothing if the trace is not open.
+	*/
+	void
+	record(
+		Hord::Cmd::TypeInfo const& type_info,
+		Hord::Object::ID const object_id,
+		CommandTrace::Result const result,
+		std::uint8_t const props,
+		std::uint64_t const start,
+		std::uint64_t const end
+	) noexcept;
+
+	/**
+		Write latency statistics by command type for a trace file.
+
+		@returns @c false if the file is not a readable trace.
+	*/
+	static bool
+	summarize(
+		String const& path,
+		std::ostream& stream
+	);
+};
+
+} // namespace System
+} // namespace Onsang
@@ -0,0 +1,140 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+*/
+
+#include <Onsang/utility.hpp>
+#include <Onsang/String.hpp>
+#include <Onsang/System/EventLoop.hpp>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <initializer_list>
+
+namespace Onsang {
+namespace System {
+
+// class EventLoop implementation
+
+namespace {
+
+static bool
+add_source(
+	signed const epoll_fd,
+	signed const fd,
+	EventLoop::Source const source
+) noexcept {
+	struct ::epoll_event event{};
+	event.events = EPOLLIN;
+	event.data.u32 = enum_cast(source);
+	return 0 == ::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+}
+
+static void
+drain(
+	signed const fd
+) noexcept {
+	std::uint64_t count;
+	while (0 < ::read(fd, &count, sizeof(count))) {}
+}
+
+} // anonymous namespace
+
+EventLoop::~EventLoop() noexcept {
+	close();
+}
+
+bool
+EventLoop::open(
+	String const& tty_path
+) noexcept {
+	close();
+	if (0 > m_wake_fd.load()) {
+		m_wake_fd.store(::eventfd(0u, EFD_NONBLOCK | EFD_CLOEXEC));
+	}
+	auto const wake_fd = m_wake_fd.load();
+	m_epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+	m_timer_fd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	m_tty_fd = ::open(tty_path.c_str(), O_RDONLY | O_NONBLOCK | O_NOCTTY | O_CLOEXEC);
+	if (
+		0 > m_epoll_fd || 0 > wake_fd ||
+		0 > m_timer_fd || 0 > m_tty_fd ||
+		!add_source(m_epoll_fd, m_tty_fd, Source::input) ||
+		!add_source(m_epoll_fd, wake_fd, Source::wake) ||
+		!add_source(m_epoll_fd, m_timer_fd, Source::timer)
+	) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+void
+EventLoop::close() noexcept {
+	// Workers may still wake the loop, so m_wake_fd stays open;
+	// closing the epoll descriptor drops its registration
+	for (signed* const fd : {&m_tty_fd, &m_timer_fd, &m_epoll_fd}) {
+		if (0 <= *fd) {
+			::close(*fd);
+			*fd = -1;
+		}
+	}
+}
+
+void
+EventLoop::wake() noexcept {
+	auto const fd = m_wake_fd.load();
+	if (0 <= fd) {
+		std::uint64_t const one = 1u;
+		// Only fails if the counter would overflow, which still wakes
+		static_cast<void>(::write(fd, &one, sizeof(one)));
+	}
+}
+
+void
+EventLoop::arm_timer(
+	unsigned const ms
+) noexcept {
+	if (0 > m_timer_fd) {
+		return;
+	}
+	struct ::itimerspec spec{};
+	spec.it_value.tv_sec = ms / 1000u;
+	spec.it_value.tv_nsec = static_cast<long>(ms % 1000u) * 1000000l;
+	if (0 == ms) {
+		// A zero it_value disarms; fire as soon as possible instead
+		spec.it_value.tv_nsec = 1;
+	}
+	::timerfd_settime(m_timer_fd, 0, &spec, nullptr);
+}
+
+unsigned
+EventLoop::wait(
+	signed const timeout_ms
+) noexcept {
+	if (!is_open()) {
+		return enum_cast(Source::none);
+	}
+	struct ::epoll_event events[3];
+	signed const count = ::epoll_wait(
+		m_epoll_fd, events, array_extent(events), timeout_ms
+	);
+	unsigned sources = enum_cast(Source::none);
+	for (signed index = 0; index < count; ++index) {
+		auto const source = static_cast<Source>(events[index].data.u32);
+		switch (source) {
+		case Source::wake: drain(m_wake_fd.load()); break;
+		case Source::timer: drain(m_timer_fd); break;
+		default: break;
+		}
+		sources |= enum_cast(source);
+	}
+	return sources;
+}
+
+} // namespace System
+} // namespace Onsang
@@ -0,0 +1,112 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+
+@file
+@brief %Event loop wait primitive.
+*/
+
+#pragma once
+
+#include <Onsang/config.hpp>
+#include <Onsang/utility.hpp>
+#include <Onsang/String.hpp>
+
+#include <atomic>
+
+namespace Onsang {
+namespace System {
+
+/**
+	Blocks the main loop until there is something to do.
+
+	Wakes on terminal input, explicit wake() calls (from any thread),
+	and an optional one-shot timer.
+
+	The wake descriptor is created by the first open() and kept
+	until the process exits, so a late wake() from a worker never
+	writes to a closed (or reused) descriptor.
+*/
+class EventLoop final {
+public:
+	enum class Source : unsigned {
+		none  = 0u,
+		input = bit(0u),
+		wake  = bit(1u),
+		timer = bit(2u),
+	};
+
+private:
+	signed m_epoll_fd{-1};
+	std::atomic<signed> m_wake_fd{-1};
+	signed m_timer_fd{-1};
+	signed m_tty_fd{-1};
+
+	EventLoop(EventLoop const&) = delete;
+	EventLoop(EventLoop&&) = delete;
+	EventLoop& operator=(EventLoop const&) = delete;
+	EventLoop& operator=(EventLoop&&) = delete;
+
+public:
+// special member functions
+	~EventLoop() noexcept;
+
+	EventLoop() noexcept = default;
+
+// properties
+	bool
+	is_open() const noexcept {
+		return 0 <= m_epoll_fd;
+	}
+
+// operations
+	/**
+		Open the loop.
+
+		@param tty_path Path to the terminal the UI reads input
+		from. Readiness on our own descriptor for the device
+		reflects the device's input queue.
+	*/
+	bool
+	open(
+		String const& tty_path
+	) noexcept;
+
+	void
+	close() noexcept;
+
+	/**
+		Wake the loop.
+
+		@note This is safe to call from any thread, including
+		after close().
+	*/
+	void
+	wake() noexcept;
+
+	/**
+		Arm the one-shot timer.
+
+		Re-arming replaces the current deadline.
+	*/
+	void
+	arm_timer(
+		unsigned const ms
+	) noexcept;
+
+	/**
+		Wait until any source is ready.
+
+		@param timeout_ms Timeout in milliseconds; negative waits
+		indefinitely.
+
+		@returns A mask of the ready sources, or Source::none on
+		timeout or when interrupted by a signal.
+	*/
+	unsigned
+	wait(
+		signed const timeout_ms = -1
+	) noexcept;
+};
+
+} // namespace System
+} // namespace Onsang
@@ -0,0 +1,135 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+*/
+
+#include <Onsang/String.hpp>
+#include <Onsang/System/HeadlessTerminal.hpp>
+
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <system_error>
+#include <initializer_list>
+
+namespace Onsang {
+namespace System {
+
+// class HeadlessTerminal implementation
+
+HeadlessTerminal::~HeadlessTerminal() noexcept {
+	close();
+}
+
+void
+HeadlessTerminal::sink() noexcept {
+	char buffer[16384];
+	struct ::pollfd fds[2]{
+		{m_master_fd, POLLIN, 0},
+		{m_stop_fd, POLLIN, 0},
+	};
+	while (true) {
+		if (0 > ::poll(fds, 2, -1)) {
+			if (EINTR == errno) {
+				continue;
+			}
+			break;
+		}
+		if (fds[1].revents) {
+			break;
+		}
+		if (fds[0].revents & POLLIN) {
+			auto const size = ::read(m_master_fd, buffer, sizeof(buffer));
+			if (0 < size) {
+				m_bytes_sunk.fetch_add(static_cast<std::uint64_t>(size));
+			}
+		}
+	}
+}
+
+bool
+HeadlessTerminal::open(
+	unsigned const width,
+	unsigned const height
+) noexcept {
+	close();
+	char name[128];
+	m_master_fd = ::posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+	if (
+		0 > m_master_fd ||
+		0 != ::grantpt(m_master_fd) ||
+		0 != ::unlockpt(m_master_fd) ||
+		0 != ::ptsname_r(m_master_fd, name, sizeof(name))
+	) {
+		close();
+		return false;
+	}
+	m_path.assign(name);
+
+	struct ::winsize size{};
+	size.ws_col = static_cast<unsigned short>(width);
+	size.ws_row = static_cast<unsigned short>(height);
+	::ioctl(m_master_fd, TIOCSWINSZ, &size);
+
+	// Hold the slave open so the master never sees a hangup
+	// between the UI context closing and opening it
+	m_slave_fd = ::open(m_path.c_str(), O_RDWR | O_NOCTTY | O_CLOEXEC);
+	m_stop_fd = ::eventfd(0u, EFD_CLOEXEC);
+	if (0 > m_slave_fd || 0 > m_stop_fd) {
+		close();
+		return false;
+	}
+	try {
+		m_sink = std::thread(&HeadlessTerminal::sink, this);
+	} catch (std::system_error const&) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+void
+HeadlessTerminal::close() noexcept {
+	if (m_sink.joinable()) {
+		std::uint64_t const one = 1u;
+		static_cast<void>(::write(m_stop_fd, &one, sizeof(one)));
+		m_sink.join();
+	}
+	for (signed* const fd : {&m_stop_fd, &m_slave_fd, &m_master_fd}) {
+		if (0 <= *fd) {
+			::close(*fd);
+			*fd = -1;
+		}
+	}
+	m_path.clear();
+}
+
+bool
+HeadlessTerminal::send_input(
+	char const* data,
+	std::size_t size
+) noexcept {
+	if (!is_open()) {
+		return false;
+	}
+	while (0u < size) {
+		auto const written = ::write(m_master_fd, data, size);
+		if (0 > written) {
+			if (EINTR == errno) {
+				continue;
+			}
+			return false;
+		}
+		data += written;
+		size -= static_cast<std::size_t>(written);
+	}
+	return true;
+}
+
+} // namespace System
+} // namespace Onsang
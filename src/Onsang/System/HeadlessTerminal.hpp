@@ -0,0 +1,101 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+
+@file
+@brief Headless terminal sink.
+*/
+
+#pragma once
+
+#include <Onsang/config.hpp>
+#include <Onsang/String.hpp>
+
+#include <atomic>
+#include <thread>
+#include <cstdint>
+
+namespace Onsang {
+namespace System {
+
+/**
+	Pseudo-terminal that discards everything written to it.
+
+	The UI context opens path() like any other terminal. A
+	background thread drains the master side so rendering never
+	blocks, and input can be fed through send_input().
+*/
+class HeadlessTerminal final {
+private:
+	signed m_master_fd{-1};
+	signed m_slave_fd{-1};
+	signed m_stop_fd{-1};
+	String m_path{};
+	std::thread m_sink{};
+	std::atomic<std::uint64_t> m_bytes_sunk{0u};
+
+	HeadlessTerminal(HeadlessTerminal const&) = delete;
+	HeadlessTerminal(HeadlessTerminal&&) = delete;
+	HeadlessTerminal& operator=(HeadlessTerminal const&) = delete;
+	HeadlessTerminal& operator=(HeadlessTerminal&&) = delete;
+
+	void
+	sink() noexcept;
+
+public:
+// special member functions
+	~HeadlessTerminal() noexcept;
+
+	HeadlessTerminal() noexcept = default;
+
+// properties
+	bool
+	is_open() const noexcept {
+		return 0 <= m_master_fd;
+	}
+
+	/**
+		Path to the terminal device.
+	*/
+	String const&
+	path() const noexcept {
+		return m_path;
+	}
+
+	/**
+		Number of bytes written to the terminal so far.
+	*/
+	std::uint64_t
+	bytes_sunk() const noexcept {
+		return m_bytes_sunk.load();
+	}
+
+// operations
+	/**
+		Open a terminal of the given size and start draining it.
+	*/
+	bool
+	open(
+		unsigned const width,
+		unsigned const height
+	) noexcept;
+
+	/**
+		Stop draining and close the terminal.
+
+		@note The UI context should be closed first.
+	*/
+	void
+	close() noexcept;
+
+	/**
+		Send input to the terminal as if it were typed.
+	*/
+	bool
+	send_input(
+		char const* data,
+		std::size_t size
+	) noexcept;
+};
+
+} // namespace System
+} // namespace Onsang
@@ -0,0 +1,66 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+
+@file
+@brief Session job base class.
+*/
+
+#pragma once
+
+#include <Onsang/config.hpp>
+#include <Onsang/aux.hpp>
+
+namespace Onsang {
+namespace System {
+
+/**
+	Long-running work attached to a session.
+
+	The session polls its jobs on the UI thread every loop
+	iteration. Work done off the UI thread should call
+	EventLoop::wake() when it has something for poll() to pick up.
+
+	The session only holds weak references; the owner keeps a job
+	alive and drops it to cancel.
+*/
+class Job {
+public:
+	using SPtr = aux::shared_ptr<System::Job>;
+	using WPtr = aux::weak_ptr<System::Job>;
+
+private:
+	Job(Job const&) = delete;
+	Job(Job&&) = delete;
+	Job& operator=(Job const&) = delete;
+	Job& operator=(Job&&) = delete;
+
+protected:
+// System::Job implementation
+	/**
+		poll() implementation.
+	*/
+	virtual bool
+	poll_impl() = 0;
+
+public:
+// special member functions
+	virtual
+	~Job() noexcept = 0;
+
+	Job() noexcept = default;
+
+// operations
+	/**
+		Make progress or apply results.
+
+		@returns @c true when the job is finished.
+	*/
+	bool
+	poll() {
+		return poll_impl();
+	}
+};
+inline Job::~Job() noexcept = default;
+
+} // namespace System
+} // namespace Onsang
@@ -5,11 +5,21 @@
 #include <Onsang/Log.hpp>
 #include <Onsang/System/Defs.hpp>
 #include <Onsang/System/Session.hpp>
+#include <Onsang/System/ColumnIndex.hpp>
+#include <Onsang/System/CommandTrace.hpp>
+#include <Onsang/System/CommandStats.hpp>
+#include <Onsang/IO/FlatDatastore.hpp>
+#include <Onsang/IO/PackedDatastore.hpp>
 #include <Onsang/UI/Defs.hpp>
 #include <Onsang/UI/SessionView.hpp>
+#include <Onsang/App.hpp>
 
+#include <Hord/IO/Defs.hpp>
 #include <Hord/Object/Defs.hpp>
+#include <Hord/Object/Unit.hpp>
 #include <Hord/Object/Ops.hpp>
+#include <Hord/Data/Table.hpp>
+#include <Hord/Data/Metadata.hpp>
 #include <Hord/Cmd/Defs.hpp>
 #include <Hord/Cmd/Unit.hpp>
 #include <Hord/Cmd/Object.hpp>
@@ -17,22 +27,151 @@
 
 #include <duct/debug.hpp>
 
+#include <algorithm>
+#include <chrono>
 #include <iomanip>
+#include <mutex>
 
-#include <Onsang/detail/gr_core.hpp>
+#include <Onsang/detail/gr_ceformat.hpp>
 
 namespace Onsang {
 namespace System {
 
 #define ONSANG_SCOPE_CLASS System::Session
 
+namespace {
+ONSANG_DEF_FMT_CLASS(
+	s_err_command_failed,
+	"command %s failed: %s"
+);
+
+/** Start time and props of the command being issued on this thread. */
+static thread_local std::uint64_t t_command_start{0u};
+static thread_local unsigned t_command_props{0u};
+
+/**
+	Serializes commands across threads (the UI thread and
+	write-back threads), which all use App::instance.m_driver.
+
+	Only held by Session::CommandScope.
+*/
+static std::mutex s_driver_mutex{};
+
+/** Props a command type always touches. */
+inline static unsigned
+command_props(
+	Hord::Cmd::TypeInfo const& type_info
+) noexcept {
+	switch (type_info.id) {
+	case Hord::Cmd::Object::SetSlug::COMMAND_ID:
+	case Hord::Cmd::Object::SetParent::COMMAND_ID:
+		return enum_cast(Hord::IO::PropTypeBit::identity);
+
+	case Hord::Cmd::Object::SetMetaField::COMMAND_ID:
+	case Hord::Cmd::Object::RenameMetaField::COMMAND_ID:
+	case Hord::Cmd::Object::RemoveMetaField::COMMAND_ID:
+		return enum_cast(Hord::IO::PropTypeBit::metadata);
+
+	default:
+		return 0u;
+	}
+}
+
+/** Trace a command that finished on this thread and add it to @a stats. */
+static void
+trace_command(
+	System::CommandStats& stats,
+	Hord::Cmd::UnitBase const& command,
+	Hord::Cmd::TypeInfo const& type_info,
+	System::CommandTrace::Result const result
+) noexcept {
+	auto const end = System::CommandTrace::now();
+	App::instance.m_trace.record(
+		type_info, command.object_id(), result,
+		static_cast<std::uint8_t>(t_command_props | command_props(type_info)),
+		t_command_start, end
+	);
+	stats.record(type_info, result, t_command_start, end);
+	t_command_start = 0u;
+	t_command_props = 0u;
+}
+
+/** Make the changes of a finished command durable. */
+inline static void
+commit_datastore(
+	Hord::IO::Datastore& datastore
+) noexcept {
+	auto* const flat = dynamic_cast<IO::FlatDatastore*>(&datastore);
+	if (flat) {
+		flat->commit_journal();
+		return;
+	}
+	auto* const packed = dynamic_cast<IO::PackedDatastore*>(&datastore);
+	if (packed) {
+		packed->commit();
+	}
+}
+
+/** Name of the column index file in a FlatDatastore. */
+static String const
+s_column_index_name{"x"};
+
+inline static System::ColumnIndex::Source
+column_index_source(
+	Hord::Object::Unit& object,
+	Hord::Data::Table const& table
+) noexcept {
+	return
+		&table == &object.metadata().table()
+		? System::ColumnIndex::Source::metadata
+		: System::ColumnIndex::Source::data
+	;
+}
+} // anonymous namespace
+
+Session::CommandScope::~CommandScope() noexcept {
+	// Don't trace a later command with this start if the command
+	// was not issued (or never notified)
+	t_command_start = 0u;
+	t_command_props = 0u;
+}
+
+Session::CommandScope::CommandScope(
+	Acquire const acquire,
+	unsigned const props
+) noexcept
+	: m_lock(s_driver_mutex, std::defer_lock)
+{
+	if (Acquire::wait == acquire) {
+		m_lock.lock();
+	} else if (!m_lock.try_lock()) {
+		App::instance.m_ui.csline->set_error(
+			"busy storing a session; try again when it finishes"
+		);
+		return;
+	}
+	t_command_start = System::CommandTrace::now();
+	t_command_props = props;
+}
+
+Session::~Session() {
+	if (m_writeback && m_writeback->thread.joinable()) {
+		m_writeback->thread.join();
+	}
+}
+
 #define ONSANG_SCOPE_FUNC notify_exception_impl
 void
 Session::notify_exception_impl(
-	Hord::Cmd::UnitBase const& /*command*/,
+	Hord::Cmd::UnitBase const& command,
 	Hord::Cmd::TypeInfo const& type_info,
 	std::exception_ptr eptr
 ) noexcept {
+	commit_datastore(datastore());
+	trace_command(
+		m_command_stats, command, type_info,
+		System::CommandTrace::Result::exception
+	);
 	Log::acquire(Log::error)
 		<< "exception caught in " << type_info.name << ": \n"
 	;
@@ -53,14 +192,56 @@ Session::notify_complete_impl(
 		"error",
 	};
 
-	Log::acquire(command.bad() ? Log::error : Log::debug)
-		<< "notify_complete: "
+	commit_datastore(datastore());
+	trace_command(
+		m_command_stats, command, type_info,
+		static_cast<System::CommandTrace::Result>(enum_cast(command.result()))
+	);
+
+	auto const log_type = command.bad() ? Log::error : Log::debug;
+	ONSANG_LOG(log_type,
+		"notify_complete: "
 		<< std::hex << type_info.id
 		<< ' ' << type_info.name
 		<< ", result: " << result_names[enum_cast(command.result())]
 		<< ", message: \"" << command.message() << '\"'
 		<< '\n'
-	;
+	);
+
+	if (command.ok_action()) {
+		switch (type_info.id) {
+		case Hord::Cmd::Object::SetSlug::COMMAND_ID:
+		case Hord::Cmd::Object::SetParent::COMMAND_ID:
+			invalidate_paths();
+			break;
+
+		case Hord::Cmd::Object::SetMetaField::COMMAND_ID: {
+			auto const& c = static_cast<Hord::Cmd::Object::SetMetaField const&>(command);
+			if (c.created()) {
+				invalidate_metadata_indexes(c.object_id());
+			} else {
+				update_metadata_indexes(
+					c.object_id(),
+					static_cast<System::ColumnIndex::record_type>(c.field_index()),
+					1
+				);
+			}
+		}	break;
+
+		case Hord::Cmd::Object::RenameMetaField::COMMAND_ID: {
+			auto const& c = static_cast<Hord::Cmd::Object::RenameMetaField const&>(command);
+			update_metadata_indexes(
+				c.object_id(),
+				static_cast<System::ColumnIndex::record_type>(c.field_index()),
+				0
+			);
+		}	break;
+
+		case Hord::Cmd::Object::RemoveMetaField::COMMAND_ID:
+			invalidate_metadata_indexes(command.object_id());
+			break;
+		}
+	}
 
 	// Notify views of failed or mutative command execution
 	if (m_view && (command.bad() || command.ok_action())) {
@@ -71,14 +252,30 @@ Session::notify_complete_impl(
 
 #define ONSANG_SCOPE_FUNC open
 void
-Session::open(
-	UI::RootWPtr root
-) try {
+Session::open() {
 	datastore().open(m_auto_create);
+	CommandScope const scope{
+		Acquire::wait, enum_cast(Hord::IO::PropTypeBit::base)
+	};
+	auto cmd = Hord::Cmd::Datastore::Init{*this};
+	if (!cmd(Hord::IO::PropTypeBit::base)) {
+		ONSANG_THROW_FMT(
+			ErrorCode::command_failed,
+			s_err_command_failed,
+			cmd.command_name(),
+			cmd.message()
+		);
+	}
+}
+#undef ONSANG_SCOPE_FUNC
+
+#define ONSANG_SCOPE_FUNC attach_view
+void
+Session::attach_view(
+	UI::RootWPtr root
+) {
 	m_view.reset();
 	m_view = UI::SessionView::make(std::move(root), *this);
-} catch (...) {
-	throw;
 }
 #undef ONSANG_SCOPE_FUNC
 
@@ -86,19 +283,394 @@ Session::open(
 void
 Session::close() {
 	m_view.reset();
+	invalidate_paths();
+	store_column_indexes();
 	datastore().close();
 }
 #undef ONSANG_SCOPE_FUNC
 
+#define ONSANG_SCOPE_FUNC close_async
+void
+Session::close_async() {
+	if (write_back_busy()) {
+		return;
+	}
+	m_view.reset();
+	// Written before the store so the datastore is not shared with
+	// the write-back thread
+	store_column_indexes();
+	auto& wb = *m_writeback;
+	wb.eptr = nullptr;
+	wb.num_objects = 0u;
+	wb.num_props = 0u;
+	wb.bytes_written = 0u;
+	wb.seconds = 0.0;
+	wb.state.store(WriteBackState::storing);
+	wb.thread = std::thread([this, &wb]() {
+		try {
+			auto const start = std::chrono::steady_clock::now();
+			auto const* const flat = dynamic_cast<IO::FlatDatastore const*>(&datastore());
+			auto const bytes_before = flat ? flat->io_stats().total_bytes_written() : 0u;
+			{
+				CommandScope const scope{Acquire::wait};
+				auto cmd = Hord::Cmd::Datastore::Store{*this};
+				if (!cmd()) {
+					ONSANG_THROW_FMT(
+						ErrorCode::command_failed,
+						s_err_command_failed,
+						cmd.command_name(),
+						cmd.message()
+					);
+				}
+				wb.num_objects = cmd.num_objects_stored();
+				wb.num_props = cmd.num_props_stored();
+			}
+			if (flat) {
+				wb.bytes_written = flat->io_stats().total_bytes_written() - bytes_before;
+			}
+			wb.state.store(WriteBackState::closing);
+			datastore().close();
+			wb.seconds = std::chrono::duration<double>(
+				std::chrono::steady_clock::now() - start
+			).count();
+			wb.state.store(WriteBackState::complete);
+		} catch (...) {
+			wb.eptr = std::current_exception();
+			wb.state.store(WriteBackState::failed);
+		}
+		App::instance.m_events.wake();
+	});
+}
+#undef ONSANG_SCOPE_FUNC
+
 #define ONSANG_SCOPE_FUNC process
 void
 Session::process() {
-	// TODO: Update views
+	for (auto it = m_jobs.begin(); m_jobs.end() != it;) {
+		auto const job = it->lock();
+		bool finished = true;
+		if (job) {
+			try {
+				finished = job->poll();
+			} catch (...) {
+				Log::acquire(Log::error)
+					<< "Job failed in session '"
+					<< m_name
+					<< "':\n"
+				;
+				Log::report_error_ptr(std::current_exception());
+			}
+		}
+		if (finished) {
+			it = m_jobs.erase(it);
+		} else {
+			++it;
+		}
+	}
+
+	auto& wb = *m_writeback;
+	auto const state = wb.state.load();
+	if (WriteBackState::complete != state && WriteBackState::failed != state) {
+		return;
+	}
+	wb.thread.join();
+	wb.state.store(WriteBackState::idle);
+	auto& csline = *App::instance.m_ui.csline;
+	if (WriteBackState::complete == state) {
+		auto const per_second = [&wb](double const amount) {
+			return 0.0 < wb.seconds ? amount / wb.seconds : 0.0;
+		};
+		auto const mib = static_cast<double>(wb.bytes_written) / (1024.0 * 1024.0);
+		Log::acquire()
+			<< "Stored "
+			<< wb.num_objects << " objects and "
+			<< wb.num_props << " props ("
+			<< mib << " MiB) in "
+			<< wb.seconds << " s: "
+			<< per_second(static_cast<double>(wb.num_props)) << " props/s, "
+			<< per_second(mib) << " MiB/s\n"
+		;
+		csline.set_description("closed session: " + m_name);
+	} else {
+		csline.set_error("Failed to close session: " + m_name);
+		Log::acquire(Log::error)
+			<< "Failed to close session '"
+			<< m_name
+			<< "':\n"
+		;
+		Log::report_error_ptr(wb.eptr);
+		wb.eptr = nullptr;
+	}
+}
+#undef ONSANG_SCOPE_FUNC
+
+#define ONSANG_SCOPE_FUNC add_job
+void
+Session::add_job(
+	System::Job::WPtr job
+) {
+	m_jobs.emplace_back(std::move(job));
+}
+#undef ONSANG_SCOPE_FUNC
+
+#define ONSANG_SCOPE_FUNC load_column_indexes
+void
+Session::load_column_indexes(
+	Hord::Object::ID const object_id
+) {
+	if (!m_column_indexes_loaded.emplace(object_id.value()).second) {
+		return;
+	}
+	auto* const flat = dynamic_cast<IO::FlatDatastore*>(&datastore());
+	String data;
+	if (!flat || !flat->load_extra(object_id, s_column_index_name, data)) {
+		return;
+	}
+	aux::vector<aux::unique_ptr<System::ColumnIndex>> indexes;
+	if (!System::ColumnIndex::read_file(object_id, data, indexes)) {
+		Log::acquire(Log::error)
+			<< "Discarding malformed column indexes for object "
+			<< Hord::Object::IDPrinter{object_id}
+			<< '\n'
+		;
+		m_column_indexes_dirty.emplace(object_id.value());
+		return;
+	}
+	for (auto& index : indexes) {
+		m_column_indexes.emplace_back(std::move(index));
+	}
+}
+#undef ONSANG_SCOPE_FUNC
+
+#define ONSANG_SCOPE_FUNC store_column_indexes
+void
+Session::store_column_indexes() noexcept try {
+	auto* const flat = dynamic_cast<IO::FlatDatastore*>(&datastore());
+	if (flat && flat->is_open()) {
+		aux::vector<System::ColumnIndex const*> indexes;
+		String data;
+		for (auto const id_value : m_column_indexes_dirty) {
+			indexes.clear();
+			data.clear();
+			for (auto const& index : m_column_indexes) {
+				if (id_value == index->object_id().value()) {
+					indexes.emplace_back(index.get());
+				}
+			}
+			if (!indexes.empty()) {
+				System::ColumnIndex::write_file(indexes, data);
+			}
+			Hord::Object::ID const object_id{id_value};
+			if (!flat->store_extra(object_id, s_column_index_name, data)) {
+				Log::acquire(Log::error)
+					<< "Failed to store column indexes for object "
+					<< Hord::Object::IDPrinter{object_id}
+					<< '\n'
+				;
+			}
+		}
+	}
+	m_column_indexes.clear();
+	m_column_indexes_loaded.clear();
+	m_column_indexes_dirty.clear();
+} catch (...) {
+	Log::acquire(Log::error)
+		<< "Failed to store column indexes in session '"
+		<< m_name
+		<< "':\n"
+	;
+	Log::report_error_ptr(std::current_exception());
+	m_column_indexes.clear();
+	m_column_indexes_loaded.clear();
+	m_column_indexes_dirty.clear();
 }
 #undef ONSANG_SCOPE_FUNC
 
 #undef ONSANG_SCOPE_CLASS
 
+String const&
+Session::path_to(
+	Hord::Object::ID const object_id
+) {
+	static String const s_empty{};
+
+	auto const* const object = datastore().find_ptr(object_id);
+	if (!object) {
+		// Might have been cached before the object was destroyed
+		m_path_cache.erase(object_id.value());
+		return s_empty;
+	}
+	auto it = m_path_cache.find(object_id.value());
+	if (m_path_cache.end() == it) {
+		if (PATH_CACHE_LIMIT <= m_path_cache.size()) {
+			m_path_cache.clear();
+		}
+		it = m_path_cache.emplace(
+			object_id.value(),
+			Hord::Object::path_to(object_id, datastore())
+		).first;
+	}
+	return it->second;
+}
+
+Hord::Object::Unit*
+Session::find_ptr_path(
+	String const& path
+) {
+	auto const it = m_id_cache.find(path);
+	if (m_id_cache.end() != it) {
+		auto* const object = datastore().find_ptr(Hord::Object::ID{it->second});
+		if (object) {
+			return object;
+		}
+		m_id_cache.erase(it);
+	}
+	auto* const object = datastore().find_ptr_path(path);
+	if (object) {
+		if (PATH_CACHE_LIMIT <= m_id_cache.size()) {
+			m_id_cache.clear();
+		}
+		m_id_cache.emplace(path, object->id().value());
+	}
+	return object;
+}
+
+void
+Session::invalidate_paths() noexcept {
+	m_path_cache.clear();
+	m_id_cache.clear();
+}
+
+aux::vector<aux::unique_ptr<System::ColumnIndex>>::iterator
+Session::find_column_index(
+	Hord::Object::ID const object_id,
+	System::ColumnIndex::Source const source,
+	UI::index_type const column
+) noexcept {
+	return std::find_if(
+		m_column_indexes.begin(),
+		m_column_indexes.end(),
+		[object_id, source, column](
+			aux::unique_ptr<System::ColumnIndex> const& index
+		) {
+			return
+				object_id == index->object_id() &&
+				source == index->source() &&
+				column == index->column()
+			;
+		}
+	);
+}
+
+void
+Session::invalidate_metadata_indexes(
+	Hord::Object::ID const object_id
+) noexcept {
+	try {
+		load_column_indexes(object_id);
+	} catch (...) {
+		// Unread indexes are rebuilt by record count when used
+	}
+	for (auto& index : m_column_indexes) {
+		if (
+			object_id == index->object_id() &&
+			System::ColumnIndex::Source::metadata == index->source()
+		) {
+			index->invalidate();
+			m_column_indexes_dirty.emplace(object_id.value());
+		}
+	}
+}
+
+void
+Session::update_metadata_indexes(
+	Hord::Object::ID const object_id,
+	System::ColumnIndex::record_type const record,
+	UI::index_type const column
+) noexcept {
+	auto* const object = datastore().find_ptr(object_id);
+	if (!object) {
+		return;
+	}
+	try {
+		load_column_indexes(object_id);
+		auto const it = find_column_index(
+			object_id, System::ColumnIndex::Source::metadata, column
+		);
+		if (m_column_indexes.end() == it) {
+			return;
+		}
+		auto& table = object->metadata().table();
+		m_column_indexes_dirty.emplace(object_id.value());
+		(*it)->update(record, table.iterator_at(record).get_field(column));
+	} catch (...) {
+		invalidate_metadata_indexes(object_id);
+	}
+}
+
+System::ColumnIndex*
+Session::column_index(
+	Hord::Object::Unit& object,
+	Hord::Data::Table& table,
+	UI::index_type const column
+) {
+	load_column_indexes(object.id());
+	auto const it = find_column_index(
+		object.id(), column_index_source(object, table), column
+	);
+	if (m_column_indexes.end() == it) {
+		return nullptr;
+	}
+	auto& index = **it;
+	if (
+		!index.valid() ||
+		index.num_records() != static_cast<std::size_t>(table.num_records())
+	) {
+		index.build(table);
+		m_column_indexes_dirty.emplace(object.id().value());
+	}
+	return &index;
+}
+
+System::ColumnIndex&
+Session::add_column_index(
+	Hord::Object::Unit& object,
+	Hord::Data::Table& table,
+	UI::index_type const column,
+	System::ColumnIndex::Kind const kind
+) {
+	load_column_indexes(object.id());
+	auto const source = column_index_source(object, table);
+	auto it = find_column_index(object.id(), source, column);
+	if (m_column_indexes.end() != it) {
+		m_column_indexes.erase(it);
+	}
+	m_column_indexes.emplace_back(new System::ColumnIndex(
+		object.id(), source, column, kind
+	));
+	auto& index = *m_column_indexes.back();
+	index.build(table);
+	m_column_indexes_dirty.emplace(object.id().value());
+	return index;
+}
+
+bool
+Session::remove_column_index(
+	Hord::Object::Unit& object,
+	Hord::Data::Table& table,
+	UI::index_type const column
+) {
+	load_column_indexes(object.id());
+	auto const it = find_column_index(
+		object.id(), column_index_source(object, table), column
+	);
+	if (m_column_indexes.end() == it) {
+		return false;
+	}
+	m_column_indexes.erase(it);
+	m_column_indexes_dirty.emplace(object.id().value());
+	return true;
+}
+
 } // namespace System
 } // namespace Onsang
-
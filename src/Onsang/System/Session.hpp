@@ -11,14 +11,23 @@
 #include <Onsang/aux.hpp>
 #include <Onsang/String.hpp>
 #include <Onsang/System/Defs.hpp>
+#include <Onsang/System/Job.hpp>
+#include <Onsang/System/ColumnIndex.hpp>
+#include <Onsang/System/CommandStats.hpp>
 #include <Onsang/UI/Defs.hpp>
 #include <Onsang/UI/SessionView.hpp>
 
 #include <Hord/Object/Defs.hpp>
+#include <Hord/Object/Unit.hpp>
+#include <Hord/Data/Table.hpp>
 #include <Hord/IO/Datastore.hpp>
 #include <Hord/System/Driver.hpp>
 #include <Hord/System/Context.hpp>
 
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
 #include <utility>
 #include <exception>
 
@@ -31,6 +40,74 @@ class Session
 public:
 	using UPtr = aux::unique_ptr<System::Session>;
 
+	enum class WriteBackState : unsigned {
+		idle = 0u,
+		storing,
+		closing,
+		complete,
+		failed,
+	};
+
+	/**
+		How a CommandScope takes the driver.
+	*/
+	enum class Acquire : unsigned {
+		/** Block until the driver is free. */
+		wait = 0u,
+		/**
+			Give up if the driver is busy, and say so in the command
+			status line.
+
+			The UI thread uses this so a write-back never stalls it.
+		*/
+		no_wait,
+	};
+
+	/**
+		Scoped use of the Hord driver for one command.
+
+		Sessions share the Hord driver, so only one thread runs a
+		command at a time. A scope holds the driver from
+		construction to destruction; create one around each command
+		call and issue the command only if acquired().
+
+		The next command to complete on the thread is traced with
+		the time since construction. Commands issued without a
+		scope are traced without a start time.
+	*/
+	class CommandScope final {
+	private:
+		std::unique_lock<std::mutex> m_lock;
+
+		CommandScope() = delete;
+		CommandScope(CommandScope const&) = delete;
+		CommandScope(CommandScope&&) = delete;
+		CommandScope& operator=(CommandScope const&) = delete;
+		CommandScope& operator=(CommandScope&&) = delete;
+
+	public:
+		~CommandScope() noexcept;
+
+		/**
+			@param props Props the command touches
+			(Hord::IO::PropTypeBit), in addition to those implied by
+			its type.
+		*/
+		explicit
+		CommandScope(
+			Acquire const acquire,
+			unsigned const props = 0u
+		) noexcept;
+
+		/**
+			Whether the driver is held.
+		*/
+		bool
+		acquired() const noexcept {
+			return m_lock.owns_lock();
+		}
+	};
+
 private:
 	using base = Hord::System::Context;
 	enum class ctor_priv {};
@@ -41,9 +118,69 @@ private:
 	bool m_auto_create;
 	UI::SessionView::SPtr m_view;
 
+	struct WriteBack {
+		std::thread thread{};
+		std::atomic<WriteBackState> state{WriteBackState::idle};
+		std::exception_ptr eptr{};
+		std::size_t num_objects{0u};
+		std::size_t num_props{0u};
+		/** Prop bytes written (if the datastore counts them). */
+		std::uint64_t bytes_written{0u};
+		/** Time to store and close. */
+		double seconds{0.0};
+	};
+	aux::unique_ptr<WriteBack> m_writeback;
+
+	enum : std::size_t {
+		/** Path cache size limit (entries in each direction). */
+		PATH_CACHE_LIMIT = 1u << 16,
+	};
+
+	aux::vector<System::Job::WPtr> m_jobs{};
+	System::CommandStats m_command_stats{};
+
+	aux::unordered_map<Hord::Object::IDValue, String> m_path_cache{};
+	aux::unordered_map<String, Hord::Object::IDValue> m_id_cache{};
+
+	aux::vector<aux::unique_ptr<System::ColumnIndex>> m_column_indexes{};
+	/** Objects whose stored column indexes have been read. */
+	aux::unordered_set<Hord::Object::IDValue> m_column_indexes_loaded{};
+	/** Objects whose column indexes must be written on close. */
+	aux::unordered_set<Hord::Object::IDValue> m_column_indexes_dirty{};
+
 	Session() = delete;
 	Session(Session const&) = delete;
+	// The write-back thread holds this
+	Session(Session&&) = delete;
 	Session& operator=(Session const&) = delete;
+	Session& operator=(Session&&) = delete;
+
+	aux::vector<aux::unique_ptr<System::ColumnIndex>>::iterator
+	find_column_index(
+		Hord::Object::ID const object_id,
+		System::ColumnIndex::Source const source,
+		UI::index_type const column
+	) noexcept;
+
+	void
+	load_column_indexes(
+		Hord::Object::ID const object_id
+	);
+
+	void
+	store_column_indexes() noexcept;
+
+	void
+	invalidate_metadata_indexes(
+		Hord::Object::ID const object_id
+	) noexcept;
+
+	void
+	update_metadata_indexes(
+		Hord::Object::ID const object_id,
+		System::ColumnIndex::record_type const record,
+		UI::index_type const column
+	) noexcept;
 
 // Hord::System::Context implementation
 private:
@@ -62,9 +199,7 @@ private:
 
 public:
 // special member functions
-	~Session() override = default;
-	Session(Session&&) = default;
-	Session& operator=(Session&&) = default;
+	~Session() override;
 
 	/**
 		Throws Hord::Error:
@@ -85,6 +220,7 @@ public:
 		, m_auto_open(auto_open)
 		, m_auto_create(auto_create)
 		, m_view()
+		, m_writeback(new WriteBack())
 	{}
 
 	static System::Session::UPtr
@@ -133,18 +269,61 @@ public:
 		return m_view;
 	}
 
+	/**
+		Whether the datastore is open.
+
+		@note This must not be called while write_back_busy().
+	*/
 	bool
 	is_open() const noexcept {
 		return datastore().is_open();
 	}
 
+	/**
+		Whether a write-back is in progress.
+
+		The session must not be used while this is true.
+	*/
+	bool
+	write_back_busy() const noexcept {
+		return WriteBackState::idle != m_writeback->state.load();
+	}
+
+	WriteBackState
+	write_back_state() const noexcept {
+		return m_writeback->state.load();
+	}
+
+	/**
+		Get latency statistics for commands executed in the
+		session.
+	*/
+	System::CommandStats const&
+	command_stats() const noexcept {
+		return m_command_stats;
+	}
+
 // operations
 	/**
+		Open the datastore and initialize base props.
+
+		@note This does not touch the UI, so it can be called off
+		the UI thread. Call attach_view() afterwards.
+
+		Throws Onsang::Error:
+		- ErrorCode::command_failed
+
 		Throws Hord::Error:
 		- see Hord::IO::Datastore::open()
 	*/
 	void
-	open(
+	open();
+
+	/**
+		Create the session view.
+	*/
+	void
+	attach_view(
 		UI::RootWPtr root
 	);
 
@@ -156,10 +335,99 @@ public:
 	close();
 
 	/**
-		Process views.
+		Store and close on a background thread.
+
+		The view is released immediately. process() reports the
+		result once the write-back finishes.
+	*/
+	void
+	close_async();
+
+	/**
+		Process jobs and write-back completion.
 	*/
 	void
 	process();
+
+	/**
+		Add a job to poll from process().
+	*/
+	void
+	add_job(
+		System::Job::WPtr job
+	);
+
+	/**
+		Get the path to an object.
+
+		Paths are cached until a command changes the object
+		hierarchy. The returned reference is valid until the next
+		call that modifies the cache.
+
+		@returns The empty string if the object does not exist.
+	*/
+	String const&
+	path_to(
+		Hord::Object::ID const object_id
+	);
+
+	/**
+		Find an object by path.
+
+		Lookups are cached like path_to(). Misses are not.
+	*/
+	Hord::Object::Unit*
+	find_ptr_path(
+		String const& path
+	);
+
+	/**
+		Drop all cached paths.
+	*/
+	void
+	invalidate_paths() noexcept;
+
+	/**
+		Get the index for a column of @a table.
+
+		@a table must be the metadata or data table of @a object.
+		A stale index is rebuilt.
+
+		@returns @c nullptr if the column is not indexed.
+	*/
+	System::ColumnIndex*
+	column_index(
+		Hord::Object::Unit& object,
+		Hord::Data::Table& table,
+		UI::index_type const column
+	);
+
+	/**
+		Index a column of @a table.
+
+		If the column is already indexed, the index is rebuilt with
+		@a kind. Indexes are stored with the object when the session
+		is closed (if the datastore supports it).
+	*/
+	System::ColumnIndex&
+	add_column_index(
+		Hord::Object::Unit& object,
+		Hord::Data::Table& table,
+		UI::index_type const column,
+		System::ColumnIndex::Kind const kind
+	);
+
+	/**
+		Remove the index for a column of @a table.
+
+		@returns @c false if the column was not indexed.
+	*/
+	bool
+	remove_column_index(
+		Hord::Object::Unit& object,
+		Hord::Data::Table& table,
+		UI::index_type const column
+	);
 };
 
 } // namespace System
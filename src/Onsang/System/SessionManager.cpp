@@ -7,6 +7,7 @@
 #include <Onsang/System/Session.hpp>
 #include <Onsang/System/SessionManager.hpp>
 #include <Onsang/IO/FlatDatastore.hpp>
+#include <Onsang/IO/PackedDatastore.hpp>
 
 #include <Hord/System/Context.hpp>
 #include <Hord/IO/Datastore.hpp>
@@ -40,11 +41,14 @@ SessionManager::add_session(
 	Types:
 
 	- flat: IO::FlatDatastore
+	- packed: IO::PackedDatastore
 	*/
 	Hord::IO::Datastore::TypeInfo const*
 	datastore_tinfo = nullptr;
 	if ("flat" == type) {
 		datastore_tinfo = &IO::FlatDatastore::s_type_info;
+	} else if ("packed" == type) {
+		datastore_tinfo = &IO::PackedDatastore::s_type_info;
 	} else {
 		ONSANG_THROW_FMT(
 			ErrorCode::session_type_unrecognized,
@@ -56,11 +60,11 @@ SessionManager::add_session(
 		*datastore_tinfo,
 		path
 	);
-	Log::acquire(Log::debug)
-		<< "datastore root path: '"
+	ONSANG_LOG_DEBUG(
+		"datastore root path: '"
 		<< datastore.root_path()
 		<< "'\n"
-	;
+	);
 	m_sessions.emplace(
 		datastore.id(),
 		System::Session::make(
@@ -71,6 +75,18 @@ SessionManager::add_session(
 }
 #undef ONSANG_SCOPE_FUNC
 
+#define ONSANG_SCOPE_FUNC busy
+bool
+SessionManager::busy() const noexcept {
+	for (auto const& pair : m_sessions) {
+		if (pair.second->write_back_busy()) {
+			return true;
+		}
+	}
+	return false;
+}
+#undef ONSANG_SCOPE_FUNC
+
 #define ONSANG_SCOPE_FUNC process
 void
 SessionManager::process() {
@@ -129,6 +129,12 @@ public:
 		bool const auto_create
 	);
 
+	/**
+		Whether any session has a write-back in progress.
+	*/
+	bool
+	busy() const noexcept;
+
 	/**
 		Process sessions.
 	*/
@@ -0,0 +1,402 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+*/
+
+#include <Onsang/aux.hpp>
+#include <Onsang/utility.hpp>
+#include <Onsang/String.hpp>
+#include <Onsang/Log.hpp>
+#include <Onsang/System/Session.hpp>
+#include <Onsang/System/ValueText.hpp>
+#include <Onsang/System/TableExport.hpp>
+#include <Onsang/App.hpp>
+
+#include <Hord/Data/Defs.hpp>
+#include <Hord/Data/ValueRef.hpp>
+#include <Hord/Data/Table.hpp>
+
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <utility>
+
+namespace Onsang {
+namespace System {
+
+// class TableExport implementation
+
+char const
+TableExport::s_columnar_magic[8]{'O', 'N', 'S', 'C', 'O', 'L', '\0', '\0'};
+
+namespace {
+
+template<class T>
+inline static void
+put(
+	String& data,
+	T const value
+) {
+	data.append(reinterpret_cast<char const*>(&value), sizeof(T));
+}
+
+template<class T>
+inline static void
+put(
+	IO::FileWriter& writer,
+	T const value
+) noexcept {
+	writer.write(reinterpret_cast<char const*>(&value), sizeof(T));
+}
+
+inline static bool
+has_suffix(
+	String const& str,
+	char const* const suffix
+) noexcept {
+	auto const size = std::strlen(suffix);
+	return
+		size <= str.size() &&
+		0 == str.compare(str.size() - size, size, suffix)
+	;
+}
+
+} // anonymous namespace
+
+TableExport::TableExport(
+	System::Session& session,
+	Hord::Data::Table& table,
+	String path,
+	Format const format
+)
+	: m_session(session)
+	, m_table(table)
+	, m_path(std::move(path))
+	, m_format(format)
+{}
+
+TableExport::Format
+TableExport::format_for_path(
+	String const& path
+) noexcept {
+	if (has_suffix(path, ".tsv")) {
+		return Format::tsv;
+	} else if (has_suffix(path, ".jsonl") || has_suffix(path, ".json")) {
+		return Format::jsonl;
+	} else if (has_suffix(path, ".ocol")) {
+		return Format::columnar;
+	}
+	return Format::csv;
+}
+
+bool
+TableExport::start() {
+	if (!m_writer.open(m_path)) {
+		return false;
+	}
+	m_num_records = static_cast<std::size_t>(m_table.num_records());
+	m_record = 0u;
+	m_start = std::chrono::steady_clock::now();
+	write_header();
+	return true;
+}
+
+void
+TableExport::write_header() {
+	auto const num_columns = static_cast<unsigned>(m_table.num_columns());
+	switch (m_format) {
+	case Format::csv:
+	case Format::tsv: {
+		char const delimiter = Format::tsv == m_format ? '\t' : ',';
+		for (unsigned col = 0u; col < num_columns; ++col) {
+			if (0u < col) {
+				m_writer.put(delimiter);
+			}
+			m_writer.write(m_table.schema().column(col).name);
+		}
+		m_writer.put('\n');
+	}	break;
+
+	case Format::jsonl:
+		// Keys are escaped once
+		m_keys.resize(num_columns);
+		for (unsigned col = 0u; col < num_columns; ++col) {
+			auto const& name = m_table.schema().column(col).name;
+			auto& key = m_keys[col];
+			key.assign(1u, '"');
+			for (auto const c : name) {
+				if ('"' == c || '\\' == c) {
+					key.push_back('\\');
+				}
+				key.push_back(c);
+			}
+			key.append("\":");
+		}
+		break;
+
+	case Format::columnar:
+		m_writer.write(s_columnar_magic, sizeof(s_columnar_magic));
+		put<std::uint32_t>(m_writer, COLUMNAR_VERSION);
+		put<std::uint32_t>(m_writer, num_columns);
+		for (unsigned col = 0u; col < num_columns; ++col) {
+			auto const& column = m_table.schema().column(col);
+			put<std::uint8_t>(m_writer, static_cast<std::uint8_t>(column.type.type()));
+			put<std::uint32_t>(m_writer, static_cast<std::uint32_t>(column.name.size()));
+			m_writer.write(column.name);
+		}
+		m_group_types.resize(num_columns);
+		m_group_values.resize(num_columns);
+		m_group_records = 0u;
+		break;
+	}
+}
+
+void
+TableExport::write_delimited(
+	Hord::Data::Table::Iterator& it,
+	char const delimiter
+) {
+	System::ValueText::buffer_type buffer;
+	auto const num_columns = static_cast<unsigned>(m_table.num_columns());
+	for (unsigned col = 0u; col < num_columns; ++col) {
+		if (0u < col) {
+			m_writer.put(delimiter);
+		}
+		auto const value = it.get_field(col);
+		if (Hord::Data::ValueType::null == value.type.type()) {
+			continue;
+		}
+		auto const text = System::value_text(m_session, value, buffer);
+		auto const* const end = text.data + text.size;
+		bool quote = false;
+		for (auto const* p = text.data; !quote && end != p; ++p) {
+			quote = delimiter == *p || '"' == *p || '\n' == *p || '\r' == *p;
+		}
+		if (!quote) {
+			m_writer.write(text.data, text.size);
+			continue;
+		}
+		m_writer.put('"');
+		auto const* run = text.data;
+		for (auto const* p = text.data; end != p; ++p) {
+			if ('"' == *p) {
+				// Write up to and including the quote, then double it
+				m_writer.write(run, static_cast<std::size_t>(p - run) + 1u);
+				m_writer.put('"');
+				run = p + 1;
+			}
+		}
+		m_writer.write(run, static_cast<std::size_t>(end - run));
+		m_writer.put('"');
+	}
+	m_writer.put('\n');
+}
+
+void
+TableExport::write_json_string(
+	char const* data,
+	std::size_t size
+) {
+	static char const s_hex[]{"0123456789abcdef"};
+
+	m_writer.put('"');
+	auto const* run = data;
+	auto const* const end = data + size;
+	for (; end != data; ++data) {
+		auto const c = static_cast<unsigned char>(*data);
+		if ('"' != c && '\\' != c && 0x20 <= c) {
+			continue;
+		}
+		m_writer.write(run, static_cast<std::size_t>(data - run));
+		run = data + 1;
+		m_writer.put('\\');
+		switch (c) {
+		case '"': m_writer.put('"'); break;
+		case '\\': m_writer.put('\\'); break;
+		case '\n': m_writer.put('n'); break;
+		case '\r': m_writer.put('r'); break;
+		case '\t': m_writer.put('t'); break;
+		default:
+			m_writer.write("u00", 3u);
+			m_writer.put(s_hex[c >> 4]);
+			m_writer.put(s_hex[c & 0xF]);
+			break;
+		}
+	}
+	m_writer.write(run, static_cast<std::size_t>(end - run));
+	m_writer.put('"');
+}
+
+void
+TableExport::write_json(
+	Hord::Data::Table::Iterator& it
+) {
+	System::ValueText::buffer_type buffer;
+	auto const num_columns = static_cast<unsigned>(m_keys.size());
+	m_writer.put('{');
+	for (unsigned col = 0u; col < num_columns; ++col) {
+		if (0u < col) {
+			m_writer.put(',');
+		}
+		m_writer.write(m_keys[col]);
+		auto const value = it.get_field(col);
+		switch (value.type.type()) {
+		case Hord::Data::ValueType::integer: {
+			auto const text = System::value_text(m_session, value, buffer);
+			m_writer.write(text.data, text.size);
+		}	break;
+
+		case Hord::Data::ValueType::decimal:
+			if (std::isfinite(value.data.decimal)) {
+				auto const text = System::value_text(m_session, value, buffer);
+				m_writer.write(text.data, text.size);
+			} else {
+				m_writer.write("null", 4u);
+			}
+			break;
+
+		case Hord::Data::ValueType::string:
+		case Hord::Data::ValueType::object_id: {
+			auto const text = System::value_text(m_session, value, buffer);
+			write_json_string(text.data, text.size);
+		}	break;
+
+		default:
+			m_writer.write("null", 4u);
+			break;
+		}
+	}
+	m_writer.write("}\n", 2u);
+}
+
+void
+TableExport::add_columnar(
+	Hord::Data::Table::Iterator& it
+) {
+	auto const num_columns = static_cast<unsigned>(m_group_types.size());
+	for (unsigned col = 0u; col < num_columns; ++col) {
+		auto const value = it.get_field(col);
+		auto type = value.type.type();
+		auto& values = m_group_values[col];
+		switch (type) {
+		case Hord::Data::ValueType::integer:
+			put<std::int64_t>(values, value.data.integer);
+			break;
+
+		case Hord::Data::ValueType::decimal:
+			put<double>(values, value.data.decimal);
+			break;
+
+		case Hord::Data::ValueType::object_id:
+			put<std::uint32_t>(values, value.data.object_id);
+			break;
+
+		case Hord::Data::ValueType::string:
+			put<std::uint32_t>(values, value.size);
+			values.append(value.data.string, value.size);
+			break;
+
+		default:
+			type = Hord::Data::ValueType::null;
+			break;
+		}
+		m_group_types[col].push_back(static_cast<char>(type));
+	}
+	if (GROUP_RECORDS == ++m_group_records) {
+		flush_group();
+	}
+}
+
+void
+TableExport::flush_group() {
+	if (0u == m_group_records) {
+		return;
+	}
+	put<std::uint32_t>(m_writer, static_cast<std::uint32_t>(m_group_records));
+	for (std::size_t col = 0u; col < m_group_types.size(); ++col) {
+		auto& types = m_group_types[col];
+		auto& values = m_group_values[col];
+		put<std::uint64_t>(m_writer, types.size() + values.size());
+		m_writer.write(types);
+		m_writer.write(values);
+		types.clear();
+		values.clear();
+	}
+	m_group_records = 0u;
+}
+
+void
+TableExport::finish() {
+	m_finished = true;
+	if (Format::columnar == m_format) {
+		flush_group();
+		put<std::uint32_t>(m_writer, 0u);
+	}
+	auto const bytes = m_writer.bytes_written();
+	if (!m_writer.close()) {
+		App::instance.m_ui.csline->set_error("export failed: " + m_path);
+		Log::acquire(Log::error)
+			<< "Failed to write '"
+			<< m_path
+			<< "' after "
+			<< m_record
+			<< " records\n"
+		;
+		return;
+	}
+	auto const elapsed = std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - m_start
+	).count();
+	auto const per_second = [elapsed](double const amount) {
+		return 0.0 < elapsed ? amount / elapsed : 0.0;
+	};
+	auto const mib = static_cast<double>(bytes) / (1024.0 * 1024.0);
+	Log::acquire()
+		<< "Exported "
+		<< m_record << " records ("
+		<< mib << " MiB) to '"
+		<< m_path << "' in "
+		<< elapsed << " s: "
+		<< per_second(static_cast<double>(m_record)) << " records/s, "
+		<< per_second(mib) << " MiB/s\n"
+	;
+	App::instance.m_ui.csline->set_description(
+		"exported " + std::to_string(m_record) + " records to " + m_path
+	);
+}
+
+bool
+TableExport::poll_impl() {
+	if (m_finished) {
+		return true;
+	}
+	// Records erased since the export started are not written
+	auto const end = min_ce(
+		m_num_records,
+		static_cast<std::size_t>(m_table.num_records())
+	);
+	auto const chunk_end = min_ce(m_record + std::size_t{CHUNK_RECORDS}, end);
+	if (m_record < chunk_end) {
+		auto it = m_table.iterator_at(static_cast<unsigned>(m_record));
+		for (; m_record < chunk_end; ++m_record, ++it) {
+			switch (m_format) {
+			case Format::csv: write_delimited(it, ','); break;
+			case Format::tsv: write_delimited(it, '\t'); break;
+			case Format::jsonl: write_json(it); break;
+			case Format::columnar: add_columnar(it); break;
+			}
+		}
+	}
+	if (m_record < end && !m_writer.failed()) {
+		App::instance.m_events.arm_timer(0u);
+		App::instance.m_ui.csline->set_description(
+			"exporting: " + std::to_string(m_record) + " of " +
+			std::to_string(end) + " records"
+		);
+		return false;
+	}
+	finish();
+	return true;
+}
+
+} // namespace System
+} // namespace Onsang
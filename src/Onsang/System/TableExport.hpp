@@ -0,0 +1,197 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+
+@file
+@brief Table export job.
+*/
+
+#pragma once
+
+#include <Onsang/config.hpp>
+#include <Onsang/aux.hpp>
+#include <Onsang/String.hpp>
+#include <Onsang/System/Defs.hpp>
+#include <Onsang/System/Job.hpp>
+#include <Onsang/IO/FileWriter.hpp>
+
+#include <Hord/Data/ValueRef.hpp>
+#include <Hord/Data/Table.hpp>
+
+#include <chrono>
+#include <cstdint>
+
+/*
+
+Columnar table file (".ocol").
+
+Records are stored in groups; each group holds the values of every
+column contiguously. One group is buffered at a time, so writing and
+reading take memory proportional to GROUP_RECORDS rather than to the
+table.
+
+Structure:
+
+	"ONSCOL\0\0" u32 version; u32 num_columns;
+	Column[num_columns]:
+		u8 type; u32 name_size; u8 name[name_size];
+	Group[]:
+		u32 num_records; (0 ends the file)
+		Chunk[num_columns]:
+			u64 size;
+			u8 type[num_records]; (Hord::Data::ValueType)
+			Value[]: (one per non-null record, in order)
+				integer: i64;
+				decimal: f64;
+				object_id: u32;
+				string: u32 size; u8 data[size];
+
+All values are in host byte order.
+
+*/
+
+namespace Onsang {
+namespace System {
+
+/**
+	Write the records of a table to a file.
+
+	Records are streamed from table iterators into an
+	IO::FileWriter, CHUNK_RECORDS per session poll, so the table
+	stays usable while large exports run and is never copied.
+	Values are formatted as grids show them (see value_text()).
+*/
+class TableExport final
+	: public System::Job
+{
+public:
+	using SPtr = aux::shared_ptr<System::TableExport>;
+
+	enum class Format : unsigned {
+		/** Comma-separated, with a header line. */
+		csv = 0u,
+		/** Tab-separated, with a header line. */
+		tsv,
+		/** One JSON object per record. */
+		jsonl,
+		/** Binary columnar groups; see above. */
+		columnar,
+	};
+
+	enum : std::size_t {
+		/** Records written per poll. */
+		CHUNK_RECORDS = 16384u,
+		/** Records per columnar group. */
+		GROUP_RECORDS = 65536u,
+	};
+
+	enum : std::uint32_t {
+		COLUMNAR_VERSION = 1u,
+	};
+
+	static char const
+	s_columnar_magic[8];
+
+private:
+	System::Session& m_session;
+	Hord::Data::Table& m_table;
+	String const m_path;
+	Format const m_format;
+	IO::FileWriter m_writer{};
+
+	std::size_t m_num_records{0u};
+	std::size_t m_record{0u};
+	bool m_finished{false};
+	std::chrono::steady_clock::time_point m_start{};
+
+	/** JSON object keys (@c "name":), by column. */
+	aux::vector<String> m_keys{};
+	/** Columnar group types and values, by column. */
+	aux::vector<String> m_group_types{};
+	aux::vector<String> m_group_values{};
+	std::size_t m_group_records{0u};
+
+	TableExport() = delete;
+
+// System::Job implementation
+	bool
+	poll_impl() override;
+
+	void
+	write_header();
+
+	void
+	write_delimited(
+		Hord::Data::Table::Iterator& it,
+		char const delimiter
+	);
+
+	void
+	write_json(
+		Hord::Data::Table::Iterator& it
+	);
+
+	void
+	write_json_string(
+		char const* data,
+		std::size_t size
+	);
+
+	void
+	add_columnar(
+		Hord::Data::Table::Iterator& it
+	);
+
+	void
+	flush_group();
+
+	void
+	finish();
+
+public:
+// special member functions
+	~TableExport() noexcept override = default;
+
+	TableExport(
+		System::Session& session,
+		Hord::Data::Table& table,
+		String path,
+		Format const format
+	);
+
+// properties
+	String const&
+	path() const noexcept {
+		return m_path;
+	}
+
+	/**
+		Whether the export has ended (successfully or not).
+	*/
+	bool
+	finished() const noexcept {
+		return m_finished;
+	}
+
+// operations
+	/**
+		Get the format for a file extension.
+
+		@c .tsv, @c .jsonl (or @c .json) and @c .ocol select their
+		formats; anything else is CSV.
+	*/
+	static Format
+	format_for_path(
+		String const& path
+	) noexcept;
+
+	/**
+		Open the file and write the header.
+
+		@returns @c false if the file could not be opened.
+	*/
+	bool
+	start();
+};
+
+} // namespace System
+} // namespace Onsang
@@ -0,0 +1,625 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+*/
+
+#include <Onsang/aux.hpp>
+#include <Onsang/utility.hpp>
+#include <Onsang/String.hpp>
+#include <Onsang/ErrorCode.hpp>
+#include <Onsang/Log.hpp>
+#include <Onsang/System/Session.hpp>
+#include <Onsang/System/TableExport.hpp>
+#include <Onsang/System/TableImport.hpp>
+#include <Onsang/App.hpp>
+
+#include <Hord/Object/Defs.hpp>
+#include <Hord/Object/Unit.hpp>
+#include <Hord/Data/Defs.hpp>
+#include <Hord/Data/ValueRef.hpp>
+#include <Hord/Data/Table.hpp>
+#include <Hord/IO/Defs.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <utility>
+
+#include <Onsang/detail/gr_ceformat.hpp>
+
+namespace Onsang {
+namespace System {
+
+// class TableImport implementation
+
+#define ONSANG_SCOPE_CLASS System::TableImport
+
+namespace {
+ONSANG_DEF_FMT_CLASS(
+	s_err_read_failed,
+	"failed to read %s"
+);
+ONSANG_DEF_FMT_CLASS(
+	s_err_malformed_group,
+	"malformed columnar group in %s"
+);
+} // anonymous namespace
+
+TableImport::~TableImport() noexcept {
+	{
+		std::lock_guard<std::mutex> lock{m_mutex};
+		m_cancel = true;
+	}
+	m_cv.notify_all();
+	if (m_thread.joinable()) {
+		m_thread.join();
+	}
+}
+
+TableImport::TableImport(
+	System::Session& session,
+	Hord::Object::Unit& object,
+	Hord::Data::Table& table,
+	String path,
+	append_function_type append_func
+)
+	: m_session(session)
+	, m_object(object)
+	, m_table(table)
+	, m_path(std::move(path))
+	, m_append_func(std::move(append_func))
+{
+	auto const num_columns = static_cast<unsigned>(m_table.num_columns());
+	m_column_types.reserve(num_columns);
+	m_column_names.reserve(num_columns);
+	for (unsigned col = 0u; col < num_columns; ++col) {
+		auto const& column = m_table.schema().column(col);
+		m_column_types.emplace_back(column.type.type());
+		m_column_names.emplace_back(column.name);
+	}
+}
+
+bool
+TableImport::open_columnar() {
+	m_stream.open(m_path, std::ios_base::in | std::ios_base::binary);
+	char magic[sizeof(TableExport::s_columnar_magic)];
+	if (
+		!m_stream.is_open() ||
+		!read_stream(magic, sizeof(magic)) ||
+		!std::equal(magic, magic + sizeof(magic), TableExport::s_columnar_magic)
+	) {
+		m_stream.close();
+		m_stream_read = 0u;
+		return false;
+	}
+	m_columnar = true;
+	std::uint32_t version = 0u;
+	std::uint32_t num_columns = 0u;
+	if (
+		!read_stream(&version, sizeof(version)) ||
+		TableExport::COLUMNAR_VERSION != version ||
+		!read_stream(&num_columns, sizeof(num_columns))
+	) {
+		return false;
+	}
+	m_file_types.resize(num_columns);
+	String name;
+	for (auto& type : m_file_types) {
+		std::uint8_t type_value = 0u;
+		std::uint32_t name_size = 0u;
+		if (
+			!read_stream(&type_value, sizeof(type_value)) ||
+			!read_stream(&name_size, sizeof(name_size))
+		) {
+			return false;
+		}
+		type = static_cast<Hord::Data::ValueType>(type_value);
+		name.resize(name_size);
+		if (!read_stream(&name[0], name_size)) {
+			return false;
+		}
+	}
+	m_stream.seekg(0, std::ios_base::end);
+	m_file_size = static_cast<std::uint64_t>(m_stream.tellg());
+	m_stream.seekg(static_cast<std::streamoff>(m_stream_read));
+	return m_stream.good();
+}
+
+bool
+TableImport::start() {
+	if (m_column_types.empty()) {
+		return false;
+	} else if (!open_columnar()) {
+		if (m_columnar || !m_reader.open(m_path)) {
+			return false;
+		}
+		m_file_size = m_reader.file_size();
+	}
+	m_start = std::chrono::steady_clock::now();
+	m_thread = std::thread(&TableImport::run, this);
+	return true;
+}
+
+aux::unique_ptr<TableImport::Batch>
+TableImport::acquire_batch() {
+	std::unique_lock<std::mutex> lock{m_mutex};
+	m_cv.wait(lock, [this]() {
+		return m_cancel || !m_free.empty() || MAX_BATCHES > m_ready.size();
+	});
+	if (m_cancel) {
+		return nullptr;
+	}
+	aux::unique_ptr<Batch> batch;
+	if (!m_free.empty()) {
+		batch = std::move(m_free.back());
+		m_free.pop_back();
+	} else {
+		batch.reset(new Batch());
+		batch->values.reserve(BATCH_RECORDS * m_column_types.size());
+	}
+	lock.unlock();
+	batch->text.clear();
+	batch->text.reserve(BATCH_BYTES);
+	batch->values.clear();
+	batch->num_records = 0u;
+	return batch;
+}
+
+bool
+TableImport::submit_batch(
+	aux::unique_ptr<Batch>& batch
+) {
+	{
+		std::unique_lock<std::mutex> lock{m_mutex};
+		// Wait for the UI thread to catch up to keep the number
+		// of batches bounded
+		m_cv.wait(lock, [this]() {
+			return m_cancel || MAX_BATCHES > m_ready.size();
+		});
+		if (m_cancel) {
+			return false;
+		}
+		m_ready.emplace_back(std::move(batch));
+	}
+	m_bytes_read.store(m_columnar ? m_stream_read : m_reader.bytes_read());
+	App::instance.m_events.wake();
+	return true;
+}
+
+bool
+TableImport::reserve_record(
+	aux::unique_ptr<Batch>& batch,
+	std::size_t const needed
+) {
+	// Values point into the batch text, so it must not grow
+	// past its capacity while the batch is open
+	auto& text = batch->text;
+	if (0u < batch->num_records && text.capacity() < text.size() + needed) {
+		if (!submit_batch(batch) || !(batch = acquire_batch())) {
+			return false;
+		}
+	}
+	if (batch->text.capacity() < needed) {
+		batch->text.reserve(needed);
+	}
+	return true;
+}
+
+bool
+TableImport::end_record(
+	aux::unique_ptr<Batch>& batch
+) {
+	if (BATCH_RECORDS == ++batch->num_records) {
+		if (!submit_batch(batch) || !(batch = acquire_batch())) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool
+TableImport::read_stream(
+	void* const data,
+	std::size_t const size
+) {
+	m_stream.read(static_cast<char*>(data), static_cast<std::streamsize>(size));
+	m_stream_read += static_cast<std::uint64_t>(m_stream.gcount());
+	return static_cast<std::size_t>(m_stream.gcount()) == size;
+}
+
+#define ONSANG_SCOPE_FUNC run_delimited
+void
+TableImport::run_delimited() {
+	auto const num_columns = m_column_types.size();
+	bool first_record = true;
+	auto batch = acquire_batch();
+	while (batch && m_reader.next_record()) {
+		auto const num_fields = min_ce(m_reader.num_fields(), num_columns);
+		if (first_record) {
+			first_record = false;
+			bool is_header = num_fields == num_columns;
+			for (std::size_t index = 0u; is_header && index < num_fields; ++index) {
+				auto const& name = m_column_names[index];
+				is_header
+					= name.size() == m_reader.field_size(index)
+					&& 0 == std::memcmp(
+						name.data(), m_reader.field_data(index), name.size()
+					)
+				;
+			}
+			if (is_header) {
+				continue;
+			}
+		}
+
+		std::size_t needed = 0u;
+		for (std::size_t index = 0u; index < num_fields; ++index) {
+			needed += m_reader.field_size(index) + 1u;
+		}
+		if (!reserve_record(batch, needed)) {
+			break;
+		}
+
+		for (std::size_t index = 0u; index < num_columns; ++index) {
+			Hord::Data::ValueRef value{};
+			if (index < num_fields && 0u < m_reader.field_size(index)) {
+				auto const size = m_reader.field_size(index);
+				auto const offset = batch->text.size();
+				batch->text.append(m_reader.field_data(index), size);
+				batch->text.push_back('\0');
+				char const* const data = batch->text.data() + offset;
+				switch (m_column_types[index]) {
+				case Hord::Data::ValueType::string:
+				// Resolved on the UI thread
+				case Hord::Data::ValueType::object_id:
+					value.type = {Hord::Data::ValueType::string};
+					value.data.string = data;
+					value.size = static_cast<unsigned>(size);
+					break;
+
+				default:
+					value.read_from_string(static_cast<unsigned>(size), data);
+					break;
+				}
+			}
+			batch->values.emplace_back(value);
+		}
+		if (!end_record(batch)) {
+			break;
+		}
+	}
+	if (batch && 0u < batch->num_records) {
+		submit_batch(batch);
+	}
+	m_bytes_read.store(m_reader.bytes_read());
+	if (m_reader.failed()) {
+		ONSANG_THROW_FMT(
+			ErrorCode::io_read_failed,
+			s_err_read_failed,
+			m_path
+		);
+	}
+}
+#undef ONSANG_SCOPE_FUNC
+
+namespace {
+
+/** Decode the next value of a columnar chunk. */
+inline static bool
+read_columnar_value(
+	Hord::Data::ValueType const type,
+	char const*& pos,
+	char const* const end,
+	Hord::Data::ValueRef& value
+) noexcept {
+	auto const read = [&pos, end](void* const data, std::size_t const size) {
+		if (static_cast<std::size_t>(end - pos) < size) {
+			return false;
+		}
+		std::memcpy(data, pos, size);
+		pos += size;
+		return true;
+	};
+	value = {};
+	switch (type) {
+	case Hord::Data::ValueType::null:
+		return true;
+
+	case Hord::Data::ValueType::integer: {
+		std::int64_t integer = 0;
+		if (!read(&integer, sizeof(integer))) {
+			return false;
+		}
+		value.type = {Hord::Data::ValueType::integer};
+		value.data.integer = integer;
+	}	return true;
+
+	case Hord::Data::ValueType::decimal: {
+		double decimal = 0.0;
+		if (!read(&decimal, sizeof(decimal))) {
+			return false;
+		}
+		value.type = {Hord::Data::ValueType::decimal};
+		value.data.decimal = decimal;
+	}	return true;
+
+	case Hord::Data::ValueType::object_id: {
+		std::uint32_t id = 0u;
+		if (!read(&id, sizeof(id))) {
+			return false;
+		}
+		value = Hord::Object::ID{id};
+	}	return true;
+
+	case Hord::Data::ValueType::string: {
+		std::uint32_t size = 0u;
+		if (!read(&size, sizeof(size)) || static_cast<std::size_t>(end - pos) < size) {
+			return false;
+		}
+		value.type = {Hord::Data::ValueType::string};
+		value.data.string = pos;
+		value.size = size;
+		pos += size;
+	}	return true;
+
+	default:
+		return false;
+	}
+}
+
+} // anonymous namespace
+
+#define ONSANG_SCOPE_FUNC run_columnar
+void
+TableImport::run_columnar() {
+	auto const num_columns = m_column_types.size();
+	auto const num_file_columns = m_file_types.size();
+	// One group is held at a time; chunk buffers are reused
+	aux::vector<String> chunks(num_file_columns);
+	aux::vector<char const*> positions(num_file_columns);
+	aux::vector<Hord::Data::ValueRef> record(num_columns);
+	auto batch = acquire_batch();
+	while (batch) {
+		std::uint32_t num_records = 0u;
+		if (!read_stream(&num_records, sizeof(num_records))) {
+			ONSANG_THROW_FMT(
+				ErrorCode::io_read_failed,
+				s_err_read_failed,
+				m_path
+			);
+		} else if (0u == num_records) {
+			break;
+		}
+		for (std::size_t col = 0u; col < num_file_columns; ++col) {
+			std::uint64_t size = 0u;
+			auto& chunk = chunks[col];
+			if (!read_stream(&size, sizeof(size)) || size < num_records) {
+				ONSANG_THROW_FMT(
+					ErrorCode::io_read_failed,
+					s_err_malformed_group,
+					m_path
+				);
+			}
+			chunk.resize(static_cast<std::size_t>(size));
+			if (!read_stream(&chunk[0], chunk.size())) {
+				ONSANG_THROW_FMT(
+					ErrorCode::io_read_failed,
+					s_err_read_failed,
+					m_path
+				);
+			}
+			// Values follow the type array
+			positions[col] = chunk.data() + num_records;
+		}
+		for (std::size_t index = 0u; index < num_records; ++index) {
+			std::size_t needed = 0u;
+			for (std::size_t col = 0u; col < num_file_columns; ++col) {
+				auto const& chunk = chunks[col];
+				Hord::Data::ValueRef value{};
+				if (!read_columnar_value(
+					static_cast<Hord::Data::ValueType>(
+						static_cast<std::uint8_t>(chunk[index])
+					),
+					positions[col], chunk.data() + chunk.size(), value
+				)) {
+					ONSANG_THROW_FMT(
+						ErrorCode::io_read_failed,
+						s_err_malformed_group,
+						m_path
+					);
+				} else if (col >= num_columns) {
+					continue;
+				}
+				// Numbers convert if the column type changed since the
+				// export; other mismatched values become null
+				auto const type = value.type.type();
+				auto const column_type = m_column_types[col];
+				if (Hord::Data::ValueType::null == type || column_type == type) {
+					if (Hord::Data::ValueType::string == type) {
+						needed += value.size + 1u;
+					}
+				} else if (
+					Hord::Data::ValueType::decimal == column_type &&
+					Hord::Data::ValueType::integer == type
+				) {
+					auto const integer = value.data.integer;
+					value.type = {Hord::Data::ValueType::decimal};
+					value.data.decimal = static_cast<double>(integer);
+				} else if (
+					Hord::Data::ValueType::integer == column_type &&
+					Hord::Data::ValueType::decimal == type
+				) {
+					auto const decimal = value.data.decimal;
+					value.type = {Hord::Data::ValueType::integer};
+					value.data.integer = static_cast<std::int64_t>(decimal);
+				} else {
+					value = {};
+				}
+				record[col] = value;
+			}
+			for (std::size_t col = num_file_columns; col < num_columns; ++col) {
+				record[col] = {};
+			}
+			if (!reserve_record(batch, needed)) {
+				break;
+			}
+			for (auto value : record) {
+				if (Hord::Data::ValueType::string == value.type.type()) {
+					// Copy out of the group
+					auto const offset = batch->text.size();
+					batch->text.append(value.data.string, value.size);
+					batch->text.push_back('\0');
+					value.data.string = batch->text.data() + offset;
+				}
+				batch->values.emplace_back(value);
+			}
+			if (!end_record(batch)) {
+				break;
+			}
+		}
+	}
+	if (batch && 0u < batch->num_records) {
+		submit_batch(batch);
+	}
+	m_bytes_read.store(m_stream_read);
+}
+#undef ONSANG_SCOPE_FUNC
+
+void
+TableImport::run() noexcept try {
+	if (m_columnar) {
+		run_columnar();
+	} else {
+		run_delimited();
+	}
+	{
+		std::lock_guard<std::mutex> lock{m_mutex};
+		m_done = true;
+	}
+	App::instance.m_events.wake();
+} catch (...) {
+	{
+		std::lock_guard<std::mutex> lock{m_mutex};
+		m_eptr = std::current_exception();
+		m_done = true;
+	}
+	App::instance.m_events.wake();
+}
+
+void
+TableImport::append_batch(
+	Batch const& batch
+) {
+	auto const num_columns = m_column_types.size();
+	auto const first = static_cast<std::size_t>(m_table.num_records());
+	auto value_it = batch.values.cbegin();
+	for (std::size_t record = 0u; record < batch.num_records; ++record) {
+		auto it = m_table.insert(m_table.end());
+		for (std::size_t col = 0u; col < num_columns; ++col, ++value_it) {
+			auto value = *value_it;
+			if (
+				Hord::Data::ValueType::object_id == m_column_types[col] &&
+				Hord::Data::ValueType::string == value.type.type()
+			) {
+				auto* const object = m_session.find_ptr_path(
+					String{value.data.string, value.size}
+				);
+				value = object ? object->id() : Hord::Object::ID_NULL;
+			}
+			it.set_field(static_cast<unsigned>(col), value);
+		}
+	}
+	m_object.prop_states().assign(
+		Hord::IO::PropType::primary,
+		Hord::IO::PropState::modified
+	);
+	m_num_records += batch.num_records;
+	if (m_append_func) {
+		m_append_func(first, batch.num_records);
+	}
+}
+
+void
+TableImport::report() const {
+	auto const elapsed = std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - m_start
+	).count();
+	auto const bytes = static_cast<double>(m_bytes_read.load());
+	auto const per_second = [elapsed](double const amount) {
+		return 0.0 < elapsed ? amount / elapsed : 0.0;
+	};
+	Log::acquire()
+		<< "Imported "
+		<< m_num_records << " records ("
+		<< bytes / (1024.0 * 1024.0) << " MiB) from '"
+		<< m_path << "' in "
+		<< elapsed << " s: "
+		<< per_second(static_cast<double>(m_num_records)) << " records/s, "
+		<< per_second(bytes) / (1024.0 * 1024.0) << " MiB/s\n"
+	;
+	App::instance.m_ui.csline->set_description(
+		"imported " + std::to_string(m_num_records) + " records (" +
+		std::to_string(static_cast<std::uint64_t>(
+			per_second(static_cast<double>(m_num_records))
+		)) + " records/s)"
+	);
+}
+
+bool
+TableImport::poll_impl() {
+	aux::unique_ptr<Batch> batch;
+	bool done = false;
+	{
+		std::lock_guard<std::mutex> lock{m_mutex};
+		if (!m_ready.empty()) {
+			batch = std::move(m_ready.front());
+			m_ready.pop_front();
+		}
+		done = m_done && m_ready.empty();
+	}
+	if (batch) {
+		append_batch(*batch);
+		{
+			std::lock_guard<std::mutex> lock{m_mutex};
+			m_free.emplace_back(std::move(batch));
+		}
+		m_cv.notify_all();
+		if (!done) {
+			// One batch per loop pass keeps the UI responsive
+			App::instance.m_events.arm_timer(0u);
+			auto const file_size = m_file_size;
+			App::instance.m_ui.csline->set_description(
+				"importing: " + std::to_string(m_num_records) + " records" + (
+					0u < file_size
+					? " (" + std::to_string(
+						100u * m_bytes_read.load() / file_size
+					) + "%)"
+					: String{}
+				)
+			);
+		}
+	}
+	if (!done) {
+		return false;
+	}
+	m_thread.join();
+	m_finished = true;
+	if (m_eptr) {
+		App::instance.m_ui.csline->set_error("import failed: " + m_path);
+		Log::acquire(Log::error)
+			<< "Import from '"
+			<< m_path
+			<< "' failed after "
+			<< m_num_records
+			<< " records:\n"
+		;
+		Log::report_error_ptr(m_eptr);
+	} else {
+		report();
+	}
+	return true;
+}
+
+#undef ONSANG_SCOPE_CLASS
+
+} // namespace System
+} // namespace Onsang
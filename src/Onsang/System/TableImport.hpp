@@ -0,0 +1,225 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+
+@file
+@brief Delimited text import job.
+*/
+
+#pragma once
+
+#include <Onsang/config.hpp>
+#include <Onsang/aux.hpp>
+#include <Onsang/String.hpp>
+#include <Onsang/System/Defs.hpp>
+#include <Onsang/System/Job.hpp>
+#include <Onsang/IO/DelimitedReader.hpp>
+
+#include <Hord/Object/Unit.hpp>
+#include <Hord/Data/Defs.hpp>
+#include <Hord/Data/ValueRef.hpp>
+#include <Hord/Data/Table.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace Onsang {
+namespace System {
+
+/**
+	Append records from a CSV, TSV or columnar file to a table.
+
+	A worker thread parses the file and converts fields to values
+	in batches. Batches are appended to the table on the UI thread
+	when the session polls the job. At most MAX_BATCHES batches
+	exist at once, so memory use does not depend on the file size.
+
+	File fields map to table columns by position. A first record
+	that repeats the column names is skipped. Columnar files (see
+	TableExport) are detected by their magic and read one group at a
+	time; their values are taken as stored, without parsing.
+*/
+class TableImport final
+	: public System::Job
+{
+public:
+	using SPtr = aux::shared_ptr<System::TableImport>;
+
+	enum : std::size_t {
+		/** Records per batch. */
+		BATCH_RECORDS = 4096u,
+		/** Field bytes per batch (a larger record gets its own). */
+		BATCH_BYTES = 1u << 20,
+		MAX_BATCHES = 4u,
+	};
+
+	/**
+		Called on the UI thread after @a count records were
+		appended from record index @a first.
+	*/
+	using append_function_type = std::function<void(
+		std::size_t const first,
+		std::size_t const count
+	)>;
+
+private:
+	struct Batch {
+		/** Field bytes; values point into it. */
+		String text{};
+		/** Record-major values. */
+		aux::vector<Hord::Data::ValueRef> values{};
+		std::size_t num_records{0u};
+	};
+
+	System::Session& m_session;
+	Hord::Object::Unit& m_object;
+	Hord::Data::Table& m_table;
+	String const m_path;
+	append_function_type m_append_func;
+
+	/** Column types and names, for the worker. */
+	aux::vector<Hord::Data::ValueType> m_column_types{};
+	aux::vector<String> m_column_names{};
+	IO::DelimitedReader m_reader{};
+	/** Columnar input, if m_columnar. */
+	std::ifstream m_stream{};
+	bool m_columnar{false};
+	/** Column types of the columnar file. */
+	aux::vector<Hord::Data::ValueType> m_file_types{};
+	std::uint64_t m_file_size{0u};
+	/** Bytes consumed from m_stream. */
+	std::uint64_t m_stream_read{0u};
+
+	std::thread m_thread{};
+	std::mutex m_mutex{};
+	std::condition_variable m_cv{};
+	/** Batches ready to append. */
+	std::deque<aux::unique_ptr<Batch>> m_ready{};
+	/** Batches to reuse. */
+	aux::vector<aux::unique_ptr<Batch>> m_free{};
+	bool m_cancel{false};
+	bool m_done{false};
+	std::exception_ptr m_eptr{};
+	std::atomic<std::uint64_t> m_bytes_read{0u};
+
+	std::size_t m_num_records{0u};
+	bool m_finished{false};
+	std::chrono::steady_clock::time_point m_start{};
+
+	TableImport() = delete;
+
+// System::Job implementation
+	bool
+	poll_impl() override;
+
+	bool
+	open_columnar();
+
+	void
+	run() noexcept;
+
+	void
+	run_delimited();
+
+	void
+	run_columnar();
+
+	bool
+	read_stream(
+		void* const data,
+		std::size_t const size
+	);
+
+	aux::unique_ptr<Batch>
+	acquire_batch();
+
+	/**
+		Make room for a record with @a needed bytes of text,
+		submitting the batch if it is full.
+
+		@returns @c false if the import was canceled.
+	*/
+	bool
+	reserve_record(
+		aux::unique_ptr<Batch>& batch,
+		std::size_t const needed
+	);
+
+	/**
+		@returns @c false if the import was canceled.
+	*/
+	bool
+	end_record(
+		aux::unique_ptr<Batch>& batch
+	);
+
+	/**
+		Queue @a batch for the UI thread.
+
+		@returns @c false if the import was canceled.
+	*/
+	bool
+	submit_batch(
+		aux::unique_ptr<Batch>& batch
+	);
+
+	void
+	append_batch(
+		Batch const& batch
+	);
+
+	void
+	report() const;
+
+public:
+// special member functions
+	~TableImport() noexcept override;
+
+	TableImport(
+		System::Session& session,
+		Hord::Object::Unit& object,
+		Hord::Data::Table& table,
+		String path,
+		append_function_type append_func
+	);
+
+// properties
+	String const&
+	path() const noexcept {
+		return m_path;
+	}
+
+	/**
+		Number of records appended so far.
+	*/
+	std::size_t
+	num_records() const noexcept {
+		return m_num_records;
+	}
+
+	/**
+		Whether the import has ended (successfully or not).
+	*/
+	bool
+	finished() const noexcept {
+		return m_finished;
+	}
+
+// operations
+	/**
+		Open the file and start the worker thread.
+
+		@returns @c false if the file could not be opened.
+	*/
+	bool
+	start();
+};
+
+} // namespace System
+} // namespace Onsang
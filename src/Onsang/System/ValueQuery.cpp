@@ -0,0 +1,161 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+*/
+
+#include <Onsang/String.hpp>
+#include <Onsang/System/ValueQuery.hpp>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+namespace Onsang {
+namespace System {
+
+// class ValueQuery implementation
+
+template<class T>
+bool
+ValueQuery::compare(
+	T const x,
+	T const y
+) const noexcept {
+	switch (m_op) {
+	case Op::substring: // fall-through
+	// Neither less nor greater; also instantiated with double, and
+	// -Wfloat-equal rejects ==
+	case Op::equal: return !(x < y) && !(y < x);
+	case Op::less: return x < y;
+	case Op::less_equal: return x <= y;
+	case Op::greater: return x > y;
+	case Op::greater_equal: return x >= y;
+	}
+	return false;
+}
+
+void
+ValueQuery::assign(
+	String query
+) {
+	m_query = std::move(query);
+	m_text.clear();
+	m_op = Op::substring;
+	m_numeric = false;
+	m_integer = false;
+
+	char const* number = m_query.c_str();
+	switch (*number) {
+	case '=': m_op = Op::equal; ++number; break;
+	case '<': m_op = Op::less; ++number; break;
+	case '>': m_op = Op::greater; ++number; break;
+	default: break;
+	}
+	if (Op::substring != m_op && '=' == *number) {
+		if (Op::less == m_op) {
+			m_op = Op::less_equal;
+			++number;
+		} else if (Op::greater == m_op) {
+			m_op = Op::greater_equal;
+			++number;
+		}
+	}
+	while (' ' == *number) {
+		++number;
+	}
+	if ('\0' == *number) {
+		m_op = Op::substring;
+		return;
+	}
+	m_text.assign(number);
+
+	char* end = nullptr;
+	errno = 0;
+	auto const integer = std::strtoll(number, &end, 10);
+	if ('\0' == *end && 0 == errno) {
+		m_numeric = true;
+		m_integer = true;
+		m_integer_value = static_cast<std::int64_t>(integer);
+		m_decimal_value = static_cast<double>(integer);
+		return;
+	}
+	errno = 0;
+	auto const decimal = std::strtod(number, &end);
+	if ('\0' == *end && 0 == errno) {
+		m_numeric = true;
+		m_decimal_value = decimal;
+		return;
+	}
+	if (Op::equal != m_op) {
+		// Not a number; treat the comparison as part of the text
+		m_op = Op::substring;
+		m_text = m_query;
+	}
+}
+
+bool
+ValueQuery::match_string(
+	char const* const data,
+	std::size_t const size
+) const noexcept {
+	if (Op::equal == m_op && !m_numeric) {
+		return
+			size == m_text.size() &&
+			0 == std::memcmp(data, m_text.data(), size)
+		;
+	} else if (Op::substring != m_op) {
+		return false;
+	}
+	auto const* const needle = m_query.data();
+	auto const needle_size = m_query.size();
+	if (0u == needle_size) {
+		return true;
+	} else if (size < needle_size) {
+		return false;
+	}
+	// memchr() is vectorized by the C library, so skip ahead to
+	// candidates by the first byte and only then compare the rest
+	auto const* it = data;
+	auto const* const last = data + (size - needle_size);
+	while (it <= last) {
+		auto const* const candidate = static_cast<char const*>(
+			std::memchr(it, needle[0], static_cast<std::size_t>(last - it) + 1u)
+		);
+		if (!candidate) {
+			return false;
+		} else if (0 == std::memcmp(candidate + 1, needle + 1, needle_size - 1u)) {
+			return true;
+		}
+		it = candidate + 1;
+	}
+	return false;
+}
+
+bool
+ValueQuery::match_integer(
+	std::int64_t const value
+) const noexcept {
+	if (!m_numeric) {
+		return false;
+	} else if (m_integer) {
+		return compare(value, m_integer_value);
+	} else {
+		return compare(
+			static_cast<long double>(value),
+			static_cast<long double>(m_decimal_value)
+		);
+	}
+}
+
+bool
+ValueQuery::match_decimal(
+	double const value
+) const noexcept {
+	if (!m_numeric) {
+		return false;
+	}
+	return compare(value, m_decimal_value);
+}
+
+} // namespace System
+} // namespace Onsang
@@ -0,0 +1,148 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+
+@file
+@brief Value comparison query.
+*/
+
+#pragma once
+
+#include <Onsang/config.hpp>
+#include <Onsang/String.hpp>
+#include <Onsang/System/Defs.hpp>
+
+#include <cstdint>
+
+namespace Onsang {
+namespace System {
+
+/**
+	Query matching values by comparison.
+
+	A plain query matches string values containing it. If the query
+	is a number, it also matches numeric values equal to it.
+	A query starting with a comparison (@c =, @c <, @c <=, @c >,
+	@c >=) followed by a number only matches numeric values.
+	@c = followed by anything else matches equal string values.
+*/
+class ValueQuery {
+public:
+	enum class Op : unsigned {
+		substring = 0u,
+		equal,
+		less,
+		less_equal,
+		greater,
+		greater_equal,
+	};
+
+private:
+	String m_query{};
+	/** Query without the comparison. */
+	String m_text{};
+	Op m_op{Op::substring};
+	bool m_numeric{false};
+	bool m_integer{false};
+	std::int64_t m_integer_value{0};
+	double m_decimal_value{0.0};
+
+	template<class T>
+	bool
+	compare(
+		T const x,
+		T const y
+	) const noexcept;
+
+public:
+// special member functions
+	~ValueQuery() noexcept = default;
+
+	ValueQuery() = default;
+	ValueQuery(ValueQuery const&) = default;
+	ValueQuery(ValueQuery&&) = default;
+	ValueQuery& operator=(ValueQuery const&) = default;
+	ValueQuery& operator=(ValueQuery&&) = default;
+
+// properties
+	String const&
+	query() const noexcept {
+		return m_query;
+	}
+
+	bool
+	empty() const noexcept {
+		return m_query.empty();
+	}
+
+	Op
+	op() const noexcept {
+		return m_op;
+	}
+
+	String const&
+	text() const noexcept {
+		return m_text;
+	}
+
+	/**
+		Whether the query matches string values.
+	*/
+	bool
+	textual() const noexcept {
+		return Op::substring == m_op || !m_numeric;
+	}
+
+	/**
+		Whether the query matches numeric values.
+	*/
+	bool
+	numeric() const noexcept {
+		return m_numeric;
+	}
+
+	/**
+		Whether the numeric query is an integer.
+	*/
+	bool
+	integer() const noexcept {
+		return m_integer;
+	}
+
+	std::int64_t
+	integer_value() const noexcept {
+		return m_integer_value;
+	}
+
+	double
+	decimal_value() const noexcept {
+		return m_decimal_value;
+	}
+
+// operations
+	/**
+		Parse @a query.
+	*/
+	void
+	assign(
+		String query
+	);
+
+	bool
+	match_string(
+		char const* const data,
+		std::size_t const size
+	) const noexcept;
+
+	bool
+	match_integer(
+		std::int64_t const value
+	) const noexcept;
+
+	bool
+	match_decimal(
+		double const value
+	) const noexcept;
+};
+
+} // namespace System
+} // namespace Onsang
@@ -0,0 +1,40 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+*/
+
+#include <Onsang/System/Session.hpp>
+#include <Onsang/System/ValueText.hpp>
+
+#include <Hord/Data/Defs.hpp>
+#include <Hord/Data/ValueRef.hpp>
+
+#include <duct/IO/memstream.hpp>
+
+namespace Onsang {
+namespace System {
+
+System::ValueText
+value_text(
+	System::Session& session,
+	Hord::Data::ValueRef const& value,
+	System::ValueText::buffer_type& buffer
+) noexcept {
+	switch (value.type.type()) {
+	case Hord::Data::ValueType::object_id: {
+		auto const& path = session.path_to(value.data.object_id);
+		return {path.data(), path.size()};
+	}
+
+	case Hord::Data::ValueType::string:
+		return {value.data.string, value.size};
+
+	default: {
+		duct::IO::omemstream format_stream{buffer, sizeof(buffer)};
+		format_stream << value;
+		return {buffer, static_cast<std::size_t>(format_stream.tellp())};
+	}
+	}
+}
+
+} // namespace System
+} // namespace Onsang
@@ -0,0 +1,53 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+
+@file
+@brief Value display text.
+*/
+
+#pragma once
+
+#include <Onsang/config.hpp>
+#include <Onsang/System/Defs.hpp>
+
+#include <Hord/Data/ValueRef.hpp>
+
+#include <cstddef>
+
+namespace Onsang {
+namespace System {
+
+/**
+	Text of a value as grids show it.
+*/
+struct ValueText {
+	enum : std::size_t {
+		/** Size of the buffer formatted values are written to. */
+		BUFFER_SIZE = 48u,
+	};
+
+	using buffer_type = char[BUFFER_SIZE];
+
+	char const* data;
+	std::size_t size;
+};
+
+/**
+	Get the text of @a value.
+
+	Strings are used as-is and object IDs are shown as paths (see
+	Session::path_to()). Other values are formatted into
+	@a buffer, so nothing is allocated per value.
+
+	@note The text of an object ID is only valid until the session
+	path cache changes.
+*/
+System::ValueText
+value_text(
+	System::Session& session,
+	Hord::Data::ValueRef const& value,
+	System::ValueText::buffer_type& buffer
+) noexcept;
+
+} // namespace System
+} // namespace Onsang
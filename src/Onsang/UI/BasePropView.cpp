@@ -2,6 +2,7 @@
 @copyright MIT license; see @ref index or the accompanying LICENSE file.
 */
 
+#include <Onsang/aux.hpp>
 #include <Onsang/utility.hpp>
 #include <Onsang/System/Session.hpp>
 #include <Onsang/UI/Defs.hpp>
@@ -20,12 +21,30 @@
 #include <Hord/Object/Defs.hpp>
 #include <Hord/Cmd/Object.hpp>
 
+#include <algorithm>
+#include <functional>
+
 namespace Onsang {
 namespace UI {
 
 static UI::FieldDescriber const
 s_grid_metadata_describer{"metadata"};
 
+namespace {
+
+/**
+	Metadata fields removed by a batch erase.
+
+	While active, removals are collected here instead of updating
+	the grid per command.
+*/
+struct MetaFieldErase {
+	bool active{false};
+	aux::vector<UI::index_type> fields{};
+};
+
+} // anonymous namespace
+
 static KeyInputMatch const
 s_kim_erase_metafield[]{
 	{KeyMod::none, KeyCode::none, 'e', false},
@@ -52,10 +71,17 @@ add_base_prop_view(
 		bool const accept
 	) {
 		if (accept) {
-			// NB: signal_notify_command handles result
-			Hord::Cmd::Object::SetSlug{session}(
-				object, field_slug->text()
-			);
+			System::Session::CommandScope const scope{
+				System::Session::Acquire::no_wait
+			};
+			if (scope.acquired()) {
+				// NB: signal_notify_command handles result
+				Hord::Cmd::Object::SetSlug{session}(
+					object, field_slug->text()
+				);
+			} else {
+				field_slug->set_text(object.slug());
+			}
 		} else {
 			field_slug->set_text(object.slug());
 		}
@@ -67,7 +93,10 @@ add_base_prop_view(
 		object.metadata().table()
 	);
 	auto& grid_metadata_ref = *grid_metadata;
-	grid_metadata->signal_event_filter.bind([&session, &object, &grid_metadata_ref](
+	auto const metafield_erase = aux::make_shared<MetaFieldErase>();
+	grid_metadata->signal_event_filter.bind([
+		&session, &object, &grid_metadata_ref, metafield_erase
+	](
 		UI::Widget::SPtr const& widget,
 		UI::Event const& event
 	) -> bool {
@@ -82,19 +111,45 @@ add_base_prop_view(
 			if (grid_metadata_ref.row_count() <= 0) {
 				return false;
 			}
+			// Display rows may be sorted or filtered; remove by
+			// field index, last first
+			aux::vector<UI::index_type> fields;
 			if (&s_kim_erase_metafield[0] != kim_match) {
-				c_remove(object, grid_metadata_ref.m_cursor.row);
+				fields.push_back(grid_metadata_ref.record_index(grid_metadata_ref.m_cursor.row));
+			}
+			for (auto const& range : grid_metadata_ref.m_sel.ranges()) {
+				for (auto row = range.first; row < range.second; ++row) {
+					fields.push_back(grid_metadata_ref.record_index(row));
+				}
 			}
-			for (signed index = grid_metadata_ref.row_count() - 1; index >= 0; --index) {
-				if (grid_metadata_ref.m_sel[index]) {
-					c_remove(object, index);
+			std::sort(fields.begin(), fields.end(), std::greater<UI::index_type>{});
+			fields.erase(std::unique(fields.begin(), fields.end()), fields.end());
+			metafield_erase->active = true;
+			metafield_erase->fields.clear();
+			for (auto const field : fields) {
+				System::Session::CommandScope const scope{
+					System::Session::Acquire::no_wait
+				};
+				if (!scope.acquired()) {
+					break;
 				}
+				c_remove(object, field);
 			}
+			metafield_erase->active = false;
+			// Removed last first, so the fields are still in
+			// descending order
+			grid_metadata_ref.erase_rows(metafield_erase->fields);
+			metafield_erase->fields.clear();
 			return true;
 		} else if (event.key_input.cp == 'i' || event.key_input.cp == 'n') {
-			Hord::Cmd::Object::SetMetaField{session}(
-				object, "new" + std::to_string(grid_metadata_ref.row_count()), {}, true
-			);
+			System::Session::CommandScope const scope{
+				System::Session::Acquire::no_wait
+			};
+			if (scope.acquired()) {
+				Hord::Cmd::Object::SetMetaField{session}(
+					object, "new" + std::to_string(grid_metadata_ref.row_count()), {}, true
+				);
+			}
 			return true;
 		}
 		return false;
@@ -105,7 +160,12 @@ add_base_prop_view(
 		String const& string_value,
 		Hord::Data::ValueRef& new_value
 	) {
-		if (col == 0) {
+		System::Session::CommandScope const scope{
+			System::Session::Acquire::no_wait
+		};
+		if (!scope.acquired()) {
+			return;
+		} else if (col == 0) {
 			Hord::Cmd::Object::RenameMetaField{session}(
 				object, it.index, string_value
 			);
@@ -117,7 +177,9 @@ add_base_prop_view(
 	});
 
 	auto view = UI::PropView::make(root, "base", UI::Axis::vertical);
-	view->signal_notify_command.bind([&object, &field_slug_ref, &grid_metadata_ref](
+	view->signal_notify_command.bind([
+		&object, &field_slug_ref, &grid_metadata_ref, metafield_erase
+	](
 		UI::View* const /*parent_view*/,
 		UI::PropView& /*prop_view*/,
 		Hord::Cmd::UnitBase const& command,
@@ -152,7 +214,11 @@ add_base_prop_view(
 
 		case Hord::Cmd::Object::RemoveMetaField::COMMAND_ID: {
 			auto const& c = static_cast<Hord::Cmd::Object::RemoveMetaField const&>(command);
-			grid_metadata_ref.erase(c.field_index(), 1);
+			if (metafield_erase->active) {
+				metafield_erase->fields.push_back(c.field_index());
+			} else {
+				grid_metadata_ref.erase(c.field_index(), 1);
+			}
 		}	break;
 		}
 	});
@@ -3,15 +3,52 @@
 */
 
 #include <Onsang/utility.hpp>
+#include <Onsang/System/Job.hpp>
+#include <Onsang/System/Session.hpp>
 #include <Onsang/UI/Defs.hpp>
 #include <Onsang/UI/BasicGrid.hpp>
 #include <Onsang/App.hpp>
 
 #include <duct/debug.hpp>
 
+#include <string>
+#include <utility>
+
 namespace Onsang {
 namespace UI {
 
+class BasicGrid::FilterJob final
+	: public System::Job
+{
+public:
+	BasicGrid& m_grid;
+
+private:
+// System::Job implementation
+	bool
+	poll_impl() override {
+		if (m_grid.m_filter_job.get() != this) {
+			// Superseded
+			return true;
+		} else if (m_grid.filter_step()) {
+			return true;
+		}
+		// Come back on the next loop iteration without waiting for
+		// input; input is still handled between chunks
+		App::instance.m_events.arm_timer(0u);
+		return false;
+	}
+
+public:
+	~FilterJob() noexcept override = default;
+
+	FilterJob(
+		BasicGrid& grid
+	) noexcept
+		: m_grid(grid)
+	{}
+};
+
 void
 BasicGrid::reflow_impl() noexcept {
 	base::reflow_impl();
@@ -128,7 +165,19 @@ BasicGrid::content_action(
 ) noexcept {
 	using CA = UI::ProtoGrid::ContentAction;
 
-	DUCT_ASSERTE(row_count() == signed_cast(m_sel.size()));
+	DUCT_ASSERTE(row_count() == m_sel.size());
+	switch (action) {
+	case CA::insert_after:
+	case CA::insert_before:
+	case CA::erase:
+	case CA::erase_selected:
+		// These take content rows
+		clear_filter();
+		break;
+
+	default:
+		break;
+	}
 	// Cast insert_after in terms of insert_before
 	if (CA::insert_after == action) {
 		++row_begin;
@@ -139,32 +188,30 @@ BasicGrid::content_action(
 	switch (action) {
 	// Select
 	case CA::select: // fall-through
-	case CA::unselect: {
-		bool const enable = CA::select == action;
-		auto const end = m_sel.begin() + row_end;
-		for (auto it = m_sel.begin() + row_begin; end > it; ++it) {
-			*it = enable;
-		}
+	case CA::unselect:
+		m_sel.assign(row_begin, row_end, CA::select == action);
 		queue_cell_render(row_begin, row_end);
 		clear_flag = UI::UpdateActions::flag_noclear;
-	}	break;
+		break;
 
-	case CA::select_toggle: {
-		auto const end = m_sel.begin() + row_end;
-		for (auto it = m_sel.begin() + row_begin; end > it; ++it) {
-			*it = !*it;
-		}
+	case CA::select_toggle:
+		m_sel.toggle(row_begin, row_end);
 		queue_cell_render(row_begin, row_end);
 		clear_flag = UI::UpdateActions::flag_noclear;
-	}	break;
+		break;
 
 	// Insert
 	case CA::insert_after: // fall-through
 	case CA::insert_before:
-		for (UI::index_type i = 0; i < count; ++i) {
-			if (content_insert(row_begin + i)) {
-				m_sel.insert(m_sel.begin() + row_begin + i, false);
-				content_action_internal(CA::insert_before, row_begin + i, 1);
+		if (0 < count && content_insert_span(row_begin, count)) {
+			m_sel.insert(row_begin, count);
+			content_action_internal(CA::insert_before, row_begin, count);
+		} else {
+			for (UI::index_type i = 0; i < count; ++i) {
+				if (content_insert(row_begin + i)) {
+					m_sel.insert(row_begin + i, 1);
+					content_action_internal(CA::insert_before, row_begin + i, 1);
+				}
 			}
 		}
 		if (row_count() == 1) {
@@ -177,24 +224,18 @@ BasicGrid::content_action(
 
 	// Erase
 	case CA::erase:
-		for (UI::index_type i = 0; i < count; ++i) {
-			if (content_erase(row_begin)) {
-				m_sel.erase(m_sel.cbegin() + row_begin);
-				content_action_internal(CA::erase, row_begin, 1);
-			}
-		}
+		erase_span(row_begin, row_end - row_begin);
 		break;
 
-	case CA::erase_selected:
-		for (UI::index_type index = 0; index < row_count();) {
-			if (m_sel[index] && content_erase(index)) {
-				m_sel.erase(m_sel.cbegin() + index);
-				content_action_internal(CA::erase, index, 1);
-			} else {
-				++index;
-			}
+	case CA::erase_selected: {
+		// Back to front so that unvisited ranges keep their rows
+		aux::vector<std::pair<UI::index_type, UI::index_type>> ranges{
+			m_sel.ranges().cbegin(), m_sel.ranges().cend()
+		};
+		for (auto it = ranges.crbegin(); ranges.crend() != it; ++it) {
+			erase_span(it->first, it->second - it->first);
 		}
-		break;
+	}	break;
 	} // switch (action)
 
 	// Post action
@@ -215,6 +256,54 @@ BasicGrid::content_action(
 	);
 }
 
+void
+BasicGrid::erase_span(
+	UI::index_type const row,
+	UI::index_type const count
+) noexcept {
+	using CA = UI::ProtoGrid::ContentAction;
+
+	if (0 >= count) {
+		return;
+	} else if (content_erase_span(row, count)) {
+		m_sel.erase(row, count);
+		content_action_internal(CA::erase, row, count);
+		return;
+	}
+	for (auto index = row + count - 1; index >= row; --index) {
+		if (content_erase(index)) {
+			m_sel.erase(index, 1);
+			content_action_internal(CA::erase, index, 1);
+		}
+	}
+}
+
+void
+BasicGrid::erase_rows(
+	aux::vector<UI::index_type> const& rows
+) noexcept {
+	if (rows.empty()) {
+		return;
+	}
+	clear_filter();
+	for (auto it = rows.cbegin(); rows.cend() != it;) {
+		auto next = it + 1;
+		while (rows.cend() != next && *(next - 1) - 1 == *next) {
+			++next;
+		}
+		auto const row_begin = max_ce(*(next - 1), UI::index_type{0});
+		auto const row_end = min_ce(*it + 1, row_count());
+		if (row_begin < row_end) {
+			erase_span(row_begin, row_end - row_begin);
+		}
+		it = next;
+	}
+	// Let cursor clamp to new bounds
+	set_cursor(m_cursor.col, m_cursor.row);
+	adjust_view();
+	enqueue_actions(UI::UpdateActions::render);
+}
+
 void
 BasicGrid::adjust_view() noexcept {
 	auto const& view = this->view();
@@ -283,6 +372,8 @@ BasicGrid::resize_grid(
 	UI::index_type new_col_count,
 	UI::index_type new_row_count
 ) {
+	drop_filter();
+	m_sel.reset();
 	m_sel.resize(new_row_count);
 	set_row_count(new_row_count);
 	set_col_count(new_col_count);
@@ -299,5 +390,138 @@ BasicGrid::resize_grid(
 	);
 }
 
+void
+BasicGrid::set_display_rows(
+	UI::index_type const count
+) noexcept {
+	auto const old_count = row_count();
+	m_sel.resize(count);
+	set_row_count(count);
+	update_view(
+		view().row_range.x, view().row_range.x + view().fit_count,
+		0, col_count(),
+		false
+	);
+	// Let cursor clamp to new bounds (or land on the first row)
+	set_cursor(m_cursor.col, m_cursor.row);
+	adjust_view();
+	queue_cell_render(min_ce(old_count, count), row_count());
+	enqueue_actions(
+		UI::UpdateActions::render |
+		UI::UpdateActions::flag_noclear
+	);
+}
+
+bool
+BasicGrid::filter_step() noexcept {
+	auto const scan_end = min_ce(
+		m_filter_scan + UI::index_type{FILTER_CHUNK_ROWS},
+		m_filter_content_rows
+	);
+	m_filter_scan
+		= content_filter(m_filter_scan, scan_end, m_filter, m_filter_rows)
+		? m_filter_content_rows
+		: scan_end
+	;
+	auto const num_matches = static_cast<UI::index_type>(m_filter_rows.size());
+	if (num_matches != row_count()) {
+		set_display_rows(num_matches);
+	}
+	if (m_filter_scan < m_filter_content_rows) {
+		return false;
+	}
+	m_filter_job.reset();
+	App::instance.m_ui.csline->set_description(
+		std::to_string(num_matches) + " of " +
+		std::to_string(m_filter_content_rows) + " rows match \"" +
+		m_filter.query() + "\""
+	);
+	return true;
+}
+
+void
+BasicGrid::drop_filter() noexcept {
+	m_filter_job.reset();
+	if (!m_filtered) {
+		return;
+	}
+	m_filtered = false;
+	aux::vector<UI::index_type>{}.swap(m_filter_rows);
+	content_remapped();
+}
+
+void
+BasicGrid::set_filter(
+	System::Session& session,
+	String query,
+	UI::index_type const column
+) {
+	if (query.empty()) {
+		clear_filter();
+		return;
+	}
+	m_filter_job.reset();
+	if (!m_filtered) {
+		m_filter_content_rows = row_count();
+		m_filtered = true;
+	}
+	m_filter.assign(std::move(query), column);
+	m_filter_rows.clear();
+	m_filter_scan = 0;
+	m_sel.reset();
+	content_remapped();
+	update_view(0, view().fit_count, 0, col_count(), false);
+	set_display_rows(0);
+	queue_header_render();
+	enqueue_actions(UI::UpdateActions::render);
+
+	// The first chunk is scanned right away so that small
+	// contents never wait on the loop
+	if (filter_step()) {
+		return;
+	}
+	auto job = aux::make_shared<FilterJob>(*this);
+	m_filter_job = job;
+	session.add_job(job);
+	App::instance.m_events.arm_timer(0u);
+	App::instance.m_ui.csline->set_description(
+		"searching for \"" + m_filter.query() + "\""
+	);
+}
+
+void
+BasicGrid::clear_filter() {
+	if (!m_filtered) {
+		m_filter_job.reset();
+		return;
+	}
+	// Carry the selection and cursor over to content rows
+	UI::RowSelection sel{m_filter_content_rows};
+	for (auto const& range : m_sel.ranges()) {
+		for (auto row = range.first; row < range.second; ++row) {
+			auto const index = content_row(row);
+			sel.assign(index, index + 1, true);
+		}
+	}
+	auto const cursor_row
+		= value_in_bounds(m_cursor.row, 0, row_count())
+		? content_row(m_cursor.row)
+		: 0
+	;
+	drop_filter();
+	m_sel = std::move(sel);
+	set_row_count(m_filter_content_rows);
+	update_view(
+		view().row_range.x, view().row_range.x + view().fit_count,
+		0, col_count(),
+		false
+	);
+	set_cursor(m_cursor.col, cursor_row);
+	adjust_view();
+	queue_header_render();
+	queue_cell_render(0, row_count());
+	enqueue_actions(UI::UpdateActions::render);
+}
+
 } // namespace UI
 } // namespace Onsang
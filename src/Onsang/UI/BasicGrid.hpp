@@ -9,8 +9,12 @@
 
 #include <Onsang/config.hpp>
 #include <Onsang/aux.hpp>
+#include <Onsang/String.hpp>
 #include <Onsang/utility.hpp>
+#include <Onsang/System/Defs.hpp>
 #include <Onsang/UI/Defs.hpp>
+#include <Onsang/UI/RowFilter.hpp>
+#include <Onsang/UI/RowSelection.hpp>
 
 #include <Beard/ui/Widget/Base.hpp>
 #include <Beard/ui/Root.hpp>
@@ -19,8 +23,6 @@
 namespace Onsang {
 namespace UI {
 
-// TODO: Store selected ranges instead of row states
-
 class BasicGrid
 	: public UI::ProtoGrid
 {
@@ -32,9 +34,26 @@ public:
 		UI::index_type col{-1};
 		UI::index_type row{-1};
 	} m_cursor{};
-	aux::vector<bool> m_sel;
+	UI::RowSelection m_sel;
 
 private:
+	enum : UI::index_type {
+		/** Content rows scanned per filter step. */
+		FILTER_CHUNK_ROWS = 4096,
+	};
+
+	class FilterJob;
+
+	UI::RowFilter m_filter{};
+	bool m_filtered{false};
+	/** Display row to content row, while filtered. */
+	aux::vector<UI::index_type> m_filter_rows{};
+	/** Number of content rows, while filtered. */
+	UI::index_type m_filter_content_rows{0};
+	/** Next content row to scan. */
+	UI::index_type m_filter_scan{0};
+	aux::shared_ptr<FilterJob> m_filter_job{};
+
 	BasicGrid() noexcept = delete;
 	BasicGrid(BasicGrid const&) = delete;
 	BasicGrid& operator=(BasicGrid const&) = delete;
@@ -96,10 +115,87 @@ protected:
 		UI::index_type row
 	) noexcept = 0;
 
+	/**
+		Insert @a count rows before @a row in one operation.
+
+		@returns @c false to fall back to content_insert() for
+		each row.
+	*/
+	virtual bool
+	content_insert_span(
+		UI::index_type /*row*/,
+		UI::index_type /*count*/
+	) noexcept {
+		return false;
+	}
+
+	/**
+		Erase rows [@a row, @a row + @a count) in one operation.
+
+		@returns @c false to fall back to content_erase() for each
+		row (e.g., if some rows cannot be erased).
+	*/
+	virtual bool
+	content_erase_span(
+		UI::index_type /*row*/,
+		UI::index_type /*count*/
+	) noexcept {
+		return false;
+	}
+
+	/**
+		Append content rows in [@a row_begin, @a row_end) that
+		match @a filter to @a matches, in order.
+
+		@returns @c true if matches for all content rows from
+		@a row_begin on were appended (e.g., from an index), which
+		ends the scan.
+	*/
+	virtual bool
+	content_filter(
+		UI::index_type row_begin,
+		UI::index_type row_end,
+		UI::RowFilter const& filter,
+		aux::vector<UI::index_type>& matches
+	) noexcept = 0;
+
+	/**
+		Called when display rows map to different content rows.
+	*/
+	virtual void
+	content_remapped() noexcept {}
+
+private:
+	void
+	erase_span(
+		UI::index_type row,
+		UI::index_type count
+	) noexcept;
+
 protected:
 	void
 	adjust_view() noexcept;
 
+private:
+	/**
+		Change the row count without touching content.
+	*/
+	void
+	set_display_rows(
+		UI::index_type const count
+	) noexcept;
+
+	/**
+		Scan the next chunk of content rows.
+
+		@returns Whether the scan finished.
+	*/
+	bool
+	filter_step() noexcept;
+
+	void
+	drop_filter() noexcept;
+
 public:
 	virtual
 	~BasicGrid() noexcept override = 0;
@@ -170,6 +266,65 @@ public:
 		UI::index_type new_col_count,
 		UI::index_type new_row_count
 	);
+
+	bool
+	is_filtered() const noexcept {
+		return m_filtered;
+	}
+
+	UI::RowFilter const&
+	filter() const noexcept {
+		return m_filter;
+	}
+
+	/**
+		Get the content row for a display row.
+
+		Rows given to insert and erase actions are content rows;
+		they clear the filter first. Selection actions take
+		display rows.
+	*/
+	UI::index_type
+	content_row(
+		UI::index_type const row
+	) const noexcept {
+		return m_filtered ? m_filter_rows[static_cast<std::size_t>(row)] : row;
+	}
+
+	/**
+		Show only rows matching @a query.
+
+		Content is scanned in chunks by a job on @a session, so
+		matches appear as they are found. An empty query clears
+		the filter. If @a column is not -1, only that column is
+		matched.
+	*/
+	void
+	set_filter(
+		System::Session& session,
+		String query,
+		UI::index_type const column = -1
+	);
+
+	/**
+		Show all rows.
+
+		The cursor and selection move to the content rows they
+		were on.
+	*/
+	void
+	clear_filter();
+
+	/**
+		Erase content rows, given in descending order.
+
+		Runs of adjacent rows are erased as spans, and the view is
+		updated once for all of them. This clears the filter.
+	*/
+	void
+	erase_rows(
+		aux::vector<UI::index_type> const& rows
+	) noexcept;
 };
 inline BasicGrid::~BasicGrid() noexcept = default;
 
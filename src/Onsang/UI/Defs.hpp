@@ -29,6 +29,7 @@ enum class OnsangWidgetType : unsigned {
 	SessionView,
 	ObjectView,
 	PropView,
+	StatsView,
 };
 
 /*#define DPROP_(name) \
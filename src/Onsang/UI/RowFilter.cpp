@@ -0,0 +1,25 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+*/
+
+#include <Onsang/String.hpp>
+#include <Onsang/UI/RowFilter.hpp>
+
+#include <utility>
+
+namespace Onsang {
+namespace UI {
+
+// class RowFilter implementation
+
+void
+RowFilter::assign(
+	String query,
+	UI::index_type const column
+) {
+	base::assign(std::move(query));
+	m_column = column;
+}
+
+} // namespace UI
+} // namespace Onsang
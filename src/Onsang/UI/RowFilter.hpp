@@ -0,0 +1,63 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+
+@file
+@brief Grid row filter.
+*/
+
+#pragma once
+
+#include <Onsang/config.hpp>
+#include <Onsang/String.hpp>
+#include <Onsang/System/ValueQuery.hpp>
+#include <Onsang/UI/Defs.hpp>
+
+namespace Onsang {
+namespace UI {
+
+/**
+	Search query for filtering grid rows.
+
+	Values match as with System::ValueQuery. The filter can be
+	limited to one column.
+*/
+class RowFilter final
+	: public System::ValueQuery
+{
+private:
+	using base = System::ValueQuery;
+
+	UI::index_type m_column{-1};
+
+public:
+// special member functions
+	~RowFilter() noexcept = default;
+
+	RowFilter() = default;
+	RowFilter(RowFilter const&) = default;
+	RowFilter(RowFilter&&) = default;
+	RowFilter& operator=(RowFilter const&) = default;
+	RowFilter& operator=(RowFilter&&) = default;
+
+// properties
+	/**
+		Column to match, or -1 for all columns.
+	*/
+	UI::index_type
+	column() const noexcept {
+		return m_column;
+	}
+
+// operations
+	/**
+		Parse @a query.
+	*/
+	void
+	assign(
+		String query,
+		UI::index_type const column = -1
+	);
+};
+
+} // namespace UI
+} // namespace Onsang
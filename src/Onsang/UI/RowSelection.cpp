@@ -0,0 +1,178 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+*/
+
+#include <Onsang/utility.hpp>
+#include <Onsang/UI/Defs.hpp>
+#include <Onsang/UI/RowSelection.hpp>
+
+#include <utility>
+
+namespace Onsang {
+namespace UI {
+
+// class RowSelection implementation
+
+void
+RowSelection::split(
+	UI::index_type const row
+) {
+	auto it = m_ranges.upper_bound(row);
+	if (m_ranges.begin() == it) {
+		return;
+	}
+	--it;
+	if (it->first < row && row < it->second) {
+		auto const end = it->second;
+		it->second = row;
+		m_ranges.emplace_hint(std::next(it), row, end);
+	}
+}
+
+void
+RowSelection::merge(
+	UI::index_type const row
+) {
+	auto const next = m_ranges.find(row);
+	if (m_ranges.end() == next || m_ranges.begin() == next) {
+		return;
+	}
+	auto const prev = std::prev(next);
+	if (prev->second == row) {
+		prev->second = next->second;
+		m_ranges.erase(next);
+	}
+}
+
+void
+RowSelection::shift(
+	UI::index_type const row,
+	UI::index_type const amount
+) {
+	auto const first = m_ranges.lower_bound(row);
+	if (m_ranges.end() == first || 0 == amount) {
+		return;
+	}
+	aux::vector<std::pair<UI::index_type, UI::index_type>> moved{
+		first, m_ranges.end()
+	};
+	m_ranges.erase(first, m_ranges.end());
+	for (auto const& range : moved) {
+		m_ranges.emplace_hint(
+			m_ranges.end(),
+			range.first + amount,
+			range.second + amount
+		);
+	}
+}
+
+bool
+RowSelection::test(
+	UI::index_type const row
+) const noexcept {
+	auto it = m_ranges.upper_bound(row);
+	if (m_ranges.begin() == it) {
+		return false;
+	}
+	--it;
+	return row < it->second;
+}
+
+void
+RowSelection::assign(
+	UI::index_type begin,
+	UI::index_type end,
+	bool const value
+) {
+	begin = value_clamp(begin, 0, m_size);
+	end = value_clamp(end, begin, m_size);
+	if (begin == end) {
+		return;
+	}
+	split(begin);
+	split(end);
+	m_ranges.erase(
+		m_ranges.lower_bound(begin),
+		m_ranges.lower_bound(end)
+	);
+	if (value) {
+		m_ranges.emplace(begin, end);
+		merge(end);
+		merge(begin);
+	}
+}
+
+void
+RowSelection::toggle(
+	UI::index_type begin,
+	UI::index_type end
+) {
+	begin = value_clamp(begin, 0, m_size);
+	end = value_clamp(end, begin, m_size);
+	if (begin == end) {
+		return;
+	}
+	split(begin);
+	split(end);
+	// Selected ranges within [begin, end) become the gaps between them
+	auto const first = m_ranges.lower_bound(begin);
+	auto const last = m_ranges.lower_bound(end);
+	aux::vector<std::pair<UI::index_type, UI::index_type>> gaps;
+	UI::index_type gap_begin = begin;
+	for (auto it = first; last != it; ++it) {
+		if (gap_begin < it->first) {
+			gaps.emplace_back(gap_begin, it->first);
+		}
+		gap_begin = it->second;
+	}
+	if (gap_begin < end) {
+		gaps.emplace_back(gap_begin, end);
+	}
+	m_ranges.erase(first, last);
+	for (auto const& gap : gaps) {
+		m_ranges.emplace(gap.first, gap.second);
+	}
+	merge(end);
+	merge(begin);
+}
+
+void
+RowSelection::resize(
+	UI::index_type const size
+) {
+	if (size < m_size) {
+		assign(size, m_size, false);
+	}
+	m_size = max_ce(0, size);
+}
+
+void
+RowSelection::insert(
+	UI::index_type const row,
+	UI::index_type const count
+) {
+	if (0 >= count) {
+		return;
+	}
+	split(row);
+	shift(row, count);
+	m_size += count;
+}
+
+void
+RowSelection::erase(
+	UI::index_type const row,
+	UI::index_type const count
+) {
+	auto const erase_count = min_ce(count, m_size - row);
+	if (0 >= erase_count) {
+		return;
+	}
+	assign(row, row + erase_count, false);
+	shift(row + erase_count, -erase_count);
+	m_size -= erase_count;
+	merge(row);
+}
+
+} // namespace UI
+} // namespace Onsang
@@ -0,0 +1,170 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+
+@file
+@brief Row selection interval set.
+*/
+
+#pragma once
+
+#include <Onsang/config.hpp>
+#include <Onsang/aux.hpp>
+#include <Onsang/UI/Defs.hpp>
+
+namespace Onsang {
+namespace UI {
+
+/**
+	Set of selected rows, stored as disjoint half-open ranges.
+
+	Ranges never touch; adjacent ranges are merged. Lookups and
+	range updates are logarithmic in the number of ranges.
+	Inserting or erasing rows shifts the ranges after them.
+*/
+class RowSelection final {
+public:
+	/** Range begin to range end. */
+	using range_map_type = aux::map<UI::index_type, UI::index_type>;
+
+private:
+	range_map_type m_ranges{};
+	UI::index_type m_size{0};
+
+	/**
+		Split the range containing @a row (if any) at @a row.
+	*/
+	void
+	split(
+		UI::index_type const row
+	);
+
+	/**
+		Join the ranges ending and beginning at @a row (if any).
+	*/
+	void
+	merge(
+		UI::index_type const row
+	);
+
+	/**
+		Shift ranges that begin at or after @a row by @a amount.
+	*/
+	void
+	shift(
+		UI::index_type const row,
+		UI::index_type const amount
+	);
+
+public:
+// special member functions
+	~RowSelection() noexcept = default;
+
+	RowSelection() = default;
+	RowSelection(RowSelection const&) = default;
+	RowSelection(RowSelection&&) = default;
+	RowSelection& operator=(RowSelection const&) = default;
+	RowSelection& operator=(RowSelection&&) = default;
+
+	explicit
+	RowSelection(
+		UI::index_type const size
+	) noexcept
+		: m_size(size)
+	{}
+
+// properties
+	/**
+		Number of rows (selected or not).
+	*/
+	UI::index_type
+	size() const noexcept {
+		return m_size;
+	}
+
+	/**
+		Whether any row is selected.
+	*/
+	bool
+	any() const noexcept {
+		return !m_ranges.empty();
+	}
+
+	range_map_type const&
+	ranges() const noexcept {
+		return m_ranges;
+	}
+
+	/**
+		Whether @a row is selected.
+	*/
+	bool
+	test(
+		UI::index_type const row
+	) const noexcept;
+
+	bool
+	operator[](
+		UI::index_type const row
+	) const noexcept {
+		return test(row);
+	}
+
+// operations
+	/**
+		Select or unselect [@a begin, @a end).
+	*/
+	void
+	assign(
+		UI::index_type begin,
+		UI::index_type end,
+		bool const value
+	);
+
+	/**
+		Toggle the selection of [@a begin, @a end).
+	*/
+	void
+	toggle(
+		UI::index_type begin,
+		UI::index_type end
+	);
+
+	/**
+		Unselect all rows.
+	*/
+	void
+	reset() noexcept {
+		m_ranges.clear();
+	}
+
+	/**
+		Change the number of rows.
+
+		Rows past the new size are dropped.
+	*/
+	void
+	resize(
+		UI::index_type const size
+	);
+
+	/**
+		Insert @a count unselected rows before @a row.
+	*/
+	void
+	insert(
+		UI::index_type const row,
+		UI::index_type const count
+	);
+
+	/**
+		Erase @a count rows starting at @a row.
+	*/
+	void
+	erase(
+		UI::index_type const row,
+		UI::index_type const count
+	);
+};
+
+} // namespace UI
+} // namespace Onsang
@@ -8,6 +8,7 @@
 #include <Onsang/UI/Defs.hpp>
 #include <Onsang/UI/TabbedContainer.hpp>
 #include <Onsang/UI/ObjectView.hpp>
+#include <Onsang/UI/StatsView.hpp>
 #include <Onsang/App.hpp>
 
 #include <Hord/Object/Unit.hpp>
@@ -54,12 +55,19 @@ SessionView::add_object_view(
 		return;
 	}
 	for (auto const& tab : m_tabs) {
-		auto const object_view = std::static_pointer_cast<UI::ObjectView>(tab.widget);
+		auto const object_view = std::dynamic_pointer_cast<UI::ObjectView>(tab.widget);
 		if (object_view && object_view->m_object.id() == object->id()) {
 			return;
 		}
 	}
 	{// Ensure data props are loaded
+		System::Session::CommandScope const scope{
+			System::Session::Acquire::no_wait,
+			enum_cast(Hord::IO::PropTypeBit::data)
+		};
+		if (!scope.acquired()) {
+			return;
+		}
 		Hord::Cmd::Datastore::Load cmd{m_session};
 		if (!cmd(object_id, Hord::IO::PropTypeBit::data)) {
 			Log::acquire(Log::error)
@@ -77,5 +85,19 @@ SessionView::add_object_view(
 	App::instance.m_ui.csline->set_description(object_view->view_description());
 }
 
+void
+SessionView::add_stats_view() {
+	for (unsigned index = 0; index < m_tabs.size(); ++index) {
+		if (std::dynamic_pointer_cast<UI::StatsView>(m_tabs[index].widget)) {
+			set_sub_view(index);
+			return;
+		}
+	}
+	auto stats_view = UI::StatsView::make(root_weak(), m_session);
+	auto const index = insert(stats_view->view_title(), stats_view, static_cast<unsigned>(-1));
+	set_sub_view(index);
+	App::instance.m_ui.csline->set_description(stats_view->view_description());
+}
+
 } // namespace UI
 } // namespace Onsang
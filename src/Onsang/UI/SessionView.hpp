@@ -111,6 +111,12 @@ public:
 	update_view_title(
 		Hord::Object::ID const object_id
 	);
+
+	/**
+		Switch to the command stats view, adding it if needed.
+	*/
+	void
+	add_stats_view();
 };
 
 } // namespace UI
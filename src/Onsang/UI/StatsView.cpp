@@ -0,0 +1,376 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+*/
+
+#include <Onsang/config.hpp>
+#include <Onsang/aux.hpp>
+#include <Onsang/utility.hpp>
+#include <Onsang/System/CommandStats.hpp>
+#include <Onsang/IO/FlatDatastore.hpp>
+#include <Onsang/UI/Defs.hpp>
+#include <Onsang/UI/RowFilter.hpp>
+#include <Onsang/UI/StatsView.hpp>
+#include <Onsang/App.hpp>
+
+#include <Beard/keys.hpp>
+
+#include <Hord/IO/Defs.hpp>
+
+#include <string>
+
+namespace Onsang {
+namespace UI {
+
+namespace {
+static txt::Sequence const
+s_column_name[StatsView::NUM_COLUMNS]{
+	{"command"}, {"count"}, {"ok"}, {"no-op"}, {"error"},
+	{"p50 us"}, {"p99 us"}, {"max us"}
+},
+s_io_column_name[StatsView::NUM_IO_COLUMNS]{
+	{"datastore"}, {"count"}, {"KiB read"}, {"KiB written"},
+	{"total ms"}, {"mean us"}
+};
+
+static UI::geom_value_type const
+s_column_width []{28 + 1, 8 + 1, 8 + 1, 8 + 1, 8 + 1, 10 + 1, 10 + 1, 10},
+s_column_offset[]{0, 29, 38, 47, 56, 65, 76, 87, 97},
+s_io_column_width []{28 + 1, 8 + 1, 12 + 1, 12 + 1, 10 + 1, 10},
+s_io_column_offset[]{0, 29, 38, 51, 64, 75, 85};
+
+/** Format @a value / @a divisor with one decimal. */
+static txt::Sequence
+decimal(
+	std::uint64_t const value,
+	std::uint64_t const divisor,
+	String& scratch
+) noexcept {
+	scratch = std::to_string(value / divisor);
+	scratch.push_back('.');
+	scratch.push_back(static_cast<char>('0' + value % divisor * 10u / divisor));
+	return {scratch};
+}
+} // anonymous namespace
+
+void
+StatsView::notify_command(
+	UI::View* const /*parent_view*/,
+	Hord::Cmd::UnitBase const& /*command*/,
+	Hord::Cmd::TypeInfo const& /*type_info*/
+) noexcept {
+	if (is_visible()) {
+		refresh();
+	}
+}
+
+void
+StatsView::reflow_impl() noexcept {
+	// Commands run while hidden are shown when the tab is switched to
+	refresh();
+	base::reflow_impl();
+}
+
+bool
+StatsView::handle_event_impl(
+	UI::Event const& event
+) noexcept {
+	if (base::handle_event_impl(event)) {
+		return true;
+	} else if (event.type != UI::EventType::key_input) {
+		return false;
+	}
+	switch (event.key_input.cp) {
+	case 'r': refresh(); return true;
+	case 'd': toggle_io(); return true;
+	}
+	return false;
+}
+
+void
+StatsView::render_header(
+	UI::GridRenderData& grid_rd,
+	UI::index_type const col_begin,
+	UI::index_type const col_end,
+	Rect const& frame
+) noexcept {
+	grid_rd.rd.terminal.put_line(
+		frame.pos, frame.size.width,
+		Axis::horizontal,
+		tty::make_cell(' ',
+			tty::Color::term_default,
+			tty::Color::blue
+		)
+	);
+
+	auto const* const column_name = m_show_io ? s_io_column_name : s_column_name;
+	auto const* const column_width = m_show_io ? s_io_column_width : s_column_width;
+	auto const* const column_offset = m_show_io ? s_io_column_offset : s_column_offset;
+	auto const x_end = frame.pos.x + frame.size.width;
+	Vec2 pos = frame.pos;
+	Vec2 size = frame.size;
+	pos.x += column_offset[col_begin] - column_offset[view().col_range.x];
+	for (auto col = col_begin; col < col_end; ++col) {
+		size.width = min_ce(column_width[col], x_end - pos.x);
+		if (size.width <= 0) {
+			break;
+		}
+		grid_rd.rd.terminal.put_sequence(
+			pos.x, pos.y,
+			column_name[col],
+			size.width,
+			grid_rd.primary_fg | tty::Attr::bold,
+			tty::Color::blue
+		);
+		pos.x += size.width;
+	}
+}
+
+void
+StatsView::render_content(
+	UI::GridRenderData& grid_rd,
+	UI::index_type const row_begin,
+	UI::index_type const row_end,
+	UI::index_type const col_begin,
+	UI::index_type const col_end,
+	Rect const& frame
+) noexcept {
+	auto const* const column_width = m_show_io ? s_io_column_width : s_column_width;
+	auto const* const column_offset = m_show_io ? s_io_column_offset : s_column_offset;
+	auto const x_end = frame.pos.x + frame.size.width;
+	auto const begin_offset = column_offset[col_begin] - column_offset[view().col_range.x];
+	auto const range_width = column_offset[col_end] - column_offset[col_begin];
+	Vec2 pos = frame.pos;
+	Vec2 size = frame.size;
+	size.height = 1;
+	auto cell = tty::make_cell(' ');
+	tty::attr_type attr_bg;
+	String scratch;
+	for (UI::index_type row = row_begin; row < row_end; ++row) {
+		pos.x = frame.pos.x + begin_offset;
+		if (m_sel[row]) {
+			cell.attr_fg = grid_rd.selected_fg;
+			cell.attr_bg = grid_rd.selected_bg;
+		} else {
+			cell.attr_fg = grid_rd.content_fg;
+			cell.attr_bg = grid_rd.content_bg;
+		}
+		grid_rd.rd.terminal.put_line(pos, range_width, Axis::horizontal, cell);
+		attr_bg = cell.attr_bg;
+
+	for (UI::index_type col = col_begin; col < col_end; ++col) {
+		size.width = min_ce(column_width[col], x_end - pos.x);
+		if (size.width <= 0) {
+			break;
+		}
+		cell.attr_bg = attr_bg;
+		if (row == m_cursor.row && col == m_cursor.col && is_focused()) {
+			cell.attr_bg |= tty::Attr::inverted;
+			grid_rd.rd.terminal.put_line(pos, size.width, Axis::horizontal, cell);
+		}
+		grid_rd.rd.terminal.put_sequence(
+			pos.x, pos.y,
+			m_show_io
+			? get_io_cell_seq(content_row(row), col, scratch)
+			: get_cell_seq(content_row(row), col, scratch),
+			size.width,
+			cell.attr_fg,
+			cell.attr_bg
+		);
+		pos.x += size.width;
+	}
+		++pos.y;
+	}
+}
+
+bool
+StatsView::content_filter(
+	UI::index_type const row_begin,
+	UI::index_type row_end,
+	UI::RowFilter const& filter,
+	aux::vector<UI::index_type>& matches
+) noexcept {
+	row_end = min_ce(row_end, static_cast<UI::index_type>(
+		m_show_io ? m_io_rows.size() : m_entries.size()
+	));
+	for (auto row = row_begin; row < row_end; ++row) {
+		auto const& name
+			= m_show_io
+			? m_io_rows[static_cast<std::size_t>(row)].name
+			: m_entries[static_cast<std::size_t>(row)].name
+		;
+		if (filter.match_string(name.data(), name.size())) {
+			matches.push_back(row);
+		}
+	}
+	return false;
+}
+
+txt::Sequence
+StatsView::get_cell_seq(
+	UI::index_type row,
+	UI::index_type col,
+	String& scratch
+) noexcept {
+	using Result = System::CommandTrace::Result;
+
+	auto const& entry = m_entries[static_cast<std::size_t>(row)];
+	auto const count = [&entry](Result const result) {
+		return entry.results[enum_cast(result)];
+	};
+	switch (col) {
+	case 0:
+		return {entry.name};
+
+	case 1:
+		scratch = std::to_string(entry.count());
+		return {scratch};
+
+	case 2:
+		scratch = std::to_string(count(Result::success));
+		return {scratch};
+
+	case 3:
+		scratch = std::to_string(count(Result::success_no_action));
+		return {scratch};
+
+	case 4:
+		scratch = std::to_string(count(Result::error) + count(Result::exception));
+		return {scratch};
+	}
+	// Commands issued without a start time have no latency
+	if (0u == entry.latency.count()) {
+		return {"-"};
+	}
+	switch (col) {
+	case 5: return decimal(entry.latency.percentile(50.0), 1000u, scratch);
+	case 6: return decimal(entry.latency.percentile(99.0), 1000u, scratch);
+	case 7: return decimal(entry.latency.max(), 1000u, scratch);
+	}
+	return {};
+}
+
+txt::Sequence
+StatsView::get_io_cell_seq(
+	UI::index_type row,
+	UI::index_type col,
+	String& scratch
+) noexcept {
+	auto const& io_row = m_io_rows[static_cast<std::size_t>(row)];
+	switch (col) {
+	case 0:
+		return {io_row.name};
+
+	case 1:
+		scratch = std::to_string(io_row.count);
+		return {scratch};
+
+	case 2:
+		if (!io_row.has_bytes) {
+			return {"-"};
+		}
+		return decimal(io_row.bytes_read, 1024u, scratch);
+
+	case 3:
+		if (!io_row.has_bytes) {
+			return {"-"};
+		}
+		return decimal(io_row.bytes_written, 1024u, scratch);
+
+	case 4:
+		return decimal(io_row.time, 1000000u, scratch);
+
+	case 5:
+		if (0u == io_row.count) {
+			return {"-"};
+		}
+		return decimal(io_row.time / io_row.count, 1000u, scratch);
+	}
+	return {};
+}
+
+void
+StatsView::update_io_rows() {
+	m_io_rows.clear();
+	auto const* const flat = dynamic_cast<IO::FlatDatastore const*>(
+		&m_session.datastore()
+	);
+	if (!flat) {
+		return;
+	}
+	auto const stats = flat->io_stats();
+	for (std::size_t index = 0u; index < IO::FlatDatastore::NUM_PROP_TYPES; ++index) {
+		auto const& prop = stats.props[index];
+		String const name = Hord::IO::get_prop_type_name(
+			static_cast<Hord::IO::PropType>(index)
+		);
+		m_io_rows.push_back(
+			{"read " + name, prop.reads, true, prop.bytes_read, 0u, prop.read_time}
+		);
+		m_io_rows.push_back(
+			{"write " + name, prop.writes, true, 0u, prop.bytes_written, prop.write_time}
+		);
+	}
+	m_io_rows.push_back({
+		"open (" + std::to_string(stats.mapped_opens) + " mapped)",
+		stats.opens, false, 0u, 0u, stats.open_time
+	});
+	m_io_rows.push_back({
+		"mkdir (" + std::to_string(stats.directories_created) + " created)",
+		stats.directory_checks, false, 0u, 0u, stats.directory_time
+	});
+	m_io_rows.push_back(
+		{"journal sync", stats.syncs, false, 0u, 0u, stats.sync_time}
+	);
+}
+
+void
+StatsView::refresh() {
+	if (m_show_io) {
+		auto const num_rows = m_io_rows.size();
+		update_io_rows();
+		if (m_io_rows.size() != num_rows) {
+			resize_grid(NUM_IO_COLUMNS, static_cast<UI::index_type>(m_io_rows.size()));
+		} else {
+			queue_cell_render(0, row_count());
+			enqueue_actions(
+				ui::UpdateActions::render |
+				ui::UpdateActions::flag_noclear
+			);
+		}
+		return;
+	}
+	auto const& stats = m_session.command_stats();
+	if (stats.revision() == m_revision) {
+		return;
+	}
+	auto const num_entries = m_entries.size();
+	stats.snapshot(m_entries, m_revision);
+	if (m_entries.size() != num_entries) {
+		auto const col = m_cursor.col;
+		auto const row = m_cursor.row;
+		resize_grid(NUM_COLUMNS, static_cast<UI::index_type>(m_entries.size()));
+		set_cursor(col, row);
+	} else {
+		queue_cell_render(0, row_count());
+		enqueue_actions(
+			ui::UpdateActions::render |
+			ui::UpdateActions::flag_noclear
+		);
+	}
+}
+
+void
+StatsView::toggle_io() {
+	m_show_io = !m_show_io;
+	if (m_show_io) {
+		update_io_rows();
+		resize_grid(NUM_IO_COLUMNS, static_cast<UI::index_type>(m_io_rows.size()));
+	} else {
+		m_session.command_stats().snapshot(m_entries, m_revision);
+		resize_grid(NUM_COLUMNS, static_cast<UI::index_type>(m_entries.size()));
+	}
+	App::instance.m_ui.csline->set_description(view_description());
+}
+
+} // namespace UI
+} // namespace Onsang
@@ -0,0 +1,270 @@
+/**
+@copyright MIT license; see @ref index or the accompanying LICENSE file.
+
+@file
+@brief Command statistics view widget.
+*/
+
+#pragma once
+
+#include <Onsang/config.hpp>
+#include <Onsang/aux.hpp>
+#include <Onsang/String.hpp>
+#include <Onsang/utility.hpp>
+#include <Onsang/System/Session.hpp>
+#include <Onsang/System/CommandStats.hpp>
+#include <Onsang/UI/Defs.hpp>
+#include <Onsang/UI/BasicGrid.hpp>
+#include <Onsang/UI/RowFilter.hpp>
+#include <Onsang/UI/View.hpp>
+
+#include <Beard/txt/Defs.hpp>
+#include <Beard/ui/Root.hpp>
+
+#include <cstdint>
+
+namespace Onsang {
+namespace UI {
+
+/**
+	Command counts and latency percentiles of a session.
+
+	Rows are System::CommandStats entries, or datastore I/O
+	counters (see IO::FlatDatastore::io_stats()) after @c d is
+	pressed. The view is refreshed when a command is notified,
+	when it is shown, and with @c r.
+*/
+class StatsView
+	: public UI::BasicGrid
+	, public UI::View
+{
+public:
+	using SPtr = aux::shared_ptr<UI::StatsView>;
+
+	enum : unsigned {
+		NUM_COLUMNS = 8,
+		NUM_IO_COLUMNS = 6,
+	};
+
+	/** Datastore I/O row. */
+	struct IORow {
+		String name;
+		std::uint64_t count;
+		/** Whether the byte columns apply. */
+		bool has_bytes;
+		std::uint64_t bytes_read;
+		std::uint64_t bytes_written;
+		/** Nanoseconds. */
+		std::uint64_t time;
+	};
+
+private:
+	using base = UI::BasicGrid;
+	enum class ctor_priv {};
+
+public:
+	System::Session& m_session;
+
+private:
+	/** Statistics revision shown. */
+	std::uint64_t m_revision{~std::uint64_t{0u}};
+	/**
+		Entries shown.
+
+		Copied from the session's statistics, which commands on
+		other threads update.
+	*/
+	aux::vector<System::CommandStats::Entry> m_entries{};
+	/** Whether datastore I/O is shown instead of commands. */
+	bool m_show_io{false};
+	aux::vector<IORow> m_io_rows{};
+
+// UI::Widget::Base implementation
+	void
+	reflow_impl() noexcept override;
+
+	bool
+	handle_event_impl(
+		UI::Event const& event
+	) noexcept override;
+
+// UI::ProtoGrid implementation
+	void
+	render_header(
+		UI::GridRenderData& grid_rd,
+		UI::index_type const col_begin,
+		UI::index_type const col_end,
+		Rect const& frame
+	) noexcept override;
+
+	void
+	render_content(
+		UI::GridRenderData& grid_rd,
+		UI::index_type const row_begin,
+		UI::index_type const row_end,
+		UI::index_type const col_begin,
+		UI::index_type const col_end,
+		Rect const& frame
+	) noexcept override;
+
+// BasicGrid implementation
+	bool
+	content_insert(
+		UI::index_type /*row*/
+	) noexcept override {
+		return false;
+	}
+
+	bool
+	content_erase(
+		UI::index_type /*row*/
+	) noexcept override {
+		return false;
+	}
+
+	bool
+	content_filter(
+		UI::index_type row_begin,
+		UI::index_type row_end,
+		UI::RowFilter const& filter,
+		aux::vector<UI::index_type>& matches
+	) noexcept override;
+
+// -
+	txt::Sequence
+	get_cell_seq(
+		UI::index_type row,
+		UI::index_type col,
+		String& scratch
+	) noexcept;
+
+	txt::Sequence
+	get_io_cell_seq(
+		UI::index_type row,
+		UI::index_type col,
+		String& scratch
+	) noexcept;
+
+	void
+	update_io_rows();
+
+public:
+// UI::View implementation
+	String
+	view_title() noexcept override {
+		return "stats";
+	}
+
+	String
+	view_description() noexcept override {
+		return
+			(m_show_io ? "datastore stats: " : "command stats: ") +
+			m_session.name()
+		;
+	}
+
+	unsigned
+	sub_view_index() noexcept override {
+		return 0;
+	}
+
+	UI::View::SPtr
+	sub_view() noexcept override {
+		return UI::View::SPtr{};
+	}
+
+	void
+	set_sub_view_impl(
+		unsigned const /*index*/
+	) noexcept override {}
+
+	unsigned
+	num_sub_views() noexcept override {
+		return 0;
+	}
+
+	using UI::View::close_sub_view;
+	void
+	close_sub_view(
+		unsigned /*index*/
+	) noexcept override {}
+
+	void
+	sub_view_title_changed(
+		unsigned /*index*/
+	) noexcept override {}
+
+	void
+	notify_command(
+		UI::View* parent_view,
+		Hord::Cmd::UnitBase const& command,
+		Hord::Cmd::TypeInfo const& type_info
+	) noexcept override;
+
+private:
+	StatsView() noexcept = delete;
+	StatsView(StatsView const&) = delete;
+	StatsView& operator=(StatsView const&) = delete;
+
+public:
+// special member functions
+	~StatsView() noexcept override = default;
+
+	StatsView(
+		ctor_priv const,
+		UI::RootWPtr root,
+		UI::Widget::WPtr&& parent,
+		System::Session& session
+	) noexcept
+		: base(
+			static_cast<UI::Widget::Type>(UI::OnsangWidgetType::StatsView),
+			(
+				UI::Widget::Flags::trait_focusable |
+				UI::Widget::Flags::visible
+			),
+			UI::group_null,
+			{{0, 0}, true, UI::Axis::both, UI::Axis::both},
+			std::move(root),
+			std::move(parent),
+			NUM_COLUMNS,
+			0
+		)
+		, UI::View()
+		, m_session(session)
+	{}
+
+	StatsView(StatsView&&) = default;
+	StatsView& operator=(StatsView&&) = default;
+
+	static UI::StatsView::SPtr
+	make(
+		UI::RootWPtr root,
+		System::Session& session,
+		UI::Widget::WPtr parent = UI::Widget::WPtr()
+	) {
+		auto widget = aux::make_shared<UI::StatsView>(
+			ctor_priv{},
+			std::move(root),
+			std::move(parent),
+			session
+		);
+		widget->refresh();
+		return widget;
+	}
+
+// operations
+	/**
+		Show the current statistics.
+	*/
+	void
+	refresh();
+
+	/**
+		Switch between command and datastore statistics.
+	*/
+	void
+	toggle_io();
+};
+
+} // namespace UI
+} // namespace Onsang
@@ -5,10 +5,17 @@
 #include <Onsang/config.hpp>
 #include <Onsang/aux.hpp>
 #include <Onsang/utility.hpp>
+#include <Onsang/Log.hpp>
 #include <Onsang/System/Session.hpp>
+#include <Onsang/System/ColumnIndex.hpp>
+#include <Onsang/System/ColumnStats.hpp>
+#include <Onsang/System/TableImport.hpp>
+#include <Onsang/System/TableExport.hpp>
+#include <Onsang/System/ValueText.hpp>
 #include <Onsang/UI/Defs.hpp>
 #include <Onsang/UI/TableGrid.hpp>
 #include <Onsang/UI/ObjectView.hpp>
+#include <Onsang/App.hpp>
 
 #include <Beard/keys.hpp>
 #include <Beard/txt/Defs.hpp>
@@ -16,6 +23,7 @@
 #include <Hord/Data/Defs.hpp>
 #include <Hord/Data/ValueRef.hpp>
 #include <Hord/Data/Table.hpp>
+#include <Hord/Data/Metadata.hpp>
 #include <Hord/Data/Ops.hpp>
 #include <Hord/Object/Defs.hpp>
 #include <Hord/Object/Ops.hpp>
@@ -23,14 +31,447 @@
 
 #include <duct/IO/memstream.hpp>
 
+#include <atomic>
+#include <thread>
+#include <cstdint>
 #include <cstdlib>
+#include <numeric>
 #include <algorithm>
 #include <string>
+#include <system_error>
 
 namespace Onsang {
 namespace UI {
 
-#define GRID_TMP_COLUMN_WIDTH 25
+TableGrid::RenderCounters TableGrid::s_render_counters{0u, 0u};
+
+namespace {
+
+enum : std::uint8_t {
+	sort_rank_null = 0u,
+	sort_rank_number,
+	sort_rank_string,
+	sort_rank_object_id,
+	sort_rank_other,
+};
+
+enum : std::size_t {
+	/** Below this many rows, sort on one thread. */
+	SORT_PARALLEL_MIN = 1u << 15,
+	SORT_MAX_THREADS = 16u,
+	/** Records keyed per poll of a sort job. */
+	SORT_KEY_CHUNK = 1u << 16,
+};
+
+struct SortKey {
+	std::uint8_t rank;
+	bool is_integer;
+	union {
+		std::int64_t integer;
+		double decimal;
+		/** Index into the job's string pool. */
+		std::uint32_t string;
+	};
+};
+
+static signed
+compare_keys(
+	SortKey const& x,
+	SortKey const& y,
+	aux::vector<String> const& strings
+) noexcept {
+	if (x.rank != y.rank) {
+		return x.rank < y.rank ? -1 : 1;
+	}
+	switch (x.rank) {
+	case sort_rank_number:
+		if (x.is_integer && y.is_integer) {
+			return
+				x.integer < y.integer ? -1 :
+				y.integer < x.integer ?  1 : 0
+			;
+		} else {
+			long double const a
+				= x.is_integer
+				? static_cast<long double>(x.integer)
+				: static_cast<long double>(x.decimal)
+			;
+			long double const b
+				= y.is_integer
+				? static_cast<long double>(y.integer)
+				: static_cast<long double>(y.decimal)
+			;
+			return a < b ? -1 : b < a ? 1 : 0;
+		}
+
+	case sort_rank_string:
+	case sort_rank_object_id:
+		return strings[x.string].compare(strings[y.string]);
+
+	default:
+		return 0;
+	}
+}
+
+} // anonymous namespace
+
+class TableGrid::SortJob final
+	: public System::Job
+{
+public:
+	TableGrid& m_grid;
+	UI::index_type const m_col;
+	bool const m_descending;
+	unsigned const m_generation;
+	aux::vector<SortKey> m_keys{};
+	aux::vector<String> m_strings{};
+	aux::vector<UI::index_type> m_perm{};
+
+private:
+	/** Thrown by comparisons once the job is canceled. */
+	struct Canceled {};
+
+	/** Number of records with a key. */
+	std::size_t m_num_keyed{0u};
+	/** Object ID to its path in m_strings. */
+	aux::unordered_map<Hord::Object::IDValue, std::uint32_t> m_paths{};
+	std::thread m_worker{};
+	std::atomic<bool> m_cancel{false};
+	std::atomic<bool> m_done{false};
+
+// System::Job implementation
+	bool
+	poll_impl() override {
+		if (m_cancel.load()) {
+			return true;
+		} else if (!m_worker.joinable()) {
+			return take_keys();
+		} else if (!m_done.load()) {
+			return false;
+		}
+		m_worker.join();
+		m_grid.apply_sort(*this);
+		return true;
+	}
+
+	bool
+	less(
+		UI::index_type const a,
+		UI::index_type const b
+	) const {
+		if (m_cancel.load(std::memory_order_relaxed)) {
+			throw Canceled{};
+		}
+		auto const c = compare_keys(
+			m_keys[static_cast<std::size_t>(a)],
+			m_keys[static_cast<std::size_t>(b)],
+			m_strings
+		);
+		return m_descending ? 0 < c : 0 > c;
+	}
+
+	/**
+		Take the keys of up to SORT_KEY_CHUNK records, then start
+		the worker once every record has a key.
+
+		@returns Whether the job is finished.
+	*/
+	bool
+	take_keys();
+
+	void
+	run() noexcept;
+
+	/**
+		Sort [@a begin, @a end) of m_perm.
+
+		@returns @c false if the job was canceled.
+	*/
+	bool
+	sort_part(
+		std::size_t const begin,
+		std::size_t const end
+	) noexcept;
+
+	/**
+		Merge the sorted ranges [@a begin, @a middle) and
+		[@a middle, @a end) of m_perm.
+
+		@returns @c false if the job was canceled.
+	*/
+	bool
+	merge_parts(
+		std::size_t const begin,
+		std::size_t const middle,
+		std::size_t const end
+	) noexcept;
+
+public:
+	/**
+		Cancel the job and wait for the worker.
+
+		A canceled worker stops at its next comparison.
+	*/
+	~SortJob() noexcept override {
+		cancel();
+		if (m_worker.joinable()) {
+			m_worker.join();
+		}
+	}
+
+	SortJob(
+		TableGrid& grid,
+		UI::index_type const col,
+		bool const descending,
+		unsigned const generation,
+		std::size_t const num_records
+	)
+		: m_grid(grid)
+		, m_col(col)
+		, m_descending(descending)
+		, m_generation(generation)
+		, m_keys(num_records)
+		, m_perm(num_records)
+	{}
+
+	/**
+		Stop the job.
+
+		The worker gives up at its next comparison and the result
+		is never applied.
+	*/
+	void
+	cancel() noexcept {
+		m_cancel.store(true);
+	}
+};
+
+class TableGrid::StatsJob final
+	: public System::Job
+{
+public:
+	enum : std::size_t {
+		/** Records aggregated per poll. */
+		CHUNK_ROWS = 65536u,
+	};
+
+	TableGrid& m_grid;
+	unsigned const m_generation;
+	System::ColumnStats::Builder m_builder;
+
+private:
+// System::Job implementation
+	bool
+	poll_impl() override {
+		if (m_grid.m_stats_job.get() != this) {
+			// Superseded
+			return true;
+		} else if (m_generation == m_grid.m_records_generation) {
+			try {
+				if (!m_builder.step(m_grid.m_table, CHUNK_ROWS)) {
+					// Input is still handled between chunks
+					App::instance.m_events.arm_timer(0u);
+					return false;
+				}
+			} catch (...) {
+				m_grid.m_stats_job.reset();
+				App::instance.m_ui.csline->set_error("failed to aggregate column");
+				throw;
+			}
+		}
+		m_grid.apply_column_stats(*this);
+		return true;
+	}
+
+public:
+	~StatsJob() noexcept override = default;
+
+	StatsJob(
+		TableGrid& grid,
+		UI::index_type const col
+	)
+		: m_grid(grid)
+		, m_generation(grid.m_records_generation)
+		, m_builder(grid.m_table, col)
+	{}
+};
+
+bool
+TableGrid::SortJob::take_keys() {
+	// Hord tables are not thread-safe, so keys are taken on the UI
+	// thread in slices; the worker only touches the job
+	auto const num_records = m_keys.size();
+	auto const end = min_ce(num_records, m_num_keyed + SORT_KEY_CHUNK);
+	auto it = m_grid.row_iterator(static_cast<UI::index_type>(m_num_keyed));
+	for (; m_num_keyed < end; ++m_num_keyed, ++it) {
+		auto const value = it.get_field(m_col);
+		auto& key = m_keys[m_num_keyed];
+		key.is_integer = false;
+		key.integer = 0;
+		switch (value.type.type()) {
+		case Hord::Data::ValueType::null:
+			key.rank = sort_rank_null;
+			break;
+
+		case Hord::Data::ValueType::integer:
+			key.rank = sort_rank_number;
+			key.is_integer = true;
+			key.integer = value.data.integer;
+			break;
+
+		case Hord::Data::ValueType::decimal:
+			key.rank = sort_rank_number;
+			key.decimal = value.data.decimal;
+			break;
+
+		case Hord::Data::ValueType::string:
+			key.rank = sort_rank_string;
+			key.string = static_cast<std::uint32_t>(m_strings.size());
+			m_strings.emplace_back(value.data.string, value.size);
+			break;
+
+		case Hord::Data::ValueType::object_id: {
+			// Records tend to share a few objects; resolve each once
+			auto const id_value = Hord::Object::ID{value.data.object_id}.value();
+			auto const path = m_paths.emplace(
+				id_value, static_cast<std::uint32_t>(m_strings.size())
+			);
+			if (path.second) {
+				m_strings.emplace_back(m_grid.m_session.path_to(value.data.object_id));
+			}
+			key.rank = sort_rank_object_id;
+			key.string = path.first->second;
+		}	break;
+
+		default:
+			key.rank = sort_rank_other;
+			break;
+		}
+	}
+	if (m_num_keyed < num_records) {
+		App::instance.m_events.wake();
+		return false;
+	}
+	aux::unordered_map<Hord::Object::IDValue, std::uint32_t>{}.swap(m_paths);
+	try {
+		// Joined by poll() or the destructor, so the worker never
+		// outlives the grid (or the event loop it wakes)
+		m_worker = std::thread(&SortJob::run, this);
+	} catch (std::system_error const&) {
+		m_grid.sort_failed(*this);
+		return true;
+	}
+	return false;
+}
+
+bool
+TableGrid::SortJob::sort_part(
+	std::size_t const begin,
+	std::size_t const end
+) noexcept {
+	auto const compare = [this](
+		UI::index_type const a,
+		UI::index_type const b
+	) -> bool {
+		return less(a, b);
+	};
+	try {
+		std::stable_sort(m_perm.begin() + begin, m_perm.begin() + end, compare);
+		return true;
+	} catch (Canceled const&) {
+		// The permutation is left in some order; it is never applied
+		return false;
+	}
+}
+
+bool
+TableGrid::SortJob::merge_parts(
+	std::size_t const begin,
+	std::size_t const middle,
+	std::size_t const end
+) noexcept {
+	auto const compare = [this](
+		UI::index_type const a,
+		UI::index_type const b
+	) -> bool {
+		return less(a, b);
+	};
+	try {
+		std::inplace_merge(
+			m_perm.begin() + begin,
+			m_perm.begin() + middle,
+			m_perm.begin() + end,
+			compare
+		);
+		return true;
+	} catch (Canceled const&) {
+		return false;
+	}
+}
+
+void
+TableGrid::SortJob::run() noexcept {
+	auto const n = m_perm.size();
+	std::iota(m_perm.begin(), m_perm.end(), 0);
+
+	// Stable sort in parts, then merge pairs of parts until one
+	// remains. Both steps run a thread per part (or pair).
+	std::size_t num_parts = 1u;
+	if (SORT_PARALLEL_MIN <= n) {
+		num_parts = min_ce(
+			max_ce(std::size_t{1u}, std::size_t{std::thread::hardware_concurrency()}),
+			std::size_t{SORT_MAX_THREADS}
+		);
+	}
+	aux::vector<std::thread> workers;
+	try {
+		aux::vector<std::size_t> bounds(num_parts + 1u);
+		for (std::size_t index = 0u; index <= num_parts; ++index) {
+			bounds[index] = index * n / num_parts;
+		}
+		for (std::size_t index = 1u; index < num_parts; ++index) {
+			workers.emplace_back([this, &bounds, index]() {
+				sort_part(bounds[index], bounds[index + 1u]);
+			});
+		}
+		sort_part(bounds[0u], bounds[1u]);
+		for (auto& worker : workers) {
+			worker.join();
+		}
+		workers.clear();
+		while (2u < bounds.size() && !m_cancel.load()) {
+			aux::vector<std::size_t> merged;
+			for (std::size_t index = 0u; index + 2u < bounds.size(); index += 2u) {
+				workers.emplace_back([this, &bounds, index]() {
+					merge_parts(
+						bounds[index], bounds[index + 1u], bounds[index + 2u]
+					);
+				});
+			}
+			for (auto& worker : workers) {
+				worker.join();
+			}
+			workers.clear();
+			for (std::size_t index = 0u; index < bounds.size(); index += 2u) {
+				merged.push_back(bounds[index]);
+			}
+			if (merged.back() != bounds.back()) {
+				merged.push_back(bounds.back());
+			}
+			bounds = std::move(merged);
+		}
+	} catch (...) {
+		// Could not start a thread (or allocate); finish serially
+		for (auto& worker : workers) {
+			if (worker.joinable()) {
+				worker.join();
+			}
+		}
+		sort_part(0u, n);
+	}
+	m_done.store(true);
+	App::instance.m_events.wake();
+}
 
 void
 TableGrid::set_input_control_impl(
@@ -44,6 +485,8 @@ TableGrid::set_input_control_impl(
 			m_cursor.row, m_cursor.row + 1,
 			m_cursor.col, m_cursor.col + 1
 		);
+		// The search field covers the header
+		queue_header_render();
 	}
 	m_field.input_control_changed(*this);
 	enqueue_actions(
@@ -58,6 +501,14 @@ TableGrid::reflow_impl() noexcept {
 	if (has_input_control()) {
 		reflow_field();
 	}
+	// One slot per visible row (plus one for partial scrolls)
+	auto const cache_size = static_cast<std::size_t>(
+		max_ce(0, view().fit_count) + 1
+	);
+	if (m_cell_cache.size() != cache_size) {
+		m_cell_cache.resize(cache_size);
+		invalidate_cell_cache();
+	}
 }
 
 bool
@@ -70,15 +521,46 @@ TableGrid::handle_event_impl(
 		return false;
 	}
 	if (!has_input_control()) {
+		// base takes h, j, k, l, a, A and s; views filter others
+		switch (event.key_input.cp) {
+		case 'o': sort(m_cursor.col, false); return true;
+		case 'O': sort(m_cursor.col, true); return true;
+		case 'u': clear_sort(); return true;
+		case '/': begin_search(-1, Prompt::filter); return true;
+		case '=': begin_search(m_cursor.col, Prompt::filter); return true;
+		case 'g': begin_search(m_cursor.col, Prompt::jump); return true;
+		case 'I': begin_search(-1, Prompt::import_path); return true;
+		case 'w': begin_search(-1, Prompt::export_path); return true;
+		case 'v':
+			try {
+				show_column_stats();
+			} catch (...) {
+				App::instance.m_ui.csline->set_error("failed to aggregate column");
+				Log::report_error_ptr(std::current_exception());
+			}
+			return true;
+
+		case 'X':
+			try {
+				toggle_column_index();
+			} catch (...) {
+				App::instance.m_ui.csline->set_error("failed to index column");
+				Log::report_error_ptr(std::current_exception());
+			}
+			return true;
+		default: break;
+		}
 		if (
 			event.key_input.code != KeyCode::enter &&
 			event.key_input.cp != ' ' &&
 			event.key_input.cp != '*'
 		) {
 			return false;
+		} else if (0 >= row_count()) {
+			return true;
 		}
 		auto const& column = m_table.schema().column(m_cursor.col);
-		auto const value = m_table.iterator_at(m_cursor.row).get_field(m_cursor.col);
+		auto const value = row_iterator(record_index(m_cursor.row)).get_field(m_cursor.col);
 		// TODO: object_id handling (translate to/from path)
 		// TODO: Size limit for string
 		if (
@@ -96,7 +578,7 @@ TableGrid::handle_event_impl(
 
 		case Hord::Data::ValueType::object_id:
 			m_field.m_cursor.assign(
-				Hord::Object::path_to(value.data.object_id, m_session.datastore())
+				m_session.path_to(value.data.object_id)
 			);
 			break;
 
@@ -119,6 +601,8 @@ TableGrid::handle_event_impl(
 		}
 		set_input_control(true);
 		return true;
+	} else if (m_searching) {
+		return search_input(event.key_input);
 	} else if (event.key_input.code == KeyCode::enter) {
 		// TODO: Use callback instead
 		String string_value;
@@ -150,9 +634,7 @@ TableGrid::handle_event_impl(
 				break;
 
 			case Hord::Data::ValueType::object_id: {
-				auto* object = m_session.datastore().find_ptr_path(
-					string_value
-				);
+				auto* object = m_session.find_ptr_path(string_value);
 				new_value = object ? object->id() : Hord::Object::ID_NULL;
 			}	break;
 
@@ -163,10 +645,26 @@ TableGrid::handle_event_impl(
 			default: break;
 			}
 		}
-		auto it = m_table.iterator_at(m_cursor.row);
+		auto const row = record_index(m_cursor.row);
+		auto it = row_iterator(row);
 		auto const old_value = it.get_field(m_cursor.col);
 		if (old_value != new_value) {
-			signal_cell_edited(it, m_cursor.col, string_value, new_value);
+			// notify_cell_changed() only sees the new value
+			if (EDITED_CELLS_MAX <= m_edited_cells.size()) {
+				m_edited_cells.erase(m_edited_cells.begin());
+			}
+			auto const col = m_cursor.col;
+			m_edited_cells.push_back({row, col, value_width(old_value)});
+			signal_cell_edited(it, col, string_value, new_value);
+			// notify_cell_changed() takes the entry if the edit
+			// went through; otherwise the cell kept its old value
+			if (
+				!m_edited_cells.empty() &&
+				m_edited_cells.back().row == row &&
+				m_edited_cells.back().col == col
+			) {
+				m_edited_cells.pop_back();
+			}
 		}
 		m_field.m_cursor.clear();
 		set_input_control(false);
@@ -238,8 +736,9 @@ TableGrid::render_header(
 		)
 	);
 
+	ensure_column_widths();
 	Rect cell_frame = frame;
-	cell_frame.pos.x += col_begin * GRID_TMP_COLUMN_WIDTH;
+	cell_frame.pos.x += column_x(col_begin);
 	tty::Cell type_prefix = tty::make_cell(
 		' ',
 		tty::Color::green | tty::Attr::bold,
@@ -247,8 +746,9 @@ TableGrid::render_header(
 	);
 	for (auto col = col_begin; col < col_end; ++col) {
 		auto const& table_column = m_table.schema().column(col);
+		auto const width = column_width(col);
 		cell_frame.size.width = min_ce(
-			GRID_TMP_COLUMN_WIDTH,
+			width,
 			frame.pos.x + frame.size.width - cell_frame.pos.x
 		);
 		if (0 >= cell_frame.size.width) {
@@ -256,7 +756,10 @@ TableGrid::render_header(
 		}
 		type_prefix.u8block = s_type_prefix[enum_cast(table_column.type.type())];
 		grid_rd.rd.terminal.put_cell(cell_frame.pos.x + 0, cell_frame.pos.y, type_prefix);
-		type_prefix.u8block = ':';
+		type_prefix.u8block
+			= col != m_sort_col ? ':'
+			: m_sort_descending ? 'v' : '^'
+		;
 		grid_rd.rd.terminal.put_cell(cell_frame.pos.x + 1, cell_frame.pos.y, type_prefix);
 		grid_rd.rd.terminal.put_sequence(
 			cell_frame.pos.x + 2,
@@ -266,7 +769,7 @@ TableGrid::render_header(
 			grid_rd.primary_fg | tty::Attr::bold,
 			tty::Color::blue
 		);
-		if (GRID_TMP_COLUMN_WIDTH > cell_frame.size.width) {
+		if (width > cell_frame.size.width) {
 			break;
 		}
 		cell_frame.pos.x += cell_frame.size.width;
@@ -296,16 +799,29 @@ TableGrid::render_content(
 		frame.size.width, frame.size.height
 	);*/
 
+	++s_render_counters.calls;
+	ensure_column_widths();
+	if (
+		is_sorted() &&
+		m_row_map.size() != static_cast<std::size_t>(m_table.num_records())
+	) {
+		// Records changed without notice
+		m_row_map.clear();
+		m_sort_col = -1;
+	}
+	if (row_begin >= row_end) {
+		return;
+	}
 	Rect cell_frame = frame;
 	cell_frame.size.height = 1;
-	String scratch;
 	char value_buffer[48];
 	duct::IO::omemstream format_stream{value_buffer, sizeof(value_buffer)};
 	auto cell = tty::make_cell(' ');
 	tty::attr_type attr_fg;
 	txt::Sequence seq{};
 	Hord::Data::ValueRef value{};
-	Hord::Data::Table::Iterator it_table = m_table.iterator_at(row_begin);
+	Hord::Data::ValueType value_type;
+	Hord::Data::Table::Iterator it_table = row_iterator(record_index(row_begin));
 	for (UI::index_type row = row_begin; row < row_end; ++row) {
 		if (m_sel[row]) {
 			attr_fg = grid_rd.selected_fg;
@@ -314,7 +830,7 @@ TableGrid::render_content(
 			attr_fg = grid_rd.content_fg;
 			cell.attr_bg = grid_rd.content_bg;
 		}
-		cell_frame.pos.x = frame.pos.x + (col_begin - view().col_range.x) * GRID_TMP_COLUMN_WIDTH;
+		cell_frame.pos.x = frame.pos.x + column_x(col_begin);
 
 	for (UI::index_type col = col_begin; col < col_end; ++col) {
 		if (row == m_cursor.row && col == m_cursor.col && is_focused()) {
@@ -322,30 +838,44 @@ TableGrid::render_content(
 		} else {
 			cell.attr_bg &= ~tty::Attr::inverted;
 		}
+		auto const width = column_width(col);
 		cell_frame.size.width = min_ce(
-			GRID_TMP_COLUMN_WIDTH,
+			width,
 			frame.pos.x + frame.size.width - cell_frame.pos.x
 		);
 		if (0 >= cell_frame.size.width) {
 			break;
 		}
+		++s_render_counters.cells;
 
-		value = it_table.get_field(col);
+		auto& cached = cached_cell(row, col);
+		if (cached.valid) {
+			value_type = cached.type;
+			seq = {cached.text};
+		} else {
+			value = it_table.get_field(col);
+			value_type = value.type.type();
+			if (value_type == Hord::Data::ValueType::object_id) {
+				seq = {m_session.path_to(value.data.object_id)};
+			} else if (value_type == Hord::Data::ValueType::string) {
+				seq = {value.data.string, value.size};
+			} else {
+				format_stream.seekp(0);
+				format_stream << value;
+				cached.text.assign(
+					value_buffer,
+					static_cast<std::size_t>(format_stream.tellp())
+				);
+				cached.type = value_type;
+				cached.valid = true;
+				seq = {cached.text};
+			}
+		}
 		cell.attr_fg
-			= value.type.type() == Hord::Data::ValueType::null
+			= value_type == Hord::Data::ValueType::null
 			? tty::Color::red
 			: attr_fg
 		;
-		if (value.type.type() == Hord::Data::ValueType::object_id) {
-			scratch = Hord::Object::path_to(value.data.object_id, m_session.datastore());
-			seq = {scratch};
-		} else if (value.type.type() == Hord::Data::ValueType::string) {
-			seq = {value.data.string, value.size};
-		} else {
-			format_stream.seekp(0);
-			format_stream << value;
-			seq = {value_buffer, static_cast<std::size_t>(format_stream.tellp())};
-		}
 		grid_rd.rd.terminal.put_line(
 			cell_frame.pos,
 			cell_frame.size.width,
@@ -359,13 +889,17 @@ TableGrid::render_content(
 			cell_frame.size.width,
 			cell.attr_fg, cell.attr_bg
 		);
-		if (GRID_TMP_COLUMN_WIDTH > cell_frame.size.width) {
+		if (width > cell_frame.size.width) {
 			break;
 		}
 		cell_frame.pos.x += cell_frame.size.width;
 	}
 		++cell_frame.pos.y;
-		++it_table;
+		if (!is_mapped()) {
+			++it_table;
+		} else if (row + 1 < row_end) {
+			it_table = row_iterator(record_index(row + 1));
+		}
 	}
 }
 
@@ -373,6 +907,8 @@ bool
 TableGrid::content_insert(
 	UI::index_type /*row*/
 ) noexcept {
+	// Rows after the insertion point shift
+	records_changed();
 	return true;
 }
 
@@ -384,20 +920,525 @@ TableGrid::content_erase(
 		m_field.m_cursor.clear();
 		set_input_control(false);
 	}
+	records_changed();
+	return true;
+}
+
+bool
+TableGrid::content_insert_span(
+	UI::index_type /*row*/,
+	UI::index_type /*count*/
+) noexcept {
+	records_changed();
+	return true;
+}
+
+bool
+TableGrid::content_erase_span(
+	UI::index_type const row,
+	UI::index_type const count
+) noexcept {
+	if (
+		has_input_control() &&
+		value_in_bounds(m_cursor.row, row, row + count)
+	) {
+		m_field.m_cursor.clear();
+		set_input_control(false);
+	}
+	records_changed();
+	return true;
+}
+
+bool
+TableGrid::content_filter(
+	UI::index_type const row_begin,
+	UI::index_type row_end,
+	UI::RowFilter const& filter,
+	aux::vector<UI::index_type>& matches
+) noexcept {
+	if (0 == row_begin && 0 <= filter.column()) {
+		try {
+			if (index_filter(filter, matches)) {
+				return true;
+			}
+		} catch (...) {
+			// Fall back to scanning
+			matches.clear();
+		}
+	}
+	row_end = min_ce(row_end, static_cast<UI::index_type>(m_table.num_records()));
+	if (row_begin >= row_end) {
+		return false;
+	}
+	if (!is_sorted()) {
+		auto it = row_iterator(row_begin);
+		for (auto row = row_begin; row < row_end; ++row, ++it) {
+			if (record_matches(it, filter)) {
+				matches.push_back(row);
+			}
+		}
+		return false;
+	}
+
+	// Scan the chunk as records in table order and map matches to
+	// display rows, rather than seeking to each sorted row
+	try {
+		if (0 == row_begin || m_sorted_rows.size() != m_row_map.size()) {
+			build_sorted_rows();
+		}
+	} catch (...) {
+		return false;
+	}
+	auto const base_size = matches.size();
+	auto it = row_iterator(row_begin);
+	for (auto record = row_begin; record < row_end; ++record, ++it) {
+		if (record_matches(it, filter)) {
+			matches.push_back(m_sorted_rows[static_cast<std::size_t>(record)]);
+		}
+	}
+	auto const middle = matches.begin() + static_cast<std::ptrdiff_t>(base_size);
+	std::sort(middle, matches.end());
+	if (matches.begin() != middle && middle != matches.end() && *middle < *(middle - 1)) {
+		std::inplace_merge(matches.begin(), middle, matches.end());
+		// Rows already shown have moved down
+		invalidate_cell_cache();
+		queue_cell_render(0, row_count());
+	}
+	if (row_end >= static_cast<UI::index_type>(m_row_map.size())) {
+		aux::vector<UI::index_type>{}.swap(m_sorted_rows);
+	}
+	return false;
+}
+
+bool
+TableGrid::index_filter(
+	UI::RowFilter const& filter,
+	aux::vector<UI::index_type>& matches
+) {
+	auto* const index = m_session.column_index(m_object, m_table, filter.column());
+	System::ColumnIndex::record_vector_type records;
+	if (!index || !index->collect(filter, records)) {
+		return false;
+	}
+	auto const base_size = matches.size();
+	if (!is_sorted()) {
+		for (auto const record : records) {
+			matches.push_back(static_cast<UI::index_type>(record));
+		}
+	} else {
+		build_sorted_rows();
+		for (auto const record : records) {
+			matches.push_back(m_sorted_rows[record]);
+		}
+		aux::vector<UI::index_type>{}.swap(m_sorted_rows);
+		std::sort(matches.begin() + static_cast<std::ptrdiff_t>(base_size), matches.end());
+	}
+	return true;
+}
+
+void
+TableGrid::build_sorted_rows() {
+	m_sorted_rows.resize(m_row_map.size());
+	for (std::size_t row = 0u; row < m_row_map.size(); ++row) {
+		m_sorted_rows[static_cast<std::size_t>(m_row_map[row])]
+			= static_cast<UI::index_type>(row)
+		;
+	}
+}
+
+void
+TableGrid::content_remapped() noexcept {
+	invalidate_cell_cache();
+	if (has_input_control() && !m_searching) {
+		m_field.m_cursor.clear();
+		set_input_control(false);
+	}
+}
+
+bool
+TableGrid::record_matches(
+	Hord::Data::Table::Iterator& it,
+	UI::RowFilter const& filter
+) noexcept {
+	auto col = max_ce(UI::index_type{0}, filter.column());
+	auto const col_end
+		= 0 <= filter.column()
+		? min_ce(filter.column() + 1, col_count())
+		: col_count()
+	;
+	for (; col < col_end; ++col) {
+		auto const value = it.get_field(col);
+		switch (value.type.type()) {
+		case Hord::Data::ValueType::string:
+			if (filter.match_string(value.data.string, value.size)) {
+				return true;
+			}
+			break;
+
+		case Hord::Data::ValueType::object_id:
+			if (filter.textual()) {
+				auto const& path = m_session.path_to(value.data.object_id);
+				if (filter.match_string(path.data(), path.size())) {
+					return true;
+				}
+			}
+			break;
+
+		case Hord::Data::ValueType::integer:
+			if (filter.match_integer(value.data.integer)) {
+				return true;
+			}
+			break;
+
+		case Hord::Data::ValueType::decimal:
+			if (filter.match_decimal(value.data.decimal)) {
+				return true;
+			}
+			break;
+
+		default: break;
+		}
+	}
+	return false;
+}
+
+bool
+TableGrid::search_input(
+	UI::KeyInputData const& key_input
+) noexcept {
+	if (key_input.code == KeyCode::enter) {
+		auto query = m_field.m_text_tree.to_string();
+		m_searching = false;
+		m_field.m_cursor.clear();
+		set_input_control(false);
+		if (Prompt::filter == m_prompt || query.empty()) {
+			// Keep the filter
+			return true;
+		}
+		try {
+			switch (m_prompt) {
+			case Prompt::jump: jump_to_value(query); break;
+			case Prompt::import_path: start_import(query); break;
+			case Prompt::export_path: start_export(query); break;
+			default: break;
+			}
+		} catch (...) {
+			App::instance.m_ui.csline->set_error(
+				Prompt::jump == m_prompt ? "jump failed"
+				: Prompt::import_path == m_prompt ? "import failed"
+				: "export failed"
+			);
+			Log::report_error_ptr(std::current_exception());
+		}
+	} else if (key_input.code == KeyCode::esc) {
+		m_searching = false;
+		m_field.m_cursor.clear();
+		set_input_control(false);
+		if (Prompt::filter == m_prompt) {
+			clear_filter();
+		}
+	} else if (m_field.input(key_input)) {
+		if (Prompt::filter == m_prompt) {
+			// Refine the filter as the query is typed
+			auto query = m_field.m_text_tree.to_string();
+			if (query != filter().query() || m_search_col != filter().column()) {
+				set_filter(m_session, std::move(query), m_search_col);
+			}
+		}
+		enqueue_actions(
+			ui::UpdateActions::render |
+			ui::UpdateActions::flag_noclear
+		);
+	}
 	return true;
 }
 
+void
+TableGrid::begin_search(
+	UI::index_type const col,
+	Prompt const prompt
+) noexcept {
+	if (0 <= col && !value_in_bounds(col, 0, col_count())) {
+		return;
+	}
+	m_searching = true;
+	m_prompt = prompt;
+	m_search_col = col;
+	m_field_type = Hord::Data::ValueType::string;
+	if (Prompt::filter != prompt || col != filter().column()) {
+		m_field.m_cursor.clear();
+	} else {
+		m_field.m_cursor.assign(filter().query());
+	}
+	set_input_control(true);
+}
+
+void
+TableGrid::start_import(
+	String const& path
+) {
+	if (m_import_job && !m_import_job->finished()) {
+		App::instance.m_ui.csline->set_error(
+			"already importing " + m_import_job->path()
+		);
+		return;
+	} else if (&m_table == &m_object.metadata().table()) {
+		App::instance.m_ui.csline->set_error("cannot import into metadata");
+		return;
+	}
+	auto job = aux::make_shared<System::TableImport>(
+		m_session, m_object, m_table, path,
+		[this](std::size_t const first, std::size_t const count) {
+			insert_before(
+				static_cast<UI::index_type>(first),
+				static_cast<UI::index_type>(count)
+			);
+		}
+	);
+	if (!job->start()) {
+		App::instance.m_ui.csline->set_error("failed to open " + path);
+		return;
+	}
+	m_import_job = job;
+	m_session.add_job(job);
+	App::instance.m_ui.csline->set_description("importing " + path);
+}
+
+void
+TableGrid::start_export(
+	String const& path
+) {
+	if (m_export_job && !m_export_job->finished()) {
+		App::instance.m_ui.csline->set_error(
+			"already exporting " + m_export_job->path()
+		);
+		return;
+	}
+	auto job = aux::make_shared<System::TableExport>(
+		m_session, m_table, path,
+		System::TableExport::format_for_path(path)
+	);
+	if (!job->start()) {
+		App::instance.m_ui.csline->set_error("failed to open " + path);
+		return;
+	}
+	m_export_job = job;
+	m_session.add_job(job);
+	App::instance.m_ui.csline->set_description("exporting " + path);
+}
+
+void
+TableGrid::jump_to_value(
+	String const& text
+) {
+	using Key = System::ColumnIndex::Key;
+	auto const col = m_cursor.col;
+	if (!value_in_bounds(col, 0, col_count())) {
+		return;
+	}
+	Key key{System::ColumnIndex::KeyRank::null, false, 0, 0.0, {}};
+	if (
+		m_table.schema().column(col).type == Hord::Data::ValueType::object_id ||
+		'/' == text[0]
+	) {
+		auto* const object = m_session.find_ptr_path(text);
+		if (!object) {
+			App::instance.m_ui.csline->set_error("no object at " + text);
+			return;
+		}
+		key = Key::from_object_id(object->id());
+	} else {
+		key = Key::from_string(text);
+	}
+
+	UI::index_type record = -1;
+	auto* const index = m_session.column_index(m_object, m_table, col);
+	if (index) {
+		auto const* const records = index->find_nearest(key);
+		if (records) {
+			record = static_cast<UI::index_type>(records->front());
+		}
+	} else {
+		// Same result as an ordered index
+		System::ColumnIndex::KeyLess const less{};
+		Key best{System::ColumnIndex::KeyRank::null, false, 0, 0.0, {}};
+		auto const num_records = static_cast<UI::index_type>(m_table.num_records());
+		auto it = row_iterator(0);
+		for (UI::index_type candidate = 0; candidate < num_records; ++candidate, ++it) {
+			auto value_key = Key::from_value(it.get_field(col));
+			if (!less(value_key, key) && (0 > record || less(value_key, best))) {
+				record = candidate;
+				best = std::move(value_key);
+			}
+		}
+	}
+	if (0 > record) {
+		App::instance.m_ui.csline->set_error("no value at or after \"" + text + "\"");
+		return;
+	}
+
+	auto row = record;
+	if (is_mapped()) {
+		row = -1;
+		for (UI::index_type display_row = 0; display_row < row_count(); ++display_row) {
+			if (record == record_index(display_row)) {
+				row = display_row;
+				break;
+			}
+		}
+		if (0 > row) {
+			App::instance.m_ui.csline->set_error("value is hidden by the filter");
+			return;
+		}
+	}
+	row_abs(row);
+}
+
+void
+TableGrid::toggle_column_index() {
+	auto const col = m_cursor.col;
+	if (!value_in_bounds(col, 0, col_count())) {
+		return;
+	}
+	auto const& name = m_table.schema().column(col).name;
+	if (m_session.remove_column_index(m_object, m_table, col)) {
+		App::instance.m_ui.csline->set_description("dropped index on " + name);
+	} else {
+		m_session.add_column_index(
+			m_object, m_table, col, System::ColumnIndex::Kind::ordered
+		);
+		App::instance.m_ui.csline->set_description("indexed " + name);
+	}
+}
+
+void
+TableGrid::show_column_stats() {
+	auto const col = m_cursor.col;
+	if (!value_in_bounds(col, 0, col_count())) {
+		return;
+	}
+	if (m_col_stats.size() != static_cast<std::size_t>(col_count())) {
+		m_col_stats.clear();
+		m_col_stats.resize(static_cast<std::size_t>(col_count()));
+	}
+	auto const& stats = m_col_stats[static_cast<std::size_t>(col)];
+	if (
+		stats.valid() &&
+		stats.num_records() == static_cast<std::size_t>(m_table.num_records())
+	) {
+		describe_column_stats(col);
+		return;
+	}
+	// Replaces any aggregation in progress
+	auto job = aux::make_shared<StatsJob>(*this, col);
+	m_stats_job = job;
+	m_session.add_job(job);
+	App::instance.m_events.arm_timer(0u);
+	App::instance.m_ui.csline->set_description(
+		"aggregating " + m_table.schema().column(col).name
+	);
+}
+
+void
+TableGrid::apply_column_stats(
+	StatsJob& job
+) noexcept {
+	if (m_stats_job.get() != &job) {
+		// Superseded
+		return;
+	}
+	m_stats_job.reset();
+	auto const col = job.m_builder.column();
+	if (
+		job.m_generation != m_records_generation ||
+		!job.m_builder.stats().valid() ||
+		!value_in_bounds(col, 0, static_cast<UI::index_type>(m_col_stats.size()))
+	) {
+		App::instance.m_ui.csline->set_error("aggregates discarded: table changed");
+		return;
+	}
+	m_col_stats[static_cast<std::size_t>(col)] = job.m_builder.stats();
+	try {
+		describe_column_stats(col);
+	} catch (...) {
+		App::instance.m_ui.csline->set_error("failed to describe aggregates");
+	}
+}
+
+void
+TableGrid::describe_column_stats(
+	UI::index_type const col
+) {
+	// Block elements U+2581 to U+2588, by eighths
+	static char const* const
+	s_bars[]{
+		"\xE2\x96\x81", "\xE2\x96\x82", "\xE2\x96\x83", "\xE2\x96\x84",
+		"\xE2\x96\x85", "\xE2\x96\x86", "\xE2\x96\x87", "\xE2\x96\x88",
+	};
+
+	auto const& stats = m_col_stats[static_cast<std::size_t>(col)];
+	auto const& name = m_table.schema().column(col).name;
+	if (0u == stats.count()) {
+		App::instance.m_ui.csline->set_description(
+			name + ": no numeric values (" +
+			std::to_string(stats.num_nulls()) + " null)"
+		);
+		return;
+	}
+	char buffer[256];
+	duct::IO::omemstream stream{buffer, sizeof(buffer)};
+	stream
+		<< stats.count() << " values, "
+		<< stats.num_nulls() << " null, "
+		<< stats.num_other() << " other; sum "
+	;
+	if (stats.integral()) {
+		stream
+			<< static_cast<std::int64_t>(stats.sum()) << ", min "
+			<< static_cast<std::int64_t>(stats.min()) << ", max "
+			<< static_cast<std::int64_t>(stats.max())
+		;
+	} else {
+		stream
+			<< static_cast<double>(stats.sum()) << ", min "
+			<< stats.min() << ", max "
+			<< stats.max()
+		;
+	}
+	stream << ", mean " << stats.mean();
+	String description = name + ": ";
+	description.append(buffer, static_cast<std::size_t>(stream.tellp()));
+	description.append(" ");
+	std::uint32_t peak = 0u;
+	for (auto const count : stats.histogram()) {
+		peak = max_ce(peak, count);
+	}
+	for (auto const count : stats.histogram()) {
+		auto const level = static_cast<std::size_t>(
+			static_cast<std::uint64_t>(count) * 7u / peak
+		);
+		description.append(0u == count ? " " : s_bars[level]);
+	}
+	App::instance.m_ui.csline->set_description(description);
+}
+
 void
 TableGrid::reflow_field() noexcept {
+	if (m_searching) {
+		auto const& frame = geometry().frame();
+		m_field.reflow_into({frame.pos, {frame.size.width, 1}});
+		return;
+	}
+	ensure_column_widths();
 	auto const& content_frame = view().content_frame;
 	Quad cell_quad{
 		{
-			content_frame.pos.x + (m_cursor.col - view().col_range.x) * GRID_TMP_COLUMN_WIDTH,
+			content_frame.pos.x + column_x(m_cursor.col),
 			content_frame.pos.y + (m_cursor.row - view().row_range.x)
 		},
 		{0, 0}
 	};
-	cell_quad.v2.x = cell_quad.v1.x + GRID_TMP_COLUMN_WIDTH;
+	cell_quad.v2.x = cell_quad.v1.x + column_width(m_cursor.col);
 	cell_quad.v2.y = cell_quad.v1.y + 1;
 	Quad const fq = rect_abs_quad(content_frame);
 	vec2_clamp(cell_quad.v1, fq.v1, fq.v2);
@@ -405,6 +1446,167 @@ TableGrid::reflow_field() noexcept {
 	m_field.reflow_into(quad_rect(cell_quad));
 }
 
+Hord::Data::Table::Iterator
+TableGrid::row_iterator(
+	UI::index_type const row
+) noexcept {
+	auto const num_records = static_cast<std::size_t>(m_table.num_records());
+	if (m_row_index_records != num_records) {
+		// Records changed without notice
+		invalidate_row_index();
+		m_row_index_records = num_records;
+	}
+	auto const block = static_cast<std::size_t>(row / ROW_INDEX_BLOCK);
+	if (m_row_index.empty()) {
+		m_row_index.push_back(m_table.iterator_at(0));
+	}
+	while (m_row_index.size() <= block) {
+		auto it = m_row_index.back();
+		for (UI::index_type step = 0; ROW_INDEX_BLOCK > step; ++step) {
+			++it;
+		}
+		m_row_index.push_back(it);
+	}
+	auto it = m_row_index[block];
+	for (auto step = row % ROW_INDEX_BLOCK; 0 < step; --step) {
+		++it;
+	}
+	return it;
+}
+
+TableGrid::CachedCell&
+TableGrid::cached_cell(
+	UI::index_type const row,
+	UI::index_type const col
+) noexcept {
+	if (m_cell_cache.empty()) {
+		m_cell_cache.resize(1u);
+		invalidate_cell_cache();
+	}
+	auto& cached_row = m_cell_cache[
+		static_cast<std::size_t>(row) % m_cell_cache.size()
+	];
+	auto const num_cols = static_cast<std::size_t>(col_count());
+	if (cached_row.row != row || cached_row.cells.size() != num_cols) {
+		// Slot held another row (or the schema changed)
+		cached_row.row = row;
+		cached_row.cells.resize(num_cols);
+		for (auto& cached : cached_row.cells) {
+			cached.valid = false;
+		}
+	}
+	return cached_row.cells[static_cast<std::size_t>(col)];
+}
+
+UI::index_type
+TableGrid::value_width(
+	Hord::Data::ValueRef const& value
+) noexcept {
+	System::ValueText::buffer_type value_buffer;
+	auto const text = System::value_text(m_session, value, value_buffer);
+	char const* data = text.data;
+	// Count code points, stopping once the column would be capped
+	UI::index_type width = 0;
+	for (
+		auto const* const end = data + text.size;
+		data != end && width < UI::index_type{COLUMN_WIDTH_MAX};
+		++data
+	) {
+		if (0x80 != (static_cast<unsigned char>(*data) & 0xC0)) {
+			++width;
+		}
+	}
+	return width;
+}
+
+void
+TableGrid::ensure_column_widths() noexcept {
+	auto const num_cols = col_count();
+	auto const num_records = static_cast<std::size_t>(m_table.num_records());
+	auto const sampled = m_col_widths_records;
+	bool const stale
+		= num_records < WIDTH_SAMPLE_ROWS
+		? num_records != sampled
+		: (
+			num_records > sampled * WIDTH_RESAMPLE_FACTOR ||
+			num_records * WIDTH_RESAMPLE_FACTOR < sampled
+		)
+	;
+	if (signed_cast(m_col_widths.size()) == num_cols && !stale) {
+		return;
+	}
+	m_col_widths_records = num_records;
+	m_col_widths.resize(static_cast<std::size_t>(num_cols));
+	for (UI::index_type col = 0; col < num_cols; ++col) {
+		auto& cw = m_col_widths[static_cast<std::size_t>(col)];
+		cw.histogram.fill(0u);
+		cw.count = 0u;
+		// Type prefix and separator
+		cw.header_width = static_cast<UI::index_type>(min_ce(
+			std::size_t{COLUMN_WIDTH_MAX},
+			2u + m_table.schema().column(col).name.size() + 1u
+		));
+	}
+	auto const num_rows = static_cast<UI::index_type>(m_table.num_records());
+	auto const stride = max_ce(
+		1, num_rows / static_cast<UI::index_type>(WIDTH_SAMPLE_ROWS)
+	);
+	for (UI::index_type row = 0; row < num_rows; row += stride) {
+		auto it = row_iterator(row);
+		for (UI::index_type col = 0; col < num_cols; ++col) {
+			auto& cw = m_col_widths[static_cast<std::size_t>(col)];
+			auto const value = it.get_field(col);
+			++cw.histogram[static_cast<std::size_t>(value_width(value))];
+			++cw.count;
+		}
+	}
+	for (UI::index_type col = 0; col < num_cols; ++col) {
+		update_column_width(col);
+	}
+	update_column_offsets();
+}
+
+bool
+TableGrid::update_column_width(
+	UI::index_type const col
+) noexcept {
+	auto& cw = m_col_widths[static_cast<std::size_t>(col)];
+	std::uint64_t const target
+		= (std::uint64_t{cw.count} * WIDTH_PERCENTILE + 99u) / 100u
+	;
+	std::uint64_t seen = 0u;
+	std::size_t fit = 0u;
+	for (
+		;
+		fit < COLUMN_WIDTH_MAX && seen + cw.histogram[fit] < target;
+		++fit
+	) {
+		seen += cw.histogram[fit];
+	}
+	// One column of padding between values
+	auto const width = value_clamp(
+		max_ce(static_cast<UI::index_type>(fit) + 1, cw.header_width),
+		UI::index_type{COLUMN_WIDTH_MIN},
+		UI::index_type{COLUMN_WIDTH_MAX}
+	);
+	if (width == cw.width) {
+		return false;
+	}
+	cw.width = width;
+	return true;
+}
+
+void
+TableGrid::update_column_offsets() noexcept {
+	m_col_offsets.resize(m_col_widths.size() + 1u);
+	UI::index_type offset = 0;
+	for (std::size_t index = 0u; index < m_col_widths.size(); ++index) {
+		m_col_offsets[index] = offset;
+		offset += m_col_widths[index].width;
+	}
+	m_col_offsets.back() = offset;
+}
+
 bool
 TableGrid::field_input(
 	char32 const cp
@@ -455,18 +1657,245 @@ TableGrid::notify_cell_changed(
 	UI::index_type const row,
 	UI::index_type const col
 ) {
-	if (row == m_cursor.row && col == m_cursor.col) {
+	if (
+		!m_searching &&
+		value_in_bounds(m_cursor.row, 0, row_count()) &&
+		row == record_index(m_cursor.row) &&
+		col == m_cursor.col
+	) {
 		m_field.m_cursor.clear();
 		set_input_control(false);
 	}
-	queue_cell_render(row, row + 1, col, col + 1);
+	if (value_in_bounds(col, 0, static_cast<UI::index_type>(m_col_stats.size()))) {
+		m_col_stats[static_cast<std::size_t>(col)].invalidate();
+	}
+	if (m_stats_job && m_stats_job->m_builder.column() == col) {
+		// Records already aggregated may have changed
+		m_stats_job.reset();
+		App::instance.m_ui.csline->set_error("aggregates discarded: column changed");
+	}
+	if (is_mapped()) {
+		// The display row is not known without a reverse map
+		invalidate_cell_cache();
+	} else if (!m_cell_cache.empty()) {
+		auto& cached_row = m_cell_cache[
+			static_cast<std::size_t>(row) % m_cell_cache.size()
+		];
+		if (
+			cached_row.row == row &&
+			value_in_bounds(col, 0, static_cast<UI::index_type>(cached_row.cells.size()))
+		) {
+			cached_row.cells[static_cast<std::size_t>(col)].valid = false;
+		}
+	}
+	if (
+		value_in_bounds(col, 0, static_cast<UI::index_type>(m_col_widths.size())) &&
+		value_in_bounds(row, 0, static_cast<UI::index_type>(m_table.num_records()))
+	) {
+		// Widen (or narrow) the column as edits change its contents
+		auto const edited = std::find_if(
+			m_edited_cells.begin(), m_edited_cells.end(),
+			[row, col](EditedCell const& cell) {
+				return cell.row == row && cell.col == col;
+			}
+		);
+		if (m_edited_cells.end() == edited) {
+			// The old value is unknown; resample all columns
+			m_col_widths_records = ~std::size_t{0u};
+			ensure_column_widths();
+			if (has_input_control()) {
+				reflow_field();
+			}
+			queue_header_render();
+			queue_cell_render(0, row_count());
+			enqueue_actions(ui::UpdateActions::render);
+			return;
+		}
+		auto& cw = m_col_widths[static_cast<std::size_t>(col)];
+		auto& old_bucket = cw.histogram[static_cast<std::size_t>(edited->old_width)];
+		if (0u < old_bucket) {
+			--old_bucket;
+			--cw.count;
+		}
+		m_edited_cells.erase(edited);
+		auto const value = row_iterator(row).get_field(col);
+		++cw.histogram[static_cast<std::size_t>(value_width(value))];
+		++cw.count;
+		if (update_column_width(col)) {
+			update_column_offsets();
+			if (has_input_control()) {
+				reflow_field();
+			}
+			queue_header_render();
+			queue_cell_render(0, row_count());
+			enqueue_actions(ui::UpdateActions::render);
+			return;
+		}
+	}
+	if (is_mapped()) {
+		queue_cell_render(0, row_count(), col, col + 1);
+	} else {
+		queue_cell_render(row, row + 1, col, col + 1);
+	}
 	enqueue_actions(
 		ui::UpdateActions::render |
 		ui::UpdateActions::flag_noclear
 	);
 }
 
-#undef GRID_TMP_COLUMN_WIDTH
+void
+TableGrid::invalidate_cell_cache() noexcept {
+	for (auto& cached_row : m_cell_cache) {
+		cached_row.row = -1;
+	}
+}
+
+void
+TableGrid::invalidate_row_index() noexcept {
+	m_row_index.clear();
+}
+
+void
+TableGrid::records_changed() noexcept {
+	++m_records_generation;
+	for (auto& stats : m_col_stats) {
+		stats.invalidate();
+	}
+	invalidate_cell_cache();
+	invalidate_row_index();
+	if (is_sorted()) {
+		// Row numbers no longer map to the same records
+		clear_sort();
+	}
+}
+
+TableGrid::~TableGrid() noexcept {
+	cancel_sort_job();
+}
+
+void
+TableGrid::sort(
+	UI::index_type const col,
+	bool const descending
+) noexcept {
+	auto const num_records = static_cast<std::size_t>(m_table.num_records());
+	if (!value_in_bounds(col, 0, col_count()) || 0u == num_records) {
+		return;
+	}
+	// Replaces any sort in progress
+	cancel_sort_job();
+	aux::shared_ptr<SortJob> job;
+	try {
+		// An ordered index already has the records in value order
+		auto const* const index = m_session.column_index(m_object, m_table, col);
+		System::ColumnIndex::record_vector_type records;
+		if (index && index->ordered_records(descending, records)) {
+			set_row_map(
+				aux::vector<UI::index_type>(records.cbegin(), records.cend()),
+				col, descending
+			);
+			return;
+		}
+		job = aux::make_shared<SortJob>(
+			*this, col, descending, m_records_generation, num_records
+		);
+	} catch (...) {
+		App::instance.m_ui.csline->set_error("failed to start sort");
+		return;
+	}
+	m_sort_job = job;
+	m_session.add_job(job);
+	App::instance.m_events.wake();
+	App::instance.m_ui.csline->set_description(
+		"sorting by " + m_table.schema().column(col).name
+	);
+}
+
+void
+TableGrid::apply_sort(
+	SortJob& job
+) noexcept {
+	if (m_sort_job.get() != &job) {
+		// Superseded
+		return;
+	}
+	m_sort_job.reset();
+	if (
+		job.m_generation != m_records_generation ||
+		job.m_perm.size() != static_cast<std::size_t>(m_table.num_records())
+	) {
+		App::instance.m_ui.csline->set_error("sort discarded: table changed");
+		return;
+	}
+	set_row_map(std::move(job.m_perm), job.m_col, job.m_descending);
+}
+
+void
+TableGrid::sort_failed(
+	SortJob& job
+) noexcept {
+	if (m_sort_job.get() == &job) {
+		m_sort_job.reset();
+		App::instance.m_ui.csline->set_error("failed to start sort");
+	}
+}
+
+void
+TableGrid::set_row_map(
+	aux::vector<UI::index_type>&& row_map,
+	UI::index_type const col,
+	bool const descending
+) noexcept {
+	m_row_map = std::move(row_map);
+	aux::vector<UI::index_type>{}.swap(m_sorted_rows);
+	m_sort_col = col;
+	m_sort_descending = descending;
+	invalidate_cell_cache();
+	if (has_input_control() && !m_searching) {
+		m_field.m_cursor.clear();
+		set_input_control(false);
+	}
+	queue_header_render();
+	queue_cell_render(0, row_count());
+	enqueue_actions(ui::UpdateActions::render);
+	App::instance.m_ui.csline->set_description(
+		"sorted by " + m_table.schema().column(m_sort_col).name
+	);
+	if (is_filtered()) {
+		// Matches are in display order
+		set_filter(m_session, filter().query(), filter().column());
+	}
+}
+
+void
+TableGrid::cancel_sort_job() noexcept {
+	if (m_sort_job) {
+		m_sort_job->cancel();
+		m_sort_job.reset();
+	}
+}
+
+void
+TableGrid::clear_sort() noexcept {
+	cancel_sort_job();
+	if (!is_sorted()) {
+		return;
+	}
+	aux::vector<UI::index_type>{}.swap(m_row_map);
+	aux::vector<UI::index_type>{}.swap(m_sorted_rows);
+	m_sort_col = -1;
+	invalidate_cell_cache();
+	if (has_input_control() && !m_searching) {
+		m_field.m_cursor.clear();
+		set_input_control(false);
+	}
+	queue_header_render();
+	queue_cell_render(0, row_count());
+	enqueue_actions(ui::UpdateActions::render);
+	if (is_filtered()) {
+		set_filter(m_session, filter().query(), filter().column());
+	}
+}
 
 } // namespace UI
 } // namespace Onsang
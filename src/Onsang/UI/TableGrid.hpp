@@ -10,10 +10,15 @@
 #include <Onsang/config.hpp>
 #include <Onsang/aux.hpp>
 #include <Onsang/utility.hpp>
+#include <Onsang/System/Job.hpp>
 #include <Onsang/System/Session.hpp>
+#include <Onsang/System/ColumnStats.hpp>
+#include <Onsang/System/TableImport.hpp>
+#include <Onsang/System/TableExport.hpp>
 #include <Onsang/UI/Defs.hpp>
 #include <Onsang/UI/BareField.hpp>
 #include <Onsang/UI/BasicGrid.hpp>
+#include <Onsang/UI/RowFilter.hpp>
 
 #include <Beard/keys.hpp>
 #include <Beard/txt/Defs.hpp>
@@ -24,6 +29,9 @@
 #include <Hord/Data/Defs.hpp>
 #include <Hord/Data/Table.hpp>
 
+#include <array>
+#include <cstdint>
+
 namespace Onsang {
 namespace UI {
 
@@ -37,6 +45,153 @@ private:
 	using base = UI::BasicGrid;
 	enum class ctor_priv {};
 
+public:
+	/**
+		Render counters, for benchmarking.
+	*/
+	struct RenderCounters {
+		std::uint64_t calls;
+		std::uint64_t cells;
+	};
+
+	static RenderCounters s_render_counters;
+
+private:
+	struct CachedCell {
+		bool valid;
+		Hord::Data::ValueType type;
+		String text;
+	};
+
+	struct CachedRow {
+		UI::index_type row;
+		aux::vector<CachedCell> cells;
+	};
+
+	/**
+		Formatted values for visible rows, indexed by row modulo
+		the cache size.
+
+		Only values that need formatting are cached; strings are
+		rendered straight from the table and object IDs are
+		resolved by the session.
+	*/
+	aux::vector<CachedRow> m_cell_cache{};
+
+	enum : UI::index_type {
+		COLUMN_WIDTH_MIN = 4,
+		COLUMN_WIDTH_MAX = 48,
+	};
+
+	enum : unsigned {
+		/** Maximum number of rows sampled to size columns. */
+		WIDTH_SAMPLE_ROWS = 512u,
+		/**
+			Factor by which the number of records must grow or
+			shrink before a full sample is resampled.
+		*/
+		WIDTH_RESAMPLE_FACTOR = 2u,
+		/** Percentile of sampled value widths a column fits. */
+		WIDTH_PERCENTILE = 90u,
+	};
+
+	/**
+		Histogram of value widths seen in a column.
+
+		Built from a strided sample of rows and updated as cells
+		change, so widths never require a full scan.
+	*/
+	struct ColumnWidth {
+		std::array<std::uint32_t, COLUMN_WIDTH_MAX + 1> histogram;
+		std::uint32_t count;
+		UI::index_type header_width;
+		UI::index_type width;
+	};
+
+	enum : unsigned {
+		/** Maximum number of edits awaiting notify_cell_changed(). */
+		EDITED_CELLS_MAX = 32u,
+	};
+
+	/** Width of the value a cell held before an edit was issued. */
+	struct EditedCell {
+		UI::index_type row;
+		UI::index_type col;
+		UI::index_type old_width;
+	};
+
+	enum : UI::index_type {
+		/** Rows per row index entry. */
+		ROW_INDEX_BLOCK = 256,
+	};
+
+	/**
+		Iterators to the first row of each block of ROW_INDEX_BLOCK
+		rows, up to the furthest block visited.
+
+		The index is extended by walking forward from its last
+		entry, so Table::iterator_at() is only paid once per
+		rebuild, and any row is then at most ROW_INDEX_BLOCK - 1
+		steps from an indexed iterator.
+	*/
+	aux::vector<Hord::Data::Table::Iterator> m_row_index{};
+	std::size_t m_row_index_records{0u};
+
+	aux::vector<ColumnWidth> m_col_widths{};
+	/** Number of records when m_col_widths was sampled. */
+	std::size_t m_col_widths_records{0u};
+	aux::vector<EditedCell> m_edited_cells{};
+	/** Column offsets; col_count() + 1 entries. */
+	aux::vector<UI::index_type> m_col_offsets{};
+
+	class SortJob;
+
+	/**
+		Display row to record index, or empty if unsorted.
+	*/
+	aux::vector<UI::index_type> m_row_map{};
+	/**
+		Record index to display row (the inverse of m_row_map),
+		held while a sorted filter scan runs.
+	*/
+	aux::vector<UI::index_type> m_sorted_rows{};
+	UI::index_type m_sort_col{-1};
+	bool m_sort_descending{false};
+	/** Bumped when records are inserted or erased. */
+	unsigned m_records_generation{0u};
+	aux::shared_ptr<SortJob> m_sort_job{};
+	/**
+		What the field holds while m_searching.
+	*/
+	enum class Prompt : unsigned {
+		/** Filter query. */
+		filter = 0u,
+		/** Value to jump to. */
+		jump,
+		/** Path of a file to import. */
+		import_path,
+		/** Path of a file to export to. */
+		export_path,
+	};
+
+	/** Whether the field holds a prompt instead of a cell value. */
+	bool m_searching{false};
+	Prompt m_prompt{Prompt::filter};
+	/** Column to search, or -1 for all columns. */
+	UI::index_type m_search_col{-1};
+
+	class StatsJob;
+
+	/**
+		Aggregates by column, computed on request and kept until
+		the column changes.
+	*/
+	aux::vector<System::ColumnStats> m_col_stats{};
+	aux::shared_ptr<StatsJob> m_stats_job{};
+
+	System::TableImport::SPtr m_import_job{};
+	System::TableExport::SPtr m_export_job{};
+
 public:
 	System::Session& m_session;
 	Hord::Object::Unit& m_object;
@@ -101,10 +256,222 @@ private:
 		UI::index_type row
 	) noexcept override;
 
+	bool
+	content_insert_span(
+		UI::index_type row,
+		UI::index_type count
+	) noexcept override;
+
+	bool
+	content_erase_span(
+		UI::index_type row,
+		UI::index_type count
+	) noexcept override;
+
+	bool
+	content_filter(
+		UI::index_type row_begin,
+		UI::index_type row_end,
+		UI::RowFilter const& filter,
+		aux::vector<UI::index_type>& matches
+	) noexcept override;
+
+	void
+	content_remapped() noexcept override;
+
 // -
 	void
 	reflow_field() noexcept;
 
+	CachedCell&
+	cached_cell(
+		UI::index_type const row,
+		UI::index_type const col
+	) noexcept;
+
+	Hord::Data::Table::Iterator
+	row_iterator(
+		UI::index_type const row
+	) noexcept;
+
+	bool
+	record_matches(
+		Hord::Data::Table::Iterator& it,
+		UI::RowFilter const& filter
+	) noexcept;
+
+	bool
+	search_input(
+		UI::KeyInputData const& key_input
+	) noexcept;
+
+	void
+	begin_search(
+		UI::index_type const col,
+		Prompt const prompt
+	) noexcept;
+
+	/**
+		Append records from a CSV or TSV file on a worker thread.
+	*/
+	void
+	start_import(
+		String const& path
+	);
+
+	/**
+		Write all records to a file, formatted by its extension.
+	*/
+	void
+	start_export(
+		String const& path
+	);
+
+	/**
+		Collect matches from the index of the filter column.
+
+		@returns @c false if the column is not indexed or the
+		index cannot answer the query.
+	*/
+	bool
+	index_filter(
+		UI::RowFilter const& filter,
+		aux::vector<UI::index_type>& matches
+	);
+
+	/**
+		Build m_sorted_rows from m_row_map.
+	*/
+	void
+	build_sorted_rows();
+
+	/**
+		Move the cursor to the first row in record order with the
+		smallest value in the cursor column not less than @a text.
+	*/
+	void
+	jump_to_value(
+		String const& text
+	);
+
+	/**
+		Add or remove the index for the cursor column.
+	*/
+	void
+	toggle_column_index();
+
+	/**
+		Show aggregates of the cursor column in the status line.
+
+		Stale aggregates are computed by a job on the session
+		first.
+	*/
+	void
+	show_column_stats();
+
+	/**
+		Store the aggregates from @a job and show them.
+	*/
+	void
+	apply_column_stats(
+		StatsJob& job
+	) noexcept;
+
+	void
+	describe_column_stats(
+		UI::index_type const col
+	);
+
+	void
+	apply_sort(
+		SortJob& job
+	) noexcept;
+
+	/**
+		Drop @a job if it could not start its worker.
+	*/
+	void
+	sort_failed(
+		SortJob& job
+	) noexcept;
+
+	/**
+		Show records in @a row_map order, sorted by @a col.
+	*/
+	void
+	set_row_map(
+		aux::vector<UI::index_type>&& row_map,
+		UI::index_type const col,
+		bool const descending
+	) noexcept;
+
+	/**
+		Cancel and drop the sort in progress, if any.
+
+		This joins the worker, which stops at its next comparison
+		once canceled.
+	*/
+	void
+	cancel_sort_job() noexcept;
+
+	/**
+		Drop state that depends on record positions.
+	*/
+	void
+	records_changed() noexcept;
+
+	UI::index_type
+	value_width(
+		Hord::Data::ValueRef const& value
+	) noexcept;
+
+	/**
+		Sample rows to build column widths if the schema changed,
+		or if the number of records changed enough to make the
+		sample unrepresentative.
+
+		Tables smaller than WIDTH_SAMPLE_ROWS are sampled whole, so
+		they are resampled on any change. Larger ones are resampled
+		once the number of records grows or shrinks by
+		WIDTH_RESAMPLE_FACTOR.
+	*/
+	void
+	ensure_column_widths() noexcept;
+
+	/**
+		Recompute the width of @a col from its histogram.
+
+		@returns Whether the width changed.
+	*/
+	bool
+	update_column_width(
+		UI::index_type const col
+	) noexcept;
+
+	void
+	update_column_offsets() noexcept;
+
+	UI::index_type
+	column_width(
+		UI::index_type const col
+	) const noexcept {
+		return m_col_widths[static_cast<std::size_t>(col)].width;
+	}
+
+	/**
+		Horizontal offset of @a col relative to the first visible
+		column.
+	*/
+	UI::index_type
+	column_x(
+		UI::index_type const col
+	) const noexcept {
+		return
+			m_col_offsets[static_cast<std::size_t>(col)] -
+			m_col_offsets[static_cast<std::size_t>(view().col_range.x)]
+		;
+	}
+
 	bool
 	field_input(
 		char32 cp
@@ -116,7 +483,7 @@ private:
 	TableGrid& operator=(TableGrid const&) = delete;
 
 public:
-	~TableGrid() noexcept override = default;
+	~TableGrid() noexcept override;
 
 	TableGrid(
 		ctor_priv const,
@@ -176,6 +543,69 @@ public:
 		UI::index_type row,
 		UI::index_type col
 	);
+
+	/**
+		Drop all cached cell values.
+	*/
+	void
+	invalidate_cell_cache() noexcept;
+
+	bool
+	is_sorted() const noexcept {
+		return !m_row_map.empty();
+	}
+
+	/**
+		Get the record index for a display row.
+	*/
+	UI::index_type
+	record_index(
+		UI::index_type const row
+	) const noexcept {
+		auto const sorted_row = content_row(row);
+		return
+			m_row_map.empty()
+			? sorted_row
+			: m_row_map[static_cast<std::size_t>(sorted_row)]
+		;
+	}
+
+	/**
+		Whether display rows are not record indices.
+	*/
+	bool
+	is_mapped() const noexcept {
+		return is_sorted() || is_filtered();
+	}
+
+	/**
+		Sort rows by a column on a worker thread.
+
+		The grid keeps its current order until the sort finishes.
+		Records are not reordered; the grid renders through a row
+		permutation instead. An ordered column index is used
+		directly when there is one.
+	*/
+	void
+	sort(
+		UI::index_type const col,
+		bool const descending
+	) noexcept;
+
+	/**
+		Return to record order.
+	*/
+	void
+	clear_sort() noexcept;
+
+	/**
+		Drop the row index.
+
+		@note This must be called whenever records are inserted or
+		erased. Iterators stay valid when field values change.
+	*/
+	void
+	invalidate_row_index() noexcept;
 };
 
 } // namespace UI
@@ -6,6 +6,7 @@
 #include <Onsang/aux.hpp>
 #include <Onsang/utility.hpp>
 #include <Onsang/UI/Defs.hpp>
+#include <Onsang/UI/RowFilter.hpp>
 #include <Onsang/UI/TableSchemaEditor.hpp>
 
 #include <Beard/keys.hpp>
@@ -33,6 +34,39 @@ s_column_name[TableSchemaEditor::NUM_COLUMNS]{
 static UI::geom_value_type const
 s_column_width []{5 + 1, 16 + 1, 9 + 1, 4 + 1, 6},
 s_column_offset[]{0, 5 + 1, 21 + 2, 30 + 3, 34 + 4, 40 + 4};
+
+static bool
+match_cstr(
+	UI::RowFilter const& filter,
+	char const* const value
+) noexcept {
+	return filter.match_string(value, std::strlen(value));
+}
+
+static bool
+data_matches(
+	TableSchemaEditor::Data const& data,
+	UI::RowFilter const& filter
+) noexcept {
+	bool index_matches;
+	if (data.orig.index == ~0u) {
+		index_matches = match_cstr(filter, "INS");
+	} else if (data.edit.index == ~0u) {
+		index_matches = match_cstr(filter, "DEL");
+	} else {
+		index_matches = filter.match_integer(data.edit.index);
+	}
+	return
+		index_matches ||
+		filter.match_string(data.edit.name.data(), data.edit.name.size()) ||
+		match_cstr(filter, Hord::Data::get_value_type_name(data.edit.type.type())) ||
+		match_cstr(filter, Hord::Data::get_size_name(data.edit.type.size())) ||
+		match_cstr(filter,
+			enum_cast(data.edit.type.flags() & Hord::Data::ValueFlag::integer_signed)
+			? "true" : "false"
+		)
+	;
+}
 } // anonymous namespace
 
 void
@@ -47,6 +81,8 @@ TableSchemaEditor::set_input_control_impl(
 			m_cursor.row, m_cursor.row + 1,
 			m_cursor.col, m_cursor.col + 1
 		);
+		// The search field covers the header
+		queue_header_render();
 	}
 	m_field.input_control_changed(*this);
 	enqueue_actions(
@@ -87,20 +123,26 @@ TableSchemaEditor::handle_event_impl(
 		return false;
 	}
 	if (!has_input_control()) {
+		auto const row = 0 < row_count() ? content_row(m_cursor.row) : 0;
 		if (key_input_match(event.key_input, s_kim_insert_before)) {
-			insert_before(m_cursor.row, 1);
+			insert_before(row, 1);
 			return true;
 		} else if (key_input_match(event.key_input, s_kim_insert_after)) {
-			insert_after(m_cursor.row, 1);
+			insert_after(row, 1);
 			return true;
 		} else if (event.key_input.cp == 'R') {
 			reset();
 			return true;
+		} else if (event.key_input.cp == '/') {
+			m_searching = true;
+			m_field.m_cursor.assign(filter().query());
+			set_input_control(true);
+			return true;
 		}
-		if (m_data.empty()) {
+		if (0 >= row_count()) {
 			return false;
 		}
-		auto& data = m_data[m_cursor.row];
+		auto& data = m_data[row];
 		if (
 			key_input_match(event.key_input, s_kim_activate_cell) &&
 			!(data.orig.index != ~0u && data.edit.index == ~0u)
@@ -116,7 +158,7 @@ TableSchemaEditor::handle_event_impl(
 			erase_selected();
 			return true;
 		} else if (event.key_input.cp == 'E') {
-			erase(m_cursor.row, 1);
+			erase(row, 1);
 			erase_selected();
 			return true;
 		} else if (event.key_input.cp == 'r' && data.orig.index != ~0u) {
@@ -132,9 +174,31 @@ TableSchemaEditor::handle_event_impl(
 			return true;
 		}
 		return false;
+	} else if (m_searching) {
+		if (event.key_input.code == KeyCode::enter) {
+			// Keep the filter
+			m_searching = false;
+			m_field.m_cursor.clear();
+			set_input_control(false);
+		} else if (event.key_input.code == KeyCode::esc) {
+			m_searching = false;
+			m_field.m_cursor.clear();
+			set_input_control(false);
+			clear_filter();
+		} else if (m_field.input(event.key_input)) {
+			auto query = m_field.m_text_tree.to_string();
+			if (query != filter().query()) {
+				set_filter(m_session, std::move(query));
+			}
+			enqueue_actions(
+				ui::UpdateActions::render |
+				ui::UpdateActions::flag_noclear
+			);
+		}
+		return true;
 	} else if (event.key_input.code == KeyCode::enter) {
 		auto const& node = m_field.m_cursor.node();
-		auto& data = m_data[m_cursor.row];
+		auto& data = m_data[content_row(m_cursor.row)];
 		if (node.points() > 0) {
 			data.edit.name = node.to_string();
 			data.modified.set(1 << unsigned_cast(m_cursor.col), data.edit.name != data.orig.name);
@@ -246,7 +310,7 @@ TableSchemaEditor::render_content(
 	String scratch;
 	for (UI::index_type row = row_begin; row < row_end; ++row) {
 		pos.x = frame.pos.x + begin_offset;
-		auto const& data = m_data[row];
+		auto const& data = m_data[content_row(row)];
 		if (m_sel[row]) {
 			cell.attr_fg = grid_rd.selected_fg;
 			cell.attr_bg = grid_rd.selected_bg;
@@ -286,7 +350,7 @@ TableSchemaEditor::render_content(
 		}
 		grid_rd.rd.terminal.put_sequence(
 			pos.x, pos.y,
-			get_cell_seq(row, col, scratch),
+			get_cell_seq(content_row(row), col, scratch),
 			size.width,
 			cell.attr_fg,
 			cell.attr_bg
@@ -321,11 +385,35 @@ TableSchemaEditor::content_erase(
 	} else {
 		data.edit = data.orig;
 		data.edit.index = ~0u;
-		m_sel[row] = false;
+		m_sel.assign(row, row + 1, false);
+	}
+	return false;
+}
+
+bool
+TableSchemaEditor::content_filter(
+	UI::index_type const row_begin,
+	UI::index_type row_end,
+	UI::RowFilter const& filter,
+	aux::vector<UI::index_type>& matches
+) noexcept {
+	row_end = min_ce(row_end, static_cast<UI::index_type>(m_data.size()));
+	for (auto row = row_begin; row < row_end; ++row) {
+		if (data_matches(m_data[row], filter)) {
+			matches.push_back(row);
+		}
 	}
 	return false;
 }
 
+void
+TableSchemaEditor::content_remapped() noexcept {
+	if (has_input_control() && !m_searching) {
+		m_field.m_cursor.clear();
+		set_input_control(false);
+	}
+}
+
 txt::Sequence
 TableSchemaEditor::get_cell_seq(
 	UI::index_type row,
@@ -369,6 +457,11 @@ TableSchemaEditor::get_cell_seq(
 
 void
 TableSchemaEditor::reflow_field() noexcept {
+	if (m_searching) {
+		auto const& frame = geometry().frame();
+		m_field.reflow_into({frame.pos, {frame.size.width, 1}});
+		return;
+	}
 	auto const& view = this->view();
 	auto const& content_frame = view.content_frame;
 	Quad cell_quad{
@@ -398,17 +491,17 @@ TableSchemaEditor::reset() {
 		++it;
 	}
 	resize_grid(NUM_COLUMNS, signed_cast(m_data.size()));
-	std::fill(m_sel.begin(), m_sel.end(), false);
+	m_sel.reset();
 }
 
 void
 TableSchemaEditor::cursor_step_value(
 	bool const prev
 ) {
-	if (m_data.empty()) {
+	if (0 >= row_count()) {
 		return;
 	}
-	auto& data = m_data[m_cursor.row];
+	auto& data = m_data[content_row(m_cursor.row)];
 	auto value_type = data.edit.type.type();
 	auto size = data.edit.type.size();
 	auto flags = data.edit.type.flags();
@@ -14,6 +14,7 @@
 #include <Onsang/UI/Defs.hpp>
 #include <Onsang/UI/BareField.hpp>
 #include <Onsang/UI/BasicGrid.hpp>
+#include <Onsang/UI/RowFilter.hpp>
 
 #include <Beard/txt/Defs.hpp>
 #include <Beard/ui/Root.hpp>
@@ -51,6 +52,8 @@ public:
 	aux::vector<Data> m_data{};
 
 	UI::BareField m_field{};
+	/** Whether the field holds a search query. */
+	bool m_searching{false};
 
 private:
 // UI::Widget::Base implementation
@@ -102,6 +105,17 @@ private:
 		UI::index_type row
 	) noexcept override;
 
+	bool
+	content_filter(
+		UI::index_type row_begin,
+		UI::index_type row_end,
+		UI::RowFilter const& filter,
+		aux::vector<UI::index_type>& matches
+	) noexcept override;
+
+	void
+	content_remapped() noexcept override;
+
 // -
 	void
 	reflow_field() noexcept;
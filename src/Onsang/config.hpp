@@ -21,4 +21,17 @@ namespace Onsang {
 */
 #define ONSANG_AUX_ALLOCATOR std::allocator
 
+/**
+	Whether debug log messages are compiled in.
+
+	When @c 0, ONSANG_LOG_DEBUG() statements compile to nothing
+	reachable and Log::set_debug() has no effect.
+
+	@note Defaults to @c 1; release builds define it to @c 0 (see
+	@c build.lua).
+*/
+#ifndef ONSANG_CONFIG_LOG_DEBUG
+	#define ONSANG_CONFIG_LOG_DEBUG 1
+#endif
+
 } // namespace Onsang
@@ -35,6 +35,9 @@ main(
 		return -1;
 	}
 
+	// The log destinations are configured; queue from here on
+	Log::start_async();
+
 	// Start
 	try {
 		Log::acquire()
@@ -46,11 +49,13 @@ main(
 			<< "Error running app:\n"
 		;
 		Log::report_error_ptr(std::current_exception());
+		Log::stop_async();
 		return -2;
 	}
 
 	Log::acquire()
 		<< "Stopping\n"
 	;
+	Log::stop_async();
 	return 0;
 }